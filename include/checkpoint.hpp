@@ -0,0 +1,18 @@
+#ifndef NETSIM_CHECKPOINT_HPP
+#define NETSIM_CHECKPOINT_HPP
+
+#include <iosfwd>
+
+#include "factory.hpp"
+
+// Binarny punkt kontrolny pełnego stanu symulacji: struktura fabryki (jak w pliku struktury),
+// tura, rejestr numerów półproduktów, kolejki, stanowiska, bufory, strumienie losowe i kursory
+// trasowania, a także układ węzłów i kolejność utworzenia odbiorców, od których zależy przebieg
+// symulacji. Liczby zapisywane są jako varinty (numery półproduktów różnicowo).
+// Symulacja wznowiona z punktu kontrolnego daje te same wyniki co nieprzerwana.
+void save_checkpoint(const Factory& factory, std::ostream& os);
+
+// Zgłasza std::invalid_argument dla uszkodzonego lub niezgodnego punktu kontrolnego.
+Factory load_checkpoint(std::istream& is);
+
+#endif //NETSIM_CHECKPOINT_HPP
@@ -0,0 +1,149 @@
+#ifndef NETSIM_COMPILED_FACTORY_HPP
+#define NETSIM_COMPILED_FACTORY_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "factory.hpp"
+
+// Zamrożona fabryka do symulacji: struktura (sąsiedztwo w formacie CSR) jest niezmienna,
+// a stan węzłów leży w ciągłych tablicach (structure of arrays). Półprodukty z kolejek
+// i buforów przenoszone są do wspólnej puli przy kompilacji i wracają do fabryki
+// w `write_back()`, a najpóźniej w destruktorze (także gdy `run()` zgłosi wyjątek).
+// Do tego czasu fabryki nie wolno modyfikować.
+class CompiledFactory {
+public:
+    // Symulacja od pierwszej niesymulowanej tury fabryki.
+    explicit CompiledFactory(Factory& factory) : CompiledFactory(factory, factory.get_time()) {}
+
+    CompiledFactory(Factory& factory, Time first_turn);
+
+    CompiledFactory(const CompiledFactory&) = delete;
+
+    CompiledFactory& operator=(const CompiledFactory&) = delete;
+
+    // Wywołuje `write_back()`, jeśli nie zrobiono tego wcześniej.
+    ~CompiledFactory();
+
+    // Symuluje kolejne `turns` tur - wyniki są takie same jak dla `simulate()`.
+    void run(TimeOffset turns);
+
+    // Pierwsza jeszcze niesymulowana tura.
+    Time get_time() const { return time_; }
+
+    // Przenosi stan (także turę) z powrotem do fabryki; po tym wywołaniu `run()` zgłasza wyjątek.
+    void write_back();
+
+private:
+    static constexpr std::uint32_t NONE = std::numeric_limits<std::uint32_t>::max();
+    static constexpr std::uint32_t STOREHOUSE_TARGET = 1U << 31;
+
+    // Lista półproduktów w puli (jednokierunkowa, przez `next_`).
+    struct PackageList {
+        std::uint32_t head = NONE;
+        std::uint32_t tail = NONE;
+    };
+
+    struct TargetLoad {
+        std::size_t load;
+
+        friend std::size_t receiver_load(TargetLoad target) { return target.load; }
+    };
+
+    // Widok wiersza CSR zgodny z `RoutingTable`, by korzystać z tych samych polityk trasowania.
+    struct RoutingView {
+        struct Targets {
+            const CompiledFactory* factory;
+            const std::uint32_t* targets;
+            std::size_t count;
+
+            std::size_t size() const { return count; }
+
+            bool empty() const { return count == 0; }
+
+            TargetLoad operator[](std::size_t i) const { return {factory->target_load(targets[i])}; }
+        };
+
+        Targets receivers;
+        const double* cumulative;
+        std::size_t cursor;
+
+        std::size_t pick_weighted(double u) const {
+            const double* it = std::lower_bound(cumulative, cumulative + receivers.count, u);
+            return (it == cumulative + receivers.count) ? receivers.count - 1 : static_cast<std::size_t>(it - cumulative);
+        }
+    };
+
+    std::uint32_t store(Package&& package);
+
+    void append(PackageList& list, std::uint32_t package);
+
+    std::uint32_t pop_front(PackageList& list);
+
+    void push_front(PackageList& list, std::uint32_t package);
+
+    std::size_t target_load(std::uint32_t target) const {
+        return (target & STOREHOUSE_TARGET) ? storehouse_load_[target & ~STOREHOUSE_TARGET] : queue_size_[target];
+    }
+
+    void send(std::size_t sender, std::uint32_t& buffer);
+
+    void process(std::size_t worker, Time t);
+
+    bool release_finished(std::size_t worker);
+
+    // Jak `Worker::get_next_event_time()`.
+    Time next_event(std::size_t worker, Time now) const;
+
+    Factory* factory_;
+    Time time_;
+    bool written_back_ = false;
+
+    // Pula półproduktów.
+    std::vector<Package> packages_;
+    std::vector<std::uint32_t> next_;
+
+    // Nadawcy: najpierw rampy, potem robotnicy (ta sama kolejność co w `simulate()`).
+    std::vector<std::uint32_t> sender_offset_;
+    std::vector<std::uint32_t> targets_;
+    std::vector<double> cumulative_;
+    std::vector<RoutingPolicyType> policy_;
+    std::vector<std::size_t> cursor_;
+    std::vector<ProbabilityGenerator> generator_;
+
+    // Rampy.
+    std::vector<Ramp*> ramps_;
+    std::vector<Time> next_delivery_;
+    std::vector<TimeOffset> delivery_di_;
+    std::vector<TimeDistribution> delivery_interval_;
+    std::vector<UniformBuffer> delivery_rng_;
+    std::vector<std::optional<ArrivalTrace>> trace_;
+    std::vector<std::uint32_t> ramp_buffer_;
+
+    // Robotnicy; kolejka LIFO trzymana jest od ostatniego elementu.
+    std::vector<Worker*> workers_;
+    std::vector<std::shared_ptr<const WorkerConfig>> config_;
+    std::vector<UniformBuffer> processing_rng_;
+    std::vector<PackageList> queue_;
+    std::vector<std::size_t> queue_size_;
+    std::vector<std::uint8_t> lifo_;
+    std::vector<std::uint32_t> worker_buffer_;
+    std::vector<std::uint32_t> slot_offset_;
+    std::vector<std::uint32_t> slot_package_;
+    std::vector<Time> slot_start_;
+    std::vector<TimeOffset> slot_duration_;
+    std::vector<std::uint8_t> slot_finished_;
+    // Najbliższa tura, w której robotnik ma coś do zrobienia - bezczynni są pomijani.
+    std::vector<Time> worker_due_;
+
+    // Magazyny: tylko półprodukty dostarczone od kompilacji.
+    std::vector<Storehouse*> storehouses_;
+    std::vector<std::size_t> storehouse_load_;
+    std::vector<PackageList> stock_;
+};
+
+#endif //NETSIM_COMPILED_FACTORY_HPP
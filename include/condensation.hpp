@@ -0,0 +1,86 @@
+#ifndef NETSIM_CONDENSATION_HPP
+#define NETSIM_CONDENSATION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "factory.hpp"
+
+
+// Przedział indeksów w tablicy CSR.
+class IndexRange {
+public:
+    IndexRange(const std::uint32_t* first, const std::uint32_t* last) : first_(first), last_(last) {}
+
+    const std::uint32_t* begin() const { return first_; }
+
+    const std::uint32_t* end() const { return last_; }
+
+    std::size_t size() const { return static_cast<std::size_t>(last_ - first_); }
+
+    bool empty() const { return first_ == last_; }
+
+private:
+    const std::uint32_t* first_;
+    const std::uint32_t* last_;
+};
+
+// Rozkład grafu fabryki na silnie spójne składowe (iteracyjny algorytm Tarjana, O(V + E))
+// wraz z grafem kondensacji. Składowe numerowane są w porządku topologicznym: krawędzie
+// kondensacji prowadzą wyłącznie do składowych o większych numerach. Poziom składowej to
+// długość najdłuższej ścieżki od składowej bez poprzedników - składowe z jednego poziomu
+// nie zależą od siebie. Migawka struktury: po zmianie fabryki trzeba ją zbudować ponownie.
+class Condensation {
+public:
+    explicit Condensation(const Factory& factory);
+
+    std::size_t node_count() const { return nodes_.size(); }
+
+    // Kolejność węzłów: rampy, robotnicy, magazyny (jak przy iteracji po fabryce).
+    const NodeRef& node(std::uint32_t v) const { return nodes_[v]; }
+
+    std::size_t component_count() const { return member_offset_.size() - 1; }
+
+    std::uint32_t component_of(std::uint32_t v) const { return component_[v]; }
+
+    // Zgłasza std::invalid_argument, jeśli węzła nie ma w fabryce.
+    std::uint32_t component_of(ElementType element_type, ElementID id) const;
+
+    // Indeksy węzłów składowej.
+    IndexRange members(std::uint32_t c) const { return range(member_offset_, members_, c); }
+
+    // Bezpośredni następnicy składowej w grafie kondensacji (bez powtórzeń, rosnąco).
+    IndexRange successors(std::uint32_t c) const { return range(successor_offset_, successors_, c); }
+
+    // Obieg: składowa z więcej niż jednym węzłem albo robotnik połączony sam ze sobą.
+    bool is_cycle(std::uint32_t c) const { return cycle_[c] != 0; }
+
+    // Składowe tworzące obiegi (pętle recyrkulacji).
+    std::vector<std::uint32_t> cycles() const;
+
+    std::uint32_t level(std::uint32_t c) const { return level_[c]; }
+
+    std::uint32_t level_count() const { return level_count_; }
+
+private:
+    static IndexRange range(const std::vector<std::uint32_t>& offset, const std::vector<std::uint32_t>& values,
+                            std::uint32_t i) {
+        return IndexRange(values.data() + offset[i], values.data() + offset[i + 1]);
+    }
+
+    std::vector<NodeRef> nodes_;
+    std::map<std::pair<ElementType, ElementID>, std::uint32_t> index_;
+    std::vector<std::uint32_t> component_;
+    std::vector<std::uint32_t> member_offset_;
+    std::vector<std::uint32_t> members_;
+    std::vector<std::uint32_t> successor_offset_;
+    std::vector<std::uint32_t> successors_;
+    std::vector<std::uint8_t> cycle_;
+    std::vector<std::uint32_t> level_;
+    std::uint32_t level_count_ = 0;
+};
+
+#endif //NETSIM_CONDENSATION_HPP
@@ -0,0 +1,118 @@
+#ifndef NETSIM_CONSISTENCY_HPP
+#define NETSIM_CONSISTENCY_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "nodes.hpp"
+
+// Przyrostowe utrzymywanie spójności sieci: dla każdego węzła pamiętane jest, czy jest
+// osiągalny z rampy i czy prowadzi do magazynu, oraz liczba węzłów naruszających spójność.
+// Dodanie połączenia propaguje zmiany tylko do nowo osiągalnych węzłów; usunięcie
+// stosuje schemat "usuń nadmiarowo i wyprowadź ponownie" (DRed) ograniczony do obszaru,
+// który mógł zależeć od usuniętej krawędzi. Liczniki krawędzi wspierających węzeł
+// pozwalają wyprowadzić go ponownie w O(1), bez przeglądania jego sąsiadów.
+// Osiągalność magazynów nie wpływa na spójność, więc nie jest śledzona.
+class ConsistencyTracker final : public LinkObserver {
+public:
+    ConsistencyTracker() = default;
+
+    ConsistencyTracker(const ConsistencyTracker&) = delete;
+
+    ConsistencyTracker& operator=(const ConsistencyTracker&) = delete;
+
+    ~ConsistencyTracker() override;
+
+    void add_node(Ramp& ramp);
+
+    void add_node(Worker& worker);
+
+    void add_node(Storehouse& storehouse);
+
+    // Usuwa połączenia wychodzące węzła (przychodzące musi wcześniej usunąć fabryka).
+    void remove_node(Ramp& ramp);
+
+    void remove_node(Worker& worker);
+
+    void remove_node(Storehouse& storehouse);
+
+    // Hurtowe dodawanie węzłów: między `begin_bulk` a `end_bulk` węzły są tylko rejestrowane,
+    // a stan liczony jest raz na końcu w O(V + E) zamiast propagacji po każdym połączeniu.
+    void begin_bulk(std::size_t nodes);
+
+    void end_bulk();
+
+    // Zapytania mogą przeliczać stan nieaktualny po przeniesieniu połączeń (zob. `on_links_replaced`);
+    // przeliczenie jest chronione, więc wolno je wywoływać równolegle.
+    bool is_consistent() { return violations() == 0; }
+
+    std::size_t violations();
+
+    void on_link_added(const ReceiverPreferences& sender, IPackageReceiver* receiver) override;
+
+    void on_link_removed(const ReceiverPreferences& sender, IPackageReceiver* receiver) override;
+
+    // Tylko oznacza stan jako nieaktualny - przeliczenie następuje przy pierwszym zapytaniu.
+    void on_links_replaced(const ReceiverPreferences& sender) noexcept override;
+
+private:
+    enum class NodeKind : std::uint8_t {
+        RAMP, WORKER, STOREHOUSE
+    };
+
+    static constexpr std::uint32_t NONE = UINT32_MAX;
+
+    std::uint32_t add(NodeKind kind, ReceiverPreferences* preferences, IPackageReceiver* receiver);
+
+    void remove(std::uint32_t node);
+
+    void remove_outgoing(ReceiverPreferences& preferences);
+
+    std::uint32_t index_of(const ReceiverPreferences* preferences) const;
+
+    std::uint32_t index_of(const IPackageReceiver* receiver) const;
+
+    template<typename Visit>
+    void for_each_successor(std::uint32_t node, Visit&& visit) const;
+
+    template<typename Visit>
+    void for_each_predecessor(std::uint32_t node, Visit&& visit) const;
+
+    void spread_good(std::uint32_t from);
+
+    void spread_reachable(std::uint32_t from);
+
+    void retract_good(std::uint32_t from);
+
+    void retract_reachable(std::uint32_t from);
+
+    void update_violation(std::uint32_t node);
+
+    void rebuild();
+
+    std::unordered_map<const ReceiverPreferences*, std::uint32_t> sender_index_;
+    std::unordered_map<const IPackageReceiver*, std::uint32_t> receiver_index_;
+    std::vector<std::uint32_t> free_;
+
+    std::vector<NodeKind> kind_;
+    std::vector<ReceiverPreferences*> preferences_;
+    std::vector<IPackageReceiver*> receiver_;
+    std::vector<std::uint32_t> storehouse_links_;
+    // Krawędzie wychodzące do dobrych robotników i przychodzące od osiągalnych nadawców.
+    std::vector<std::uint32_t> good_links_;
+    std::vector<std::uint32_t> reachable_links_;
+    std::vector<std::uint8_t> good_;
+    std::vector<std::uint8_t> reachable_;
+    std::vector<std::uint8_t> violating_;
+    std::size_t violations_ = 0;
+
+    std::vector<std::uint32_t> work_;
+    bool bulk_ = false;
+    std::atomic<bool> stale_{false};
+    std::mutex refresh_mutex_;
+};
+
+#endif //NETSIM_CONSISTENCY_HPP
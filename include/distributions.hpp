@@ -0,0 +1,162 @@
+#ifndef NETSIM_DISTRIBUTIONS_HPP
+#define NETSIM_DISTRIBUTIONS_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "types.hpp"
+
+// Tablice zigguratu (256 warstw, Marsaglia & Tsang) liczone raz przy starcie programu.
+struct ZigguratTable {
+    static constexpr unsigned LAYERS = 256;
+
+    double r;
+    double x[LAYERS + 1];
+    double f[LAYERS + 1];
+};
+
+extern const ZigguratTable normal_ziggurat;
+extern const ZigguratTable exponential_ziggurat;
+
+// Generator `G` musi udostępniać `double next()` zwracające liczby z [0, 1).
+template<typename G>
+double sample_standard_normal(G& gen) {
+    const ZigguratTable& t = normal_ziggurat;
+    for (;;) {
+        const double u = gen.next() * ZigguratTable::LAYERS;
+        const auto i = static_cast<unsigned>(u);
+        const double x = (2 * (u - i) - 1) * t.x[i];
+        if (std::fabs(x) < t.x[i + 1]) return x;
+        if (i == 0) {
+            double a, b;
+            do {
+                a = -std::log1p(-gen.next()) / t.r;
+                b = -std::log1p(-gen.next());
+            } while (b + b < a * a);
+            return (x > 0) ? t.r + a : -(t.r + a);
+        }
+        if (t.f[i] + gen.next() * (t.f[i + 1] - t.f[i]) < std::exp(-0.5 * x * x)) return x;
+    }
+}
+
+template<typename G>
+double sample_standard_exponential(G& gen) {
+    const ZigguratTable& t = exponential_ziggurat;
+    for (;;) {
+        const double u = gen.next() * ZigguratTable::LAYERS;
+        const auto i = static_cast<unsigned>(u);
+        const double x = (u - i) * t.x[i];
+        if (x < t.x[i + 1]) return x;
+        if (i == 0) return t.r - std::log1p(-gen.next());
+        if (t.f[i] + gen.next() * (t.f[i + 1] - t.f[i]) < std::exp(-x)) return x;
+    }
+}
+
+// Metoda aliasów (Vose) - losowanie z rozkładu dyskretnego w O(1).
+class AliasTable {
+public:
+    explicit AliasTable(const std::vector<double>& weights);
+
+    std::size_t sample(double u) const {
+        const double scaled = u * prob_.size();
+        const auto i = static_cast<std::size_t>(scaled);
+        return (scaled - i < prob_[i]) ? i : alias_[i];
+    }
+
+    std::size_t size() const { return prob_.size(); }
+
+private:
+    std::vector<double> prob_;
+    std::vector<std::uint32_t> alias_;
+};
+
+enum class DistributionType {
+    FIXED, EXPONENTIAL, ERLANG, LOGNORMAL, EMPIRICAL
+};
+
+// Rozkład czasu (w turach). Zapis tekstowy używany w pliku struktury:
+//   5  exp:MEAN  erlang:K:MEAN  lognormal:MU:SIGMA  empirical:V@W,V@W,...
+// Próbki rozkładów ciągłych zaokrąglane są do pełnych tur, a wartości poniżej 1.5 dają
+// 1 turę (czas 0 zatrzymałby symulację). Średnia próbek jest więc nieco większa od `mean()`,
+// np. ok. 4.12 dla exp:4.
+class TimeDistribution {
+public:
+    // Próbka Erlanga to suma k wykładniczych - większe k czyniłoby losowanie zbyt kosztownym.
+    static constexpr unsigned MAX_ERLANG_K = 1000;
+
+    static TimeDistribution fixed(TimeOffset value);
+
+    static TimeDistribution exponential(double mean);
+
+    static TimeDistribution erlang(unsigned k, double mean);
+
+    static TimeDistribution lognormal(double mu, double sigma);
+
+    static TimeDistribution empirical(const std::vector<TimeOffset>& values, const std::vector<double>& weights);
+
+    static TimeDistribution parse(std::string_view spec);
+
+    DistributionType get_type() const { return type_; }
+
+    bool is_fixed() const { return type_ == DistributionType::FIXED; }
+
+    double mean() const;
+
+    // Wartość stała lub zaokrąglona średnia.
+    TimeOffset nominal() const;
+
+    std::string to_string() const;
+
+    template<typename G>
+    TimeOffset sample(G& gen) const {
+        double value = 0;
+        switch (type_) {
+            case DistributionType::FIXED:
+                return fixed_;
+            case DistributionType::EXPONENTIAL:
+                value = a_ * sample_standard_exponential(gen);
+                break;
+            case DistributionType::ERLANG:
+                for (unsigned stage = 0; stage < k_; ++stage) value += sample_standard_exponential(gen);
+                value *= a_;
+                break;
+            case DistributionType::LOGNORMAL:
+                value = std::exp(a_ + b_ * sample_standard_normal(gen));
+                break;
+            case DistributionType::EMPIRICAL:
+                return empirical_->values[empirical_->table.sample(gen.next())];
+        }
+        return to_turns(value);
+    }
+
+private:
+    struct Empirical {
+        std::vector<TimeOffset> values;
+        std::vector<double> weights;
+        AliasTable table;
+    };
+
+    TimeDistribution() = default;
+
+    static TimeOffset to_turns(double value) {
+        if (value < 1.5) return 1;
+        if (value >= static_cast<double>(std::numeric_limits<TimeOffset>::max())) {
+            return std::numeric_limits<TimeOffset>::max();
+        }
+        return static_cast<TimeOffset>(std::llround(value));
+    }
+
+    DistributionType type_ = DistributionType::FIXED;
+    TimeOffset fixed_ = 1;
+    unsigned k_ = 1;
+    double a_ = 0;
+    double b_ = 0;
+    std::shared_ptr<const Empirical> empirical_;
+};
+
+#endif //NETSIM_DISTRIBUTIONS_HPP
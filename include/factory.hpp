@@ -4,81 +4,376 @@
 #ifndef NETSIM_IMPLEMENTATION_FACTORY_HPP
 #define NETSIM_IMPLEMENTATION_FACTORY_HPP
 
-#include <list>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <algorithm>
 #include "types.hpp"
 #include "nodes.hpp"
-
-enum class NodeColor {
-    UNVISITED,
-    VISITED,
-    VERIFIED
-};
+#include "consistency.hpp"
 
 enum class ElementType {
     LOADING_RAMP,
     WORKER,
+    WORKER_TEMPLATE,
     STOREHOUSE,
     LINK
 };
 
+// Węzeł grafu fabryki (rampa, robotnik lub magazyn).
+struct NodeRef {
+    ElementType element_type;
+    ElementID id;
+};
+
+enum class ConsistencyProblem {
+    NO_RECEIVERS,
+    NO_REACHABLE_STOREHOUSE
+};
+
+struct ConsistencyIssue {
+    ElementType element_type;
+    ElementID id;
+    ConsistencyProblem problem;
+};
+
+// Wynik sprawdzenia spójności: węzły osiągalne z ramp, które nie mają odbiorców
+// lub z których nie da się dotrzeć do żadnego magazynu.
+struct ConsistencyReport {
+    std::vector<ConsistencyIssue> issues;
+
+    bool is_consistent() const { return issues.empty(); }
+};
+
+// Kolekcja węzłów w gniazdach (slot map). Gniazda przydzielane są blokami, więc adres
+// węzła nie zmienia się aż do jego usunięcia (polegają na tym `ReceiverPreferences`),
+// a indeks identyfikatorów daje `find_by_id` w O(1). Numer gniazda jest gęstym
+// indeksem odbiorcy (`IPackageReceiver::get_index`).
 template<typename Node>
 class NodeCollection {
 public:
-    using container_t = typename std::list<Node>;
-    using iterator = typename container_t::iterator;
-    using const_iterator = typename container_t::const_iterator;
+    // Uchwyt węzła: numer gniazda i jego generacja - po usunięciu węzła uchwyt przestaje być ważny.
+    struct Handle {
+        std::uint32_t slot;
+        std::uint32_t generation;
+    };
 
+    template<bool Const>
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Node;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const Node*, Node*>;
+        using reference = std::conditional_t<Const, const Node&, Node&>;
+        using collection_t = std::conditional_t<Const, const NodeCollection, NodeCollection>;
 
-    void add(Node&& node) { collect_.emplace_back(std::move(node)); };
+        Iterator() = default;
 
-    void remove_by_id(ElementID id) { if (collect_.end() != find_by_id(id)) collect_.erase(find_by_id(id)); }
+        Iterator(collection_t* collection, std::uint32_t slot) : collection_(collection), slot_(slot) { skip_empty(); }
+
+        template<bool C = Const, typename = std::enable_if_t<C>>
+        Iterator(const Iterator<false>& other) : collection_(other.collection_), slot_(other.slot_) {}
+
+        reference operator*() const { return *collection_->slot(slot_); }
+
+        pointer operator->() const { return &**this; }
+
+        Iterator& operator++() {
+            ++slot_;
+            skip_empty();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        friend bool operator==(const Iterator& lhs, const Iterator& rhs) { return lhs.slot_ == rhs.slot_; }
+
+        friend bool operator!=(const Iterator& lhs, const Iterator& rhs) { return lhs.slot_ != rhs.slot_; }
+
+    private:
+        template<bool> friend class Iterator;
+
+        void skip_empty() {
+            while (slot_ < collection_->slot_count_ && !collection_->slot(slot_).has_value()) ++slot_;
+        }
+
+        collection_t* collection_ = nullptr;
+        std::uint32_t slot_ = 0;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    // Robotnicy i magazyny wpisywani są do katalogu `directory`, a nadawcy kodują
+    // względem niego swoje tablice trasowania.
+    explicit NodeCollection(ReceiverDirectory* directory = nullptr) : directory_(directory) {}
+
+    // Przeniesiona kolekcja zostaje pusta.
+    NodeCollection(NodeCollection&& other) noexcept
+            : directory_(other.directory_), chunks_(std::move(other.chunks_)),
+              generations_(std::move(other.generations_)), free_slots_(std::move(other.free_slots_)),
+              index_(std::move(other.index_)), slot_count_(std::exchange(other.slot_count_, 0)) {}
+
+    NodeCollection& operator=(NodeCollection&& other) noexcept {
+        directory_ = other.directory_;
+        chunks_ = std::move(other.chunks_);
+        generations_ = std::move(other.generations_);
+        free_slots_ = std::move(other.free_slots_);
+        index_ = std::move(other.index_);
+        slot_count_ = std::exchange(other.slot_count_, 0);
+        return *this;
+    }
+
+    Handle add(Node&& node) {
+        const ElementID id = node.get_id();
+        if (index_.count(id)) throw std::invalid_argument("Duplicate node ID: " + std::to_string(id));
+
+        std::uint32_t free_slot;
+        if (free_slots_.empty()) {
+            if (slot_count_ == chunks_.size() * CHUNK) chunks_.emplace_back(new std::optional<Node>[CHUNK]);
+            free_slot = slot_count_++;
+            generations_.push_back(0);
+        } else {
+            free_slot = free_slots_.back();
+            free_slots_.pop_back();
+        }
+        place(free_slot, std::move(node));
+        index_.emplace(id, free_slot);
+        return Handle{free_slot, generations_[free_slot]};
+    };
+
+    void remove_by_id(ElementID id) {
+        auto it = index_.find(id);
+        if (it == index_.end()) return;
+        slot(it->second).reset();
+        ++generations_[it->second];
+        free_slots_.push_back(it->second);
+        index_.erase(it);
+    }
 
     iterator find_by_id(ElementID id) {
-        return std::find_if(collect_.begin(), collect_.end(),
-                            [id](auto& it) { return it.get_id() == id; });
+        auto it = index_.find(id);
+        return (it == index_.end()) ? end() : iterator(this, it->second);
     }
 
     const_iterator find_by_id(ElementID id) const {
-        return std::find_if(collect_.cbegin(), collect_.cend(), [id](const auto& it) {
-            return it.get_id() == id;
-        });
+        auto it = index_.find(id);
+        return (it == index_.end()) ? cend() : const_iterator(this, it->second);
+    }
+
+    std::optional<Handle> find_handle(ElementID id) const {
+        auto it = index_.find(id);
+        if (it == index_.end()) return std::nullopt;
+        return Handle{it->second, generations_[it->second]};
+    }
+
+    // nullptr dla uchwytu usuniętego węzła.
+    Node* get(Handle handle) { return valid(handle) ? &*slot(handle.slot) : nullptr; }
+
+    const Node* get(Handle handle) const { return valid(handle) ? &*slot(handle.slot) : nullptr; }
+
+    std::size_t size() const { return index_.size(); }
+
+    bool empty() const { return index_.empty(); }
+
+    // Przydziela z góry miejsce na `count` kolejnych węzłów (bloki gniazd, generacje, indeks).
+    void reserve(std::size_t count) {
+        const std::size_t slots = slot_count_ + count;
+        while (chunks_.size() * CHUNK < slots) chunks_.emplace_back(new std::optional<Node>[CHUNK]);
+        generations_.reserve(slots);
+        index_.reserve(index_.size() + count);
+    }
+
+    // Liczba gniazd (łącznie z wolnymi) - numery gniazd uchwytów są od niej mniejsze.
+    std::size_t slot_count() const { return slot_count_; }
+
+    // Węzeł w gnieździe `i` (nullptr dla gniazda pustego lub spoza kolekcji).
+    const Node* at_slot(std::uint32_t i) const { return (i < slot_count_ && slot(i).has_value()) ? &*slot(i) : nullptr; }
+
+    // Układ gniazd: węzeł w każdym gnieździe (brak - gniazdo puste) i kolejność wolnych gniazd.
+    struct Layout {
+        std::vector<std::optional<ElementID>> slots;
+        std::vector<std::uint32_t> free_slots;
+    };
+
+    Layout layout() const {
+        Layout result{std::vector<std::optional<ElementID>>(slot_count_), free_slots_};
+        for (std::uint32_t i = 0; i < slot_count_; ++i) {
+            if (slot(i).has_value()) result.slots[i] = slot(i)->get_id();
+        }
+        return result;
+    }
+
+    // Przenosi węzły do gniazd wskazanych przez `layout`; zbiór identyfikatorów musi się zgadzać.
+    // Uchwyty węzłów przestają być ważne (nowa generacja jest większa od wszystkich dotychczasowych).
+    void arrange(const Layout& layout) {
+        NodeCollection arranged(directory_);
+        arranged.slot_count_ = static_cast<std::uint32_t>(layout.slots.size());
+        const std::uint32_t generation = generations_.empty() ? 0 : *std::max_element(generations_.begin(), generations_.end()) + 1;
+        arranged.generations_.assign(layout.slots.size(), generation);
+        for (std::uint32_t i = 0; i < arranged.slot_count_; i += CHUNK) {
+            arranged.chunks_.emplace_back(new std::optional<Node>[CHUNK]);
+        }
+        for (std::uint32_t i = 0; i < arranged.slot_count_; ++i) {
+            if (!layout.slots[i]) continue;
+            auto it = index_.find(*layout.slots[i]);
+            if (it == index_.end() || !arranged.index_.emplace(it->first, i).second) {
+                throw std::invalid_argument("Layout does not match the nodes: " + std::to_string(*layout.slots[i]));
+            }
+        }
+        if (arranged.index_.size() != index_.size()) throw std::invalid_argument("Layout does not match the nodes!");
+        for (std::uint32_t free_slot: layout.free_slots) {
+            if (free_slot >= arranged.slot_count_ || layout.slots[free_slot]) {
+                throw std::invalid_argument("Layout has an invalid free slot!");
+            }
+        }
+        for (const auto& elem: arranged.index_) arranged.place(elem.second, std::move(*slot(index_[elem.first])));
+        arranged.free_slots_ = layout.free_slots;
+        *this = std::move(arranged);
     }
 
-    iterator begin() { return collect_.begin(); };
+    // Kopia o tym samym układzie gniazd (zachowuje kolejność iteracji i uchwyty) z katalogiem
+    // `directory`; `make(node)` tworzy kopię węzła.
+    template<typename Make>
+    NodeCollection clone(ReceiverDirectory* directory, Make&& make) const {
+        NodeCollection copy(directory);
+        copy.generations_ = generations_;
+        copy.free_slots_ = free_slots_;
+        copy.index_ = index_;
+        copy.slot_count_ = slot_count_;
+        for (std::size_t chunk = 0; chunk < chunks_.size(); ++chunk) {
+            copy.chunks_.emplace_back(new std::optional<Node>[CHUNK]);
+        }
+        for (std::uint32_t i = 0; i < slot_count_; ++i) {
+            if (slot(i).has_value()) copy.place(i, make(*slot(i)));
+        }
+        return copy;
+    }
+
+    iterator begin() { return iterator(this, 0); };
 
-    iterator end() { return collect_.end(); };
+    iterator end() { return iterator(this, slot_count_); };
 
-    const_iterator begin() const { return collect_.begin(); };
+    const_iterator begin() const { return cbegin(); };
 
-    const_iterator cbegin() const { return collect_.cbegin(); };
+    const_iterator cbegin() const { return const_iterator(this, 0); };
 
-    const_iterator end() const { return collect_.end(); };
+    const_iterator end() const { return cend(); };
 
-    const_iterator cend() const { return collect_.cend(); };
+    const_iterator cend() const { return const_iterator(this, slot_count_); };
 
 private:
-    container_t collect_;
+    static constexpr std::uint32_t CHUNK = 256;
+
+    std::optional<Node>& slot(std::uint32_t i) { return chunks_[i / CHUNK][i % CHUNK]; }
+
+    const std::optional<Node>& slot(std::uint32_t i) const { return chunks_[i / CHUNK][i % CHUNK]; }
+
+    void place(std::uint32_t i, Node&& node) {
+        slot(i).emplace(std::move(node));
+        if constexpr (std::is_base_of_v<IPackageReceiver, Node>) slot(i)->IPackageReceiver::attach(directory_, i);
+        if constexpr (std::is_base_of_v<PackageSender, Node>) slot(i)->receiver_preferences_.set_directory(directory_);
+    }
+
+    bool valid(Handle handle) const {
+        return handle.slot < slot_count_ && generations_[handle.slot] == handle.generation;
+    }
+
+    ReceiverDirectory* directory_;
+    std::vector<std::unique_ptr<std::optional<Node>[]>> chunks_;
+    std::vector<std::uint32_t> generations_;
+    std::vector<std::uint32_t> free_slots_;
+    std::unordered_map<ElementID, std::uint32_t> index_;
+    std::uint32_t slot_count_ = 0;
 };
 
 
+class ThreadPool;
+
+class CheckpointIO;
+
+class FactoryBuilder;
+
 class Factory {
 public:
-    Factory() = default;
+    Factory() : packages_(std::make_unique<PackageRegistry>()), directory_(std::make_unique<ReceiverDirectory>()),
+                ramps_(directory_.get()), workers_(directory_.get()), storehouses_(directory_.get()),
+                consistency_(std::make_unique<ConsistencyTracker>()) {}
+
+    Factory(Factory&&) = default;
+
+    Factory& operator=(Factory&& other) noexcept;
+
+    // Rozłącza całą sieć naraz w O(V + E), zamiast wypisywać każdy niszczony węzeł
+    // z preferencji jego nadawców osobno.
+    ~Factory();
+
+    // Niezależna kopia fabryki wraz ze stanem symulacji (kolejki, bufory, strumienie losowe,
+    // numery półproduktów, tura), np. do analizy "co jeśli" od wspólnego punktu. Niezmienne
+    // dane (konfiguracje robotników, rozkłady, pliki przybyć) są współdzielone, a rejestr
+    // numerów półproduktów kopiowany dopiero przy pierwszej zmianie. Półprodukty w kolejkach,
+    // stanowiskach i magazynach kopiowane są od razu - każdy trzyma numer we własnym rejestrze.
+    // Rzuca `std::logic_error` dla magazynu z własnym składowiskiem (innym niż `PackageQueue`).
+    Factory clone() const;
+
+    // Pierwsza jeszcze niesymulowana tura.
+    Time get_time() const { return time_; }
+
+    void set_time(Time t) { time_ = t; }
+
+    PackageRegistry& get_package_registry() { return *packages_; }
+
+    const PackageRegistry& get_package_registry() const { return *packages_; }
 
     void do_package_passing();
 
     void do_work(Time t);
 
-    bool is_consistent() const;
+    // O(1) - stan utrzymywany przyrostowo przy każdej zmianie struktury.
+    bool is_consistent() const { return consistency_->is_consistent(); }
+
+    // Pełny raport: iteracyjnie, w O(V + E), bez wyjątków.
+    ConsistencyReport check_consistency() const;
+
+    // Ten sam raport liczony na puli wątków (dla sieci z milionami węzłów).
+    ConsistencyReport check_consistency(ThreadPool& pool) const;
 
     void do_deliveries(Time t);
 
+    void reseed(std::uint64_t seed);
+
+    // Układa węzły w pamięci w kolejności `order` (np. według lokalności połączeń lub
+    // zaobserwowanego ruchu); pozostałe węzły trafiają za nimi w dotychczasowej kolejności,
+    // a wolne gniazda znikają. Numery węzłów, połączenia i stan symulacji się nie zmieniają,
+    // ale zmienia się kolejność odwiedzania węzłów w turze. Unieważnia iteratory i uchwyty.
+    // Zgłasza std::invalid_argument dla nieistniejącego lub powtórzonego węzła (fabryka bez zmian).
+    void reorder(const std::vector<NodeRef>& order);
 
-    void add_ramp(Ramp&& ramp) { ramps_.add(std::move(ramp)); }
+    // Rezerwuje miejsce na kolejne węzły (np. przed budowaniem dużej sieci).
+    void reserve(std::size_t ramps, std::size_t workers, std::size_t storehouses);
 
-    void remove_ramp(ElementID id) { ramps_.remove_by_id(id); }
+
+    void add_ramp(Ramp&& ramp) {
+        ramp.set_package_registry(*packages_);
+        consistency_->add_node(*ramps_.get(ramps_.add(std::move(ramp))));
+    }
+
+    void remove_ramp(ElementID id);
 
     NodeCollection<Ramp>::iterator find_ramp_by_id(ElementID id) { return ramps_.find_by_id(id); }
 
@@ -93,7 +388,7 @@ public:
     NodeCollection<Ramp>::const_iterator ramp_cend() const { return ramps_.cend(); };
 
 
-    void add_worker(Worker&& worker) { workers_.add(std::move(worker)); }
+    void add_worker(Worker&& worker) { consistency_->add_node(*workers_.get(workers_.add(std::move(worker)))); }
 
     void remove_worker(ElementID id) { remove_receiver(workers_, id); }
 
@@ -110,7 +405,19 @@ public:
     NodeCollection<Worker>::const_iterator worker_cend() const { return workers_.cend(); }
 
 
-    void add_storehouse(Storehouse&& storehouse) { storehouses_.add(std::move(storehouse)); }
+    using worker_templates_t = std::map<std::string, std::shared_ptr<const WorkerConfig>, std::less<>>;
+
+    void add_worker_template(std::shared_ptr<const WorkerConfig> config);
+
+    // nullptr, jeśli szablon o tej nazwie nie istnieje.
+    std::shared_ptr<const WorkerConfig> find_worker_template(std::string_view name) const;
+
+    const worker_templates_t& get_worker_templates() const { return worker_templates_; }
+
+
+    void add_storehouse(Storehouse&& storehouse) {
+        consistency_->add_node(*storehouses_.get(storehouses_.add(std::move(storehouse))));
+    }
 
     void remove_storehouse(ElementID id) { remove_receiver(storehouses_, id); }
 
@@ -119,40 +426,59 @@ public:
     NodeCollection<Storehouse>::const_iterator
     find_storehouse_by_id(ElementID id) const { return storehouses_.find_by_id(id); }
 
+    NodeCollection<Storehouse>::iterator storehouse_begin() { return storehouses_.begin(); }
+
+    NodeCollection<Storehouse>::iterator storehouse_end() { return storehouses_.end(); }
+
     NodeCollection<Storehouse>::const_iterator storehouse_cbegin() const { return storehouses_.cbegin(); }
 
     NodeCollection<Storehouse>::const_iterator storehouse_cend() const { return storehouses_.cend(); }
 
+    // Górne ograniczenia gęstych indeksów robotników i magazynów (`IPackageReceiver::get_index`).
+    std::size_t worker_index_bound() const { return workers_.slot_count(); }
+
+    std::size_t storehouse_index_bound() const { return storehouses_.slot_count(); }
+
+    // Czy `receiver` jest robotnikiem lub magazynem tej fabryki (indeksy różnych fabryk się powtarzają).
+    bool owns(const IPackageReceiver* receiver) const {
+        return directory_ && receiver->directory_ == directory_.get();
+    }
+
 private:
+    friend class CheckpointIO;
+    friend class FactoryBuilder;
+
     template<typename Node>
     void remove_receiver(NodeCollection<Node>& collection, ElementID id);
 
+    void disconnect();
+
+    // Śledzenie spójności od nowa (po przeniesieniu węzłów) - jednym przebiegiem w O(V + E).
+    void rebuild_consistency();
+
+    // Na stercie (adres wspólny dla półproduktów fabryki); niszczony jako ostatni.
+    std::unique_ptr<PackageRegistry> packages_;
+    // Na stercie, by tablice trasowania przetrwały przeniesienie fabryki; niszczony po węzłach.
+    std::unique_ptr<ReceiverDirectory> directory_;
+    Time time_ = 1;
     NodeCollection<Ramp> ramps_;
     NodeCollection<Worker> workers_;
     NodeCollection<Storehouse> storehouses_;
+    worker_templates_t worker_templates_;
+    // Na stercie, by adres obserwatora przetrwał przeniesienie fabryki; niszczony
+    // jako pierwszy, więc węzły nie powiadamiają go już przy własnym niszczeniu.
+    std::unique_ptr<ConsistencyTracker> consistency_;
 };
 
 template<typename Node>
 void Factory::remove_receiver(NodeCollection<Node>& collection, ElementID id) {
-    IPackageReceiver* iter = &(*collection.find_by_id(id));
+    auto node = collection.find_by_id(id);
+    if (node == collection.end()) return;
 
-    for (auto& workers: workers_) {
-        for (auto& receiver : workers.receiver_preferences_.get_preferences()) {
-            if (receiver.first == iter) {
-                workers.receiver_preferences_.remove_receiver(receiver.first);
-                break;
-            }
-        }
-    }
-    for (auto& ramps: ramps_) {
-        for (auto& receiver : ramps.receiver_preferences_.get_preferences()) {
-            if (receiver.first == iter) {
-                ramps.receiver_preferences_.remove_receiver(receiver.first);
-                break;
-            }
-        }
-    }
+    // Tylko nadawcy z indeksu krawędzi przychodzących - O(stopień węzła).
+    while (!node->get_senders().empty()) node->get_senders().back()->remove_receiver(&*node);
 
+    consistency_->remove_node(*node);
     collection.remove_by_id(id);
 }
 
@@ -165,11 +491,15 @@ struct ParsedLineData {
 
 Factory load_factory_structure(std::istream& is);
 
-void save_factory_structure(Factory& factory, std::ostream& os);
+void save_factory_structure(const Factory& factory, std::ostream& os);
 
 void tokenize(std::string& str, std::vector<std::string>& ct, char delimiter);
 
 ParsedLineData parse(const std::string& l);
 
+void set_routing_policy(PackageSender& sender, const ParsedLineData& parsed_line);
+
+std::string routing_suffix(const PackageSender& sender);
+
 #endif //NETSIM_IMPLEMENTATION_FACTORY_HPP
 #endif //NETSIM_FACTORY_HPP
@@ -0,0 +1,64 @@
+#ifndef NETSIM_FACTORY_BUILDER_HPP
+#define NETSIM_FACTORY_BUILDER_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "factory.hpp"
+
+// Połączenie nadawcy (rampa lub robotnik) z odbiorcą (robotnik lub magazyn).
+struct LinkSpec {
+    NodeRef sender;
+    NodeRef receiver;
+};
+
+// Hurtowe budowanie dużych fabryk w czasie liniowym względem rozmiaru wejścia: węzły trafiają
+// do zarezerwowanych kolekcji bez śledzenia spójności, a połączenia są zbierane i rozwiązywane
+// w `build()` jednym przejściem - każdy nadawca dostaje od razu pełną listę odbiorców
+// (z równymi prawdopodobieństwami), a stan spójności liczony jest raz na końcu.
+class FactoryBuilder {
+public:
+    FactoryBuilder();
+
+    void reserve(std::size_t ramps, std::size_t workers, std::size_t storehouses, std::size_t links);
+
+    void add_ramp(Ramp&& ramp);
+
+    void add_worker(Worker&& worker);
+
+    void add_storehouse(Storehouse&& storehouse);
+
+    void add_worker_template(std::shared_ptr<const WorkerConfig> config);
+
+    std::shared_ptr<const WorkerConfig> find_worker_template(std::string_view name) const {
+        return factory_.find_worker_template(name);
+    }
+
+    void add_ramps(std::vector<Ramp>&& ramps);
+
+    void add_workers(std::vector<Worker>&& workers);
+
+    void add_storehouses(std::vector<Storehouse>&& storehouses);
+
+    // Połączenia rozwiązywane są dopiero w `build()`, więc węzły mogą być dodane później.
+    void add_link(NodeRef sender, NodeRef receiver) { links_.push_back({sender, receiver}); }
+
+    void add_links(const std::vector<LinkSpec>& links);
+
+    // Zgłasza std::invalid_argument dla połączenia z nieistniejącym lub niewłaściwym węzłem.
+    // Po zbudowaniu builder jest pusty i można go użyć ponownie.
+    Factory build();
+
+private:
+    ReceiverPreferences* find_sender(NodeRef sender, std::size_t& index);
+
+    IPackageReceiver* find_receiver(NodeRef receiver);
+
+    Factory factory_;
+    std::vector<LinkSpec> links_;
+};
+
+#endif //NETSIM_FACTORY_BUILDER_HPP
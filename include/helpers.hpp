@@ -1,16 +1,71 @@
 #ifndef HELPERS_HPP_
 #define HELPERS_HPP_
 
+#include <cstdint>
 #include <functional>
 #include <random>
+#include <type_traits>
+#include <utility>
 
 #include "types.hpp"
+#include "random.hpp"
 
 extern std::random_device rd;
-extern std::mt19937 rng;
+extern Xoshiro256pp rng;
 
 extern double default_probability_generator();
 
+// Ziarno główne, z którego każdy węzeł wyprowadza własny strumień liczb losowych.
+void set_master_seed(std::uint64_t seed);
+
+std::uint64_t get_master_seed();
+
+enum class StreamKind : std::uint8_t {
+    RAMP_ROUTING,
+    RAMP_DELIVERY,
+    WORKER_ROUTING,
+    WORKER_PROCESSING
+};
+
+RandomStream node_stream(StreamKind kind, ElementID id, std::uint64_t seed = get_master_seed());
+
+// Generator prawdopodobieństwa przekazywany przez wartość. Domyślnie losuje
+// z własnego strumienia (lub z `rng`, jeśli strumienia nie przypisano),
+// a podstawiona funkcja (np. mock w testach) ma zawsze pierwszeństwo.
+class ProbabilityGenerator {
+public:
+    ProbabilityGenerator() = default;
+
+    ProbabilityGenerator(double (*generator)()) {
+        if (generator != default_probability_generator) custom_ = generator;
+    }
+
+    template<typename F, typename = std::enable_if_t<
+            !std::is_same_v<std::decay_t<F>, ProbabilityGenerator> &&
+            !std::is_convertible_v<F, double (*)()> &&
+            std::is_invocable_r_v<double, F&>>>
+    ProbabilityGenerator(F&& generator) : custom_(std::forward<F>(generator)) {}
+
+    double operator()() {
+        if (custom_) return custom_();
+        return has_stream_ ? buffer_.next() : rng.canonical();
+    }
+
+    bool is_default() const { return !custom_; }
+
+    void attach_stream(const RandomStream& stream) {
+        buffer_ = UniformBuffer(stream);
+        has_stream_ = true;
+    }
+
+    const RandomStream* get_stream() const { return has_stream_ ? &buffer_.stream() : nullptr; }
+
+private:
+    std::function<double()> custom_;
+    UniformBuffer buffer_;
+    bool has_stream_ = false;
+};
+
 extern ProbabilityGenerator probability_generator;
 
 #endif /* HELPERS_HPP_ */
@@ -1,22 +1,79 @@
 #ifndef NETSIM_NODES_HPP
 #define NETSIM_NODES_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
 #include <map>
 #include <memory>
 #include <functional>
 #include <utility>
 #include <optional>
+#include <string>
+#include <vector>
 #include "storage_types.hpp"
 #include "package.hpp"
 #include "helpers.hpp"
+#include "routing.hpp"
+#include "distributions.hpp"
+#include "trace.hpp"
 #include <config.hpp>
 
+class CompiledFactory;
+
+class CheckpointIO;
+
+class ReceiverPreferences;
+
 enum class ReceiverType {
     WORKER, STOREHOUSE
 };
 
+// Rodzaj odbiorcy; OTHER to odbiorcy spoza fabryki (np. atrapy w testach).
+enum class ReceiverKind : std::uint8_t {
+    WORKER, STOREHOUSE, OTHER
+};
+
+template<typename Node>
+class NodeCollection;
+
+class ReceiverDirectory;
+
 class IPackageReceiver {
 public:
+    // Indeks odbiorcy spoza fabryki.
+    static constexpr std::uint32_t NO_INDEX = std::numeric_limits<std::uint32_t>::max();
+
+    explicit IPackageReceiver(ReceiverKind kind = ReceiverKind::OTHER) : kind_(kind), sequence_(next_sequence()) {}
+
+    IPackageReceiver(const IPackageReceiver& other) : kind_(other.kind_), sequence_(next_sequence()) {}
+
+    // Przeniesiony odbiorca przejmuje indeks i krawędzie przychodzące; obiekt źródłowy
+    // zostaje bez nich.
+    IPackageReceiver(IPackageReceiver&& other) noexcept;
+
+    IPackageReceiver& operator=(const IPackageReceiver&) { return *this; }
+
+    IPackageReceiver& operator=(IPackageReceiver&&) noexcept { return *this; }
+
+    // Liczba półproduktów oczekujących u odbiorcy; odczyt bez wywołania wirtualnego.
+    std::size_t get_load() const { return load_; }
+
+    // Kolejność utworzenia odbiorcy - w przeciwieństwie do adresu nie zależy
+    // od alokatora, więc wybór odbiorcy jest powtarzalny dla danego ziarna.
+    std::uint64_t get_sequence() const { return sequence_; }
+
+    ReceiverKind get_kind() const { return kind_; }
+
+    // Gęsty indeks nadany przez fabrykę: numer gniazda w kolekcji robotników lub magazynów
+    // (NO_INDEX poza fabryką). Indeksy różnych fabryk są niezależne - `Factory::owns`
+    // sprawdza, czy odbiorca należy do danej fabryki.
+    std::uint32_t get_index() const { return index_; }
+
+    // Nadawcy, których preferencje wskazują na tego odbiorcę (krawędzie przychodzące).
+    const std::vector<ReceiverPreferences*>& get_senders() const { return senders_; }
+
     virtual ElementID get_id() const = 0;
 
     virtual ReceiverType get_receiver_type() const = 0;
@@ -32,25 +89,143 @@ public:
 
     virtual IPackageStockpile::const_iterator cend() const = 0;
 
-    virtual ~IPackageReceiver() = default;
+    // Usuwa odbiorcę z preferencji wszystkich nadawców, które wciąż na niego wskazują.
+    virtual ~IPackageReceiver();
+
+protected:
+    std::size_t load_ = 0;
+
+private:
+    static std::uint64_t next_sequence() { return next_sequence_.fetch_add(1, std::memory_order_relaxed); }
+
+    friend class ReceiverPreferences;
+    friend class CheckpointIO;
+    friend class Factory;
+    template<typename Node> friend class NodeCollection;
+
+    // Wpisuje odbiorcę do katalogu fabryki pod indeksem `index`; tablice trasowania
+    // nadawców są przeliczane przy następnym wyborze odbiorcy.
+    void attach(ReceiverDirectory* directory, std::uint32_t index);
+
+    ReceiverKind kind_;
+    std::uint32_t index_ = NO_INDEX;
+    ReceiverDirectory* directory_ = nullptr;
+    std::vector<ReceiverPreferences*> senders_;
+    std::uint64_t sequence_;
+    inline static std::atomic<std::uint64_t> next_sequence_{0};
+};
+
+// Odczyt obciążenia dla polityk trasowania (znajdowany przez ADL).
+inline std::size_t receiver_load(const IPackageReceiver* receiver) { return receiver->get_load(); }
+
+// Robotnicy i magazyny jednej fabryki według gęstego indeksu; rozwiązuje uchwyty
+// z tablic trasowania nadawców tej fabryki.
+class ReceiverDirectory {
+public:
+    IPackageReceiver* get(ReceiverKind kind, std::uint32_t index) const {
+        return entries_[static_cast<std::size_t>(kind)][index];
+    }
+
+private:
+    friend class IPackageReceiver;
+
+    void set(ReceiverKind kind, std::uint32_t index, IPackageReceiver* receiver) {
+        auto& entries = entries_[static_cast<std::size_t>(kind)];
+        if (entries.size() <= index) entries.resize(index + 1, nullptr);
+        entries[index] = receiver;
+    }
+
+    void release(ReceiverKind kind, std::uint32_t index, const IPackageReceiver* receiver) {
+        auto& entries = entries_[static_cast<std::size_t>(kind)];
+        if (index < entries.size() && entries[index] == receiver) entries[index] = nullptr;
+    }
+
+    std::vector<IPackageReceiver*> entries_[2];
+};
+
+// Odbiorca w tablicy trasowania (4 bajty): rodzaj w 2 najstarszych bitach i gęsty indeks
+// w katalogu fabryki nadawcy. Odbiorcy spoza tej fabryki mają rodzaj EXTERNAL_HANDLE
+// i indeks w liście `external_` nadawcy.
+using ReceiverHandle = std::uint32_t;
+
+// Obserwator zmian połączeń nadawcy (np. przyrostowe sprawdzanie spójności).
+class LinkObserver {
+public:
+    virtual void on_link_added(const ReceiverPreferences& sender, IPackageReceiver* receiver) = 0;
+
+    virtual void on_link_removed(const ReceiverPreferences& sender, IPackageReceiver* receiver) = 0;
+
+    // Przypisanie lub przeniesienie zastąpiło cały zbiór odbiorców. Wywoływane także
+    // z przenoszenia, dlatego nie może rzucać ani wykonywać kosztownej pracy.
+    virtual void on_links_replaced(const ReceiverPreferences& sender) noexcept = 0;
+
+    virtual ~LinkObserver() = default;
+};
+
+struct ReceiverOrder {
+    bool operator()(const IPackageReceiver* lhs, const IPackageReceiver* rhs) const {
+        return lhs->get_sequence() < rhs->get_sequence();
+    }
 };
 
 class ReceiverPreferences {
 public:
-    using preferences_t = std::map<IPackageReceiver*, double>;
+    using preferences_t = std::map<IPackageReceiver*, double, ReceiverOrder>;
     using const_iterator = preferences_t::const_iterator;
 
     explicit ReceiverPreferences(ProbabilityGenerator probability_gen = probability_generator) : probability_gen_(
             std::move(probability_gen)) {};
 
+    // Kopiowanie i przenoszenie aktualizują krawędzie przychodzące odbiorców.
+    ReceiverPreferences(const ReceiverPreferences& other);
+
+    ReceiverPreferences(ReceiverPreferences&& other) noexcept;
+
+    ReceiverPreferences& operator=(const ReceiverPreferences& other);
+
+    ReceiverPreferences& operator=(ReceiverPreferences&& other) noexcept;
+
+    ~ReceiverPreferences();
+
     void add_receiver(IPackageReceiver* r);
 
     void remove_receiver(IPackageReceiver* r);
 
+    // Dodaje odbiorców tak jak kolejne `add_receiver` (powtórzenia i już obecni są pomijani, dotychczasowe
+    // wagi skalowane proporcjonalnie), ale tablica trasowania budowana jest raz - O(k log k) zamiast O(k^2).
+    void add_receivers(std::vector<IPackageReceiver*> receivers);
+
     const preferences_t& get_preferences() const { return preferences; }
 
+    // nullptr, gdy nadawca nie ma odbiorców.
     IPackageReceiver* choose_receiver();
 
+    void set_routing_policy(RoutingPolicyType policy) { policy_ = policy; }
+
+    RoutingPolicyType get_routing_policy() const { return policy_; }
+
+    void attach_stream(const RandomStream& stream) { probability_gen_.attach_stream(stream); }
+
+    const ProbabilityGenerator& get_probability_generator() const { return probability_gen_; }
+
+    // Obserwator nie jest kopiowany ani przenoszony razem z preferencjami.
+    void set_link_observer(LinkObserver* observer) { observer_ = observer; }
+
+    // Zastępuje preferencje kopią `other` (wagi, polityka, strumień i kursor) wskazującą
+    // na odbiorców `remap(r)`; kolejność odbiorców zachowują ich numery utworzenia.
+    template<typename Remap>
+    void assign_remapped(const ReceiverPreferences& other, Remap&& remap) {
+        unlink_receivers();
+        preferences.clear();
+        for (const auto& elem: other.preferences) preferences.emplace(remap(elem.first), elem.second);
+        probability_gen_ = other.probability_gen_;
+        policy_ = other.policy_;
+        link_receivers();
+        rebuild_table();
+        table_.cursor = other.table_.cursor;
+        if (observer_) observer_->on_links_replaced(*this);
+    }
+
     //iterators
     const_iterator begin() { return preferences.begin(); }
 
@@ -64,6 +239,97 @@ public:
 
 protected:
     ProbabilityGenerator probability_gen_;
+
+private:
+    friend class CompiledFactory;
+
+    static constexpr unsigned HANDLE_KIND_SHIFT = 30;
+    static constexpr ReceiverHandle HANDLE_INDEX_MASK = (ReceiverHandle(1) << HANDLE_KIND_SHIFT) - 1;
+    static constexpr ReceiverHandle EXTERNAL_HANDLE = 3;
+
+    // Tablica trasowania z rozwiązanymi uchwytami - interfejs `RoutingTable` dla polityk.
+    struct ResolvedTable {
+        struct Receivers {
+            const ReceiverPreferences* preferences;
+
+            std::size_t size() const { return preferences->table_.receivers.size(); }
+
+            bool empty() const { return preferences->table_.receivers.empty(); }
+
+            IPackageReceiver* operator[](std::size_t i) const {
+                return preferences->resolve(preferences->table_.receivers[i]);
+            }
+        };
+
+        Receivers receivers;
+        std::size_t& cursor;
+
+        std::size_t pick_weighted(double u) const { return receivers.preferences->table_.pick_weighted(u); }
+    };
+
+    IPackageReceiver* resolve(ReceiverHandle handle) const {
+        const std::uint32_t index = handle & HANDLE_INDEX_MASK;
+        const ReceiverHandle kind = handle >> HANDLE_KIND_SHIFT;
+        return (kind == EXTERNAL_HANDLE) ? external_[index] : directory_->get(static_cast<ReceiverKind>(kind), index);
+    }
+
+    template<typename Policy>
+    IPackageReceiver* route() {
+        ResolvedTable table{{this}, table_.cursor};
+        return resolve(table_.receivers[Policy::choose(table, probability_gen_)]);
+    }
+
+    // Koduje odbiorców jako uchwyty katalogu `directory_` (kursor pozostaje bez zmian).
+    void rebuild_table();
+
+    // Nadawca trafił do fabryki o katalogu `directory`.
+    void set_directory(const ReceiverDirectory* directory) {
+        if (directory_ == directory) return;
+        directory_ = directory;
+        stale_ = true;
+    }
+
+    void link_receivers();
+
+    void unlink_receivers();
+
+    // Dopisuje nadawcę do krawędzi przychodzących `r`, zapamiętując jego pozycję.
+    void link(IPackageReceiver* r);
+
+    // Usuwa nadawcę z krawędzi przychodzących `r` w O(log k): na jego miejsce trafia ostatni nadawca.
+    void unlink(IPackageReceiver* r);
+
+    void adopt_links(ReceiverPreferences& other);
+
+    // Wywoływane przez przenoszonego odbiorcę - zmienia klucz bez zmiany kolejności i wag.
+    void rekey_receiver(IPackageReceiver* from, IPackageReceiver* to);
+
+    // Porządkuje odbiorców ponownie po zmianie ich numerów utworzenia.
+    void resort_receivers();
+
+    // Porzuca połączenia bez wypisywania się z odbiorców (gdy cała sieć jest rozłączana naraz).
+    void drop_links() {
+        preferences.clear();
+        sender_slot_.clear();
+        table_ = {};
+        external_.clear();
+        stale_ = false;
+    }
+
+    friend class IPackageReceiver;
+    friend class CheckpointIO;
+    friend class Factory;
+    template<typename Node> friend class NodeCollection;
+
+    RoutingPolicyType policy_ = RoutingPolicyType::WEIGHTED_RANDOM;
+    RoutingTable<ReceiverHandle> table_;
+    std::vector<IPackageReceiver*> external_;
+    const ReceiverDirectory* directory_ = nullptr;
+    // Odbiorca zmienił indeks lub adres - uchwyty trzeba zakodować ponownie.
+    bool stale_ = false;
+    // Pozycja tego nadawcy w `senders_` każdego odbiorcy.
+    std::map<IPackageReceiver*, std::size_t> sender_slot_;
+    LinkObserver* observer_ = nullptr;
 };
 
 class PackageSender {
@@ -75,57 +341,172 @@ public:
 
     PackageSender(PackageSender&&) = default;
 
-    void send_package();
+    // Zwraca odbiorcę wysłanego półproduktu (nullptr, gdy bufor był pusty).
+    IPackageReceiver* send_package();
 
     const opt& get_sending_buffer() const { return sending_buffer; }
 
     ReceiverPreferences receiver_preferences_;
 
 protected:
+    friend class CompiledFactory;
+    friend class CheckpointIO;
+
     opt sending_buffer;
 
     void push_package(Package&& aPackage) { sending_buffer = std::move(aPackage); }
 
 };
 
+// Przesuwa termin kolejnej dostawy rampy; zwraca true, jeśli w turze `t` następuje dostawa.
+bool advance_delivery(Time t, Time& next_delivery, TimeOffset di, const TimeDistribution& delivery_interval,
+                      UniformBuffer& delivery_rng, std::optional<ArrivalTrace>& trace);
+
 class Ramp : public PackageSender {
 public:
-    Ramp(ElementID id, TimeOffset di) : id_(id), di_(di) {};
+    Ramp(ElementID id, TimeOffset di) : Ramp(id, TimeDistribution::fixed(di)) {};
+
+    Ramp(ElementID id, TimeDistribution delivery_interval) : id_(id), di_(delivery_interval.nominal()),
+                                                             delivery_interval_(std::move(delivery_interval)) {
+        reseed(get_master_seed());
+    };
+
+    // Rampa odtwarzająca zarejestrowane przybycia; kilka przybyć w jednej turze
+    // rozkładanych jest na kolejne tury.
+    Ramp(ElementID id, ArrivalTrace trace) : Ramp(id, TimeDistribution::fixed(0)) {
+        trace_.emplace(std::move(trace));
+        auto first = trace_->next();
+        next_delivery_ = first ? std::max<Time>(*first, 1) : TIME_NEVER;
+    };
 
+    // Kopia stanu rampy (bez połączeń) z półproduktem w buforze zarejestrowanym w `registry`.
+    Ramp(const Ramp& other, PackageRegistry& registry);
+
+    // Dostawa następuje tylko w turze `get_next_delivery_time()`; w pozostałych turach to jedno porównanie.
     void deliver_goods(Time t);
 
+    // Rejestr numerów nowych półproduktów (domyślnie globalny).
+    void set_package_registry(PackageRegistry& registry) { packages_ = &registry; }
+
+    void reseed(std::uint64_t seed) {
+        receiver_preferences_.attach_stream(node_stream(StreamKind::RAMP_ROUTING, id_, seed));
+        delivery_rng_ = UniformBuffer(node_stream(StreamKind::RAMP_DELIVERY, id_, seed));
+    }
+
     TimeOffset get_delivery_interval() const { return di_; }
 
+    const TimeDistribution& get_delivery_distribution() const { return delivery_interval_; }
+
+    Time get_next_delivery_time() const { return next_delivery_; }
+
+    Time get_next_event_time(Time now) const { return sending_buffer ? now : next_delivery_; }
+
+    const std::optional<ArrivalTrace>& get_trace() const { return trace_; }
+
     ElementID get_id() const { return id_; }
 
 private:
     ElementID id_;
     TimeOffset di_;
+    TimeDistribution delivery_interval_;
+    UniformBuffer delivery_rng_;
+    std::optional<ArrivalTrace> trace_;
+    Time next_delivery_ = 1;
+    PackageRegistry* packages_ = &PackageRegistry::global();
+
+    friend class CompiledFactory;
+    friend class CheckpointIO;
 };
 
-class Worker : public IPackageReceiver, public PackageSender, public IPackageQueue {
+struct ProcessingSlot {
+    std::optional<Package> package;
+    Time start_time = 0;
+    TimeOffset duration = 0;
+    bool finished = false;
+};
+
+// Parametry robotnika współdzielone przez wszystkie instancje szablonu (WORKER_TEMPLATE).
+// Robotnik bez szablonu ma własną, nienazwaną konfigurację.
+struct WorkerConfig {
+    WorkerConfig(std::string name, TimeDistribution processing_time, PackageQueueType queue_type,
+                 unsigned servers = 1) : name(std::move(name)), processing_time(std::move(processing_time)),
+                                         queue_type(queue_type), servers(servers) {}
+
+    std::string name;
+    TimeDistribution processing_time;
+    PackageQueueType queue_type;
+    unsigned servers;
+};
+
+class Worker final : public IPackageReceiver, public PackageSender, public IPackageQueue {
 public:
-    Worker(ElementID id, TimeOffset pd, std::unique_ptr<IPackageQueue> q) : id_(id), pd_(pd), start_time_(0),
-                                                                            queue_(std::move(q)) {};
+    Worker(ElementID id, TimeOffset pd, std::unique_ptr<IPackageQueue> q, unsigned servers = 1)
+            : Worker(id, TimeDistribution::fixed(pd), std::move(q), servers) {};
+
+    Worker(ElementID id, TimeDistribution processing_time, std::unique_ptr<IPackageQueue> q, unsigned servers = 1)
+            : Worker(id, std::make_shared<const WorkerConfig>("", std::move(processing_time), q->get_queue_type(),
+                                                              servers), std::move(q)) {};
+
+    Worker(ElementID id, std::shared_ptr<const WorkerConfig> config)
+            : Worker(id, config, std::make_unique<PackageQueue>(config->queue_type)) {};
+
+    // Kopia stanu robotnika (kolejka, stanowiska, bufor, strumienie) bez połączeń;
+    // półprodukty kopii należą do `registry`.
+    Worker(const Worker& other, PackageRegistry& registry);
 
     void do_work(Time t);
 
-    TimeOffset get_processing_duration() const { return pd_; };
+    // Wysyła także półprodukty ukończone przez pozostałe stanowiska w poprzedniej turze.
+    void send_package() { send_package([](IPackageReceiver*) {}); }
+
+    template<typename OnSent>
+    void send_package(OnSent&& on_sent) {
+        if (IPackageReceiver* receiver = PackageSender::send_package()) on_sent(receiver);
+        while (release_finished()) {
+            if (IPackageReceiver* receiver = PackageSender::send_package()) on_sent(receiver);
+        }
+    }
+
+    // Najbliższa tura (>= now), w której robotnik ma coś do zrobienia, lub TIME_NEVER,
+    // jeśli czeka bezczynnie na półprodukt.
+    Time get_next_event_time(Time now) const;
+
+    void reseed(std::uint64_t seed) {
+        receiver_preferences_.attach_stream(node_stream(StreamKind::WORKER_ROUTING, id_, seed));
+        processing_rng_ = UniformBuffer(node_stream(StreamKind::WORKER_PROCESSING, id_, seed));
+    }
+
+    TimeOffset get_processing_duration() const { return config_->processing_time.nominal(); };
+
+    const TimeDistribution& get_processing_time() const { return config_->processing_time; }
 
-    Time get_package_processing_start_time() const { return start_time_; };
+    const std::shared_ptr<const WorkerConfig>& get_config() const { return config_; }
+
+    // Zmiana parametrów w trakcie symulacji (np. w odgałęzieniu "co jeśli"); liczba stanowisk
+    // musi pozostać ta sama. Półprodukty w obróbce kończą się w dotychczasowym czasie.
+    void set_config(std::shared_ptr<const WorkerConfig> config);
+
+    Time get_package_processing_start_time() const { return slots_.front().start_time; };
 
     IPackageQueue* get_queue() const { return queue_.get(); };
 
-    const std::optional<Package>& get_processing_buffer() const { return worker_buffer_; };
+    const std::optional<Package>& get_processing_buffer() const { return slots_.front().package; };
+
+    unsigned get_servers() const { return static_cast<unsigned>(slots_.size()); }
 
-    void receive_package(Package&& p) override { queue_->push(std::move(p)); };
+    const std::vector<ProcessingSlot>& get_processing_slots() const { return slots_; }
+
+    void receive_package(Package&& p) override { push(std::move(p)); };
 
     ElementID get_id() const override { return id_; };
 
     ReceiverType get_receiver_type() const override { return receiverType_; };
 
 
-    void push(Package&& p) override { queue_->push(std::move(p)); };
+    void push(Package&& p) override {
+        queue_->push(std::move(p));
+        ++load_;
+    };
 
     bool empty() const override { return queue_->empty(); };
 
@@ -133,7 +514,10 @@ public:
 
     PackageQueueType get_queue_type() const override { return queue_->get_queue_type(); };
 
-    Package pop() override { return queue_->pop(); }
+    Package pop() override {
+        --load_;
+        return queue_->pop();
+    }
 
     const_iterator begin() const override { return queue_->begin(); }
 
@@ -144,18 +528,34 @@ public:
     const_iterator cend() const override { return queue_->cend(); }
 
 private:
+    // Kolejka przekazywana przez referencję, by typ kolejki można było odczytać w tym samym wywołaniu.
+    Worker(ElementID id, std::shared_ptr<const WorkerConfig> config, std::unique_ptr<IPackageQueue>&& q)
+            : IPackageReceiver(ReceiverKind::WORKER), id_(id), config_(std::move(config)), queue_(std::move(q)),
+              slots_(config_->servers) {
+        reseed(get_master_seed());
+    };
+
+    bool release_finished();
+
     ElementID id_;
-    TimeOffset pd_;
-    Time start_time_;
+    std::shared_ptr<const WorkerConfig> config_;
+    UniformBuffer processing_rng_;
     std::unique_ptr<IPackageQueue> queue_;
-    std::optional<Package> worker_buffer_;
+    std::vector<ProcessingSlot> slots_;
     ReceiverType receiverType_ = ReceiverType::WORKER;
+
+    friend class CompiledFactory;
+    friend class CheckpointIO;
 };
 
-class Storehouse : public IPackageReceiver, public IPackageStockpile {
+class Storehouse final : public IPackageReceiver, public IPackageStockpile {
 public:
     explicit Storehouse(ElementID id, std::unique_ptr<IPackageStockpile> d = std::make_unique<PackageQueue>(
-            PackageQueue(PackageQueueType::FIFO))) : id_(id), d_(std::move(d)) {};
+            PackageQueue(PackageQueueType::FIFO))) : IPackageReceiver(ReceiverKind::STOREHOUSE), id_(id),
+                                                     d_(std::move(d)) {};
+
+    // Kopia magazynu z kopiami półproduktów zarejestrowanymi w `registry`.
+    Storehouse(const Storehouse& other, PackageRegistry& registry);
 
     void receive_package(Package&& aPackage) override { d_->push(std::move(aPackage)); }
 
@@ -181,6 +581,23 @@ private:
     ElementID id_;
     ReceiverType receiverType_ = ReceiverType::STOREHOUSE;
     std::unique_ptr<IPackageStockpile> d_;
+
+    friend class CheckpointIO;
 };
 
+// Przekazanie półproduktu bez wywołania wirtualnego dla robotników i magazynów.
+inline void deliver_package(IPackageReceiver* target, Package&& p) {
+    switch (target->get_kind()) {
+        case ReceiverKind::WORKER:
+            static_cast<Worker*>(target)->Worker::receive_package(std::move(p));
+            return;
+        case ReceiverKind::STOREHOUSE:
+            static_cast<Storehouse*>(target)->Storehouse::receive_package(std::move(p));
+            return;
+        case ReceiverKind::OTHER:
+            target->receive_package(std::move(p));
+            return;
+    }
+}
+
 #endif //NETSIM_NODES_HPP
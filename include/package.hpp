@@ -2,14 +2,59 @@
 #define NETSIM_PACKAGE_HPP
 
 #include <cmath>
+#include <memory>
 #include <set>
+#include <vector>
 
 #include "types.hpp"
 
+// Rejestr numerów półproduktów: przydziela najmniejszy zwolniony numer, a gdy takiego nie ma -
+// kolejny po największym zajętym. Kopie rejestru współdzielą zbiory numerów do pierwszej zmiany
+// (copy-on-write), więc odgałęzienie symulacji nie kopiuje ich od razu.
+class PackageRegistry {
+public:
+    PackageRegistry() : state_(std::make_shared<State>()) {}
+
+    ElementID acquire();
+
+    // Wskazany numer, jeśli jest wolny, w przeciwnym razie jak `acquire()`.
+    ElementID acquire(ElementID preferred);
+
+    void release(ElementID id);
+
+    bool is_assigned(ElementID id) const { return state_->assigned_IDs.count(id) != 0; }
+
+    std::size_t size() const { return state_->assigned_IDs.size(); }
+
+    const std::set<ElementID>& assigned_ids() const { return state_->assigned_IDs; }
+
+    const std::set<ElementID>& freed_ids() const { return state_->freed_IDs; }
+
+    // Zastępuje stan rejestru (ciągi muszą być rosnące).
+    void restore(const std::vector<ElementID>& assigned, const std::vector<ElementID>& freed);
+
+    // Rejestr półproduktów tworzonych poza fabryką.
+    static PackageRegistry& global();
+
+private:
+    struct State {
+        std::set<ElementID> assigned_IDs;
+        std::set<ElementID> freed_IDs;
+    };
+
+    State& mutable_state();
+
+    std::shared_ptr<State> state_;
+};
+
 class Package {
 public:
     Package();
     Package(ElementID);
+    explicit Package(PackageRegistry& registry);
+    // Półprodukt o numerze zajętym już w `registry` (kopia rejestru, odtwarzanie stanu).
+    Package(ElementID id, PackageRegistry& registry);
+    Package(const Package& other, PackageRegistry& registry) : Package(other.ID, registry) {}
     Package(Package&&) noexcept;
     Package& operator=(Package&&) noexcept;
 
@@ -19,8 +64,7 @@ public:
 
 private:
     ElementID ID;
-    static std::set<ElementID> assigned_IDs;
-    static std::set<ElementID> freed_IDs;
+    PackageRegistry* registry_;
 
 protected:
     void make_irrelevant() { relevance = false; }
@@ -0,0 +1,173 @@
+#ifndef NETSIM_RANDOM_HPP
+#define NETSIM_RANDOM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+inline std::uint64_t rotl64(std::uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+inline std::uint64_t splitmix64(std::uint64_t& state) {
+    std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// [0, 1) z pełnymi 53 bitami mantysy.
+inline double to_unit_double(std::uint64_t x) { return static_cast<double>(x >> 11) * (1.0 / 9007199254740992.0); }
+
+class Xoshiro256pp {
+public:
+    using result_type = std::uint64_t;
+
+    explicit Xoshiro256pp(std::uint64_t seed_value = 0) { seed(seed_value); }
+
+    void seed(std::uint64_t seed_value) {
+        for (auto& word : s_) word = splitmix64(seed_value);
+    }
+
+    static constexpr result_type min() { return 0; }
+
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()() {
+        const std::uint64_t result = rotl64(s_[0] + s_[3], 23) + s_[0];
+        const std::uint64_t t = s_[1] << 17;
+        s_[2] ^= s_[0];
+        s_[3] ^= s_[1];
+        s_[1] ^= s_[2];
+        s_[0] ^= s_[3];
+        s_[2] ^= t;
+        s_[3] = rotl64(s_[3], 45);
+        return result;
+    }
+
+    double canonical() { return to_unit_double((*this)()); }
+
+    bool operator==(const Xoshiro256pp& other) const {
+        return s_[0] == other.s_[0] && s_[1] == other.s_[1] && s_[2] == other.s_[2] && s_[3] == other.s_[3];
+    }
+
+    bool operator!=(const Xoshiro256pp& other) const { return !(*this == other); }
+
+private:
+    std::uint64_t s_[4];
+};
+
+// Philox4x32-10 (Salmon i in., "Parallel random numbers: as easy as 1, 2, 3").
+// Wynik jest czystą funkcją (licznik, klucz), więc strumień można podzielić
+// między wątki bez wpływu kolejności obliczeń na wyniki.
+inline void philox4x32_10(std::uint32_t ctr[4], std::uint32_t k0, std::uint32_t k1) {
+    for (int round = 0; round < 10; ++round) {
+        const std::uint64_t p0 = static_cast<std::uint64_t>(0xD2511F53U) * ctr[0];
+        const std::uint64_t p1 = static_cast<std::uint64_t>(0xCD9E8D57U) * ctr[2];
+        const auto hi0 = static_cast<std::uint32_t>(p0 >> 32), lo0 = static_cast<std::uint32_t>(p0);
+        const auto hi1 = static_cast<std::uint32_t>(p1 >> 32), lo1 = static_cast<std::uint32_t>(p1);
+        ctr[0] = hi1 ^ ctr[1] ^ k0;
+        ctr[1] = lo1;
+        ctr[2] = hi0 ^ ctr[3] ^ k1;
+        ctr[3] = lo0;
+        k0 += 0x9E3779B9U;
+        k1 += 0xBB67AE85U;
+    }
+}
+
+class RandomStream {
+public:
+    using result_type = std::uint64_t;
+
+    RandomStream() : RandomStream(0, 0) {}
+
+    RandomStream(std::uint64_t master_seed, std::uint64_t stream_id) {
+        std::uint64_t state = master_seed;
+        std::uint64_t key = splitmix64(state) ^ stream_id;
+        key = splitmix64(key);
+        key_[0] = static_cast<std::uint32_t>(key);
+        key_[1] = static_cast<std::uint32_t>(key >> 32);
+    }
+
+    // Strumień o zadanym kluczu (odtwarzanie zapisanego stanu).
+    static RandomStream from_key(std::uint32_t key0, std::uint32_t key1, std::uint64_t position) {
+        RandomStream stream;
+        stream.key_[0] = key0;
+        stream.key_[1] = key1;
+        stream.position_ = position;
+        return stream;
+    }
+
+    static constexpr result_type min() { return 0; }
+
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    // n-ta liczba strumienia: połowa bloku Philoxa dla licznika n / 2.
+    result_type at(std::uint64_t n) const {
+        std::uint32_t ctr[4] = {static_cast<std::uint32_t>(n >> 1), static_cast<std::uint32_t>(n >> 33), 0, 0};
+        philox4x32_10(ctr, key_[0], key_[1]);
+        const unsigned half = static_cast<unsigned>(n & 1U) * 2;
+        return (static_cast<std::uint64_t>(ctr[half + 1]) << 32) | ctr[half];
+    }
+
+    result_type operator()() { return at(position_++); }
+
+    double canonical() { return to_unit_double((*this)()); }
+
+    std::uint64_t position() const { return position_; }
+
+    void seek(std::uint64_t position) { position_ = position; }
+
+    std::uint32_t key0() const { return key_[0]; }
+
+    std::uint32_t key1() const { return key_[1]; }
+
+    bool operator==(const RandomStream& other) const {
+        return key_[0] == other.key_[0] && key_[1] == other.key_[1] && position_ == other.position_;
+    }
+
+    bool operator!=(const RandomStream& other) const { return !(*this == other); }
+
+private:
+    std::uint32_t key_[2];
+    std::uint64_t position_ = 0;
+};
+
+// Wypełnia `out[i] = to_unit_double(stream.at(first + i))` dla i < count
+// (`first` i `count` muszą być parzyste). Wersja wektorowa (AVX2) wybierana
+// jest w czasie działania; wynik jest bitowo identyczny z wersją skalarną.
+void generate_uniform_batch(const RandomStream& stream, std::uint64_t first, double* out, std::size_t count);
+
+void generate_uniform_batch_scalar(const RandomStream& stream, std::uint64_t first, double* out, std::size_t count);
+
+bool uniform_batch_is_vectorized();
+
+// Bufor liczb z [0, 1) dla strumienia - uzupełniany hurtowo przez `generate_uniform_batch`.
+class UniformBuffer {
+public:
+    static constexpr std::size_t SIZE = 16;
+
+    UniformBuffer() = default;
+
+    explicit UniformBuffer(const RandomStream& stream) : stream_(stream) {}
+
+    double next() {
+        const std::uint64_t position = stream_.position();
+        if (position - base_ >= SIZE) refill(position);
+        stream_.seek(position + 1);
+        return values_[position - base_];
+    }
+
+    // Strumień ustawiony na pierwszą nieskonsumowaną liczbę.
+    const RandomStream& stream() const { return stream_; }
+
+private:
+    void refill(std::uint64_t position) {
+        base_ = position - position % SIZE;
+        generate_uniform_batch(stream_, base_, values_, SIZE);
+    }
+
+    RandomStream stream_;
+    std::uint64_t base_ = std::numeric_limits<std::uint64_t>::max() - SIZE;
+    double values_[SIZE] = {};
+};
+
+#endif //NETSIM_RANDOM_HPP
@@ -0,0 +1,23 @@
+#ifndef NETSIM_REORDERING_HPP
+#define NETSIM_REORDERING_HPP
+
+#include <vector>
+
+#include "factory.hpp"
+
+// BREADTH_FIRST         - przeszukiwanie wszerz od ramp wzdłuż połączeń (odbiorcy w kolejności
+//                         preferencji), więc odbiorcy wspólnego nadawcy leżą obok siebie;
+// REVERSE_CUTHILL_MCKEE - odwrócony Cuthill-McKee na grafie nieskierowanym (sąsiedzi według
+//                         rosnącego stopnia), minimalizuje rozpiętość połączeń.
+enum class NodeOrdering {
+    BREADTH_FIRST, REVERSE_CUTHILL_MCKEE
+};
+
+// Kolejność wszystkich węzłów fabryki poprawiająca lokalność odwołań w pamięci - O(V + E)
+// (RCM: O(V + E log d)). Zależy tylko od struktury, nie od obecnego układu węzłów.
+std::vector<NodeRef> locality_order(const Factory& factory, NodeOrdering ordering = NodeOrdering::BREADTH_FIRST);
+
+// factory.reorder(locality_order(factory, ordering)).
+void reorder_for_locality(Factory& factory, NodeOrdering ordering = NodeOrdering::BREADTH_FIRST);
+
+#endif //NETSIM_REORDERING_HPP
@@ -0,0 +1,82 @@
+#ifndef NETSIM_RESULT_CACHE_HPP
+#define NETSIM_RESULT_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "factory.hpp"
+
+// Kanoniczny skrót struktury: węzły z parametrami (rozkłady, kolejki, stanowiska, trasowanie,
+// zawartość plików przybyć) i połączenia z wagami. Nie zależy od kolejności wstawiania węzłów
+// ani od ich układu w pamięci - dwie fabryki o tej samej treści mają ten sam skrót.
+// Zgłasza std::logic_error dla preferencji z własnym generatorem prawdopodobieństwa.
+std::uint64_t structure_hash(const Factory& factory);
+
+// Skrót tego, co `structure_hash` celowo pomija, a od czego zależy przebieg symulacji przy
+// danym ziarnie: kolejność odwiedzania węzłów w turze i kolejność odbiorców w preferencjach.
+std::uint64_t execution_order_hash(const Factory& factory);
+
+// Klucz scenariusza: fabryka przed pierwszą turą, ziarno i liczba tur.
+struct ScenarioKey {
+    std::uint64_t structure = 0;
+    std::uint64_t execution_order = 0;
+    std::uint64_t seed = 0;
+    TimeOffset turns = 0;
+
+    bool operator==(const ScenarioKey& other) const {
+        return structure == other.structure && execution_order == other.execution_order && seed == other.seed &&
+               turns == other.turns;
+    }
+
+    bool operator!=(const ScenarioKey& other) const { return !(*this == other); }
+};
+
+// Zgłasza std::logic_error dla fabryki, która ma już stan symulacji.
+ScenarioKey scenario_key(const Factory& factory, std::uint64_t seed, TimeOffset turns);
+
+// Podsumowanie symulacji: liczba półproduktów w fabryce, zawartość magazynów
+// i długości kolejek robotników (rosnąco według numerów).
+struct SimulationSummary {
+    std::size_t packages = 0;
+    std::vector<std::pair<ElementID, std::size_t>> storehouse_stock;
+    std::vector<std::pair<ElementID, std::size_t>> worker_queues;
+
+    bool operator==(const SimulationSummary& other) const {
+        return packages == other.packages && storehouse_stock == other.storehouse_stock &&
+               worker_queues == other.worker_queues;
+    }
+
+    bool operator!=(const SimulationSummary& other) const { return !(*this == other); }
+};
+
+SimulationSummary summarize(const Factory& factory);
+
+// Podsumowania symulacji w katalogu, po jednym pliku na scenariusz. Zapis jest atomowy
+// (plik tymczasowy i zmiana nazwy), a plik przechowuje pełny klucz, więc uszkodzony
+// lub niepasujący wpis traktowany jest jak brak wpisu.
+class ResultCache {
+public:
+    // Tworzy katalog, jeśli nie istnieje.
+    explicit ResultCache(std::string directory);
+
+    const std::string& directory() const { return directory_; }
+
+    std::optional<SimulationSummary> find(const ScenarioKey& key) const;
+
+    void store(const ScenarioKey& key, const SimulationSummary& summary) const;
+
+    // Podsumowanie z pamięci podręcznej (fabryka pozostaje nietknięta) albo symulacja
+    // `turns` tur z ziarnem `seed` i zapisanie wyniku.
+    SimulationSummary run(Factory& factory, std::uint64_t seed, TimeOffset turns) const;
+
+private:
+    std::string path_of(const ScenarioKey& key) const;
+
+    std::string directory_;
+};
+
+#endif //NETSIM_RESULT_CACHE_HPP
@@ -0,0 +1,74 @@
+#ifndef NETSIM_ROUTING_HPP
+#define NETSIM_ROUTING_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class RoutingPolicyType {
+    WEIGHTED_RANDOM, ROUND_ROBIN, JOIN_SHORTEST_QUEUE, POWER_OF_TWO_CHOICES
+};
+
+std::optional<RoutingPolicyType> routing_policy_from_string(std::string_view name);
+
+std::string to_string(RoutingPolicyType policy);
+
+// Gęsta tablica odbiorców nadawcy (w kolejności preferencji) wraz ze skumulowanymi
+// prawdopodobieństwami. Polityki operują wyłącznie na niej, a `receiver_load(Receiver)`
+// (znajdowane przez ADL) musi być niewirtualnym odczytem licznika (O(1)). Polityki przyjmują
+// dowolną tablicę o tym samym interfejsie (np. widok wiersza CSR w `CompiledFactory`).
+template<typename Receiver>
+struct RoutingTable {
+    std::vector<Receiver> receivers;
+    std::vector<double> cumulative;
+    std::size_t cursor = 0;
+
+    std::size_t pick_weighted(double u) const {
+        auto it = std::lower_bound(cumulative.begin(), cumulative.end(), u);
+        return (it == cumulative.end()) ? cumulative.size() - 1 : static_cast<std::size_t>(it - cumulative.begin());
+    }
+};
+
+struct WeightedRandomPolicy {
+    template<typename Table, typename Generator>
+    static std::size_t choose(Table& table, Generator& gen) { return table.pick_weighted(gen()); }
+};
+
+struct RoundRobinPolicy {
+    template<typename Table, typename Generator>
+    static std::size_t choose(Table& table, Generator&) {
+        std::size_t chosen = table.cursor % table.receivers.size();
+        table.cursor = chosen + 1;
+        return chosen;
+    }
+};
+
+struct JoinShortestQueuePolicy {
+    // Remisy rozstrzygane są rotacyjnie, by przy pustych kolejkach nie faworyzować pierwszego odbiorcy.
+    template<typename Table, typename Generator>
+    static std::size_t choose(Table& table, Generator&) {
+        const std::size_t n = table.receivers.size();
+        const std::size_t start = table.cursor % n;
+        std::size_t best = start;
+        for (std::size_t k = 1; k < n; ++k) {
+            std::size_t i = (start + k) % n;
+            if (receiver_load(table.receivers[i]) < receiver_load(table.receivers[best])) best = i;
+        }
+        table.cursor = start + 1;
+        return best;
+    }
+};
+
+struct PowerOfTwoChoicesPolicy {
+    template<typename Table, typename Generator>
+    static std::size_t choose(Table& table, Generator& gen) {
+        std::size_t first = table.pick_weighted(gen());
+        std::size_t second = table.pick_weighted(gen());
+        return (receiver_load(table.receivers[second]) < receiver_load(table.receivers[first])) ? second : first;
+    }
+};
+
+#endif //NETSIM_ROUTING_HPP
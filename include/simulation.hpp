@@ -9,5 +9,8 @@
 
 void simulate(Factory& factory, TimeOffset timeOffset, const std::function<void(Factory&, Time)>& rf);
 
+// Symulacja bez raportów: fabryka jest zamrażana (`CompiledFactory`), a stan wraca do niej po ostatniej turze.
+void simulate(Factory& factory, TimeOffset timeOffset);
+
 
 #endif //NETSIM_SIMULATION_HPP
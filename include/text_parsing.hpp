@@ -0,0 +1,28 @@
+#ifndef NETSIM_TEXT_PARSING_HPP
+#define NETSIM_TEXT_PARSING_HPP
+
+#include <charconv>
+#include <optional>
+#include <string_view>
+#include <system_error>
+
+// Liczba zajmująca cały tekst (bez spacji, znaku '+' i dodatkowych znaków na końcu);
+// std::nullopt, gdy tekst nie jest liczbą lub jest poza zakresem typu `T`.
+template<typename T>
+std::optional<T> parse_number(std::string_view text) {
+    T value{};
+    const char* last = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), last, value);
+    if (ec != std::errc() || ptr != last || text.empty()) return std::nullopt;
+    return value;
+}
+
+// Odcina z początku `text` pole kończące się separatorem `delimiter` (separator jest pomijany).
+inline std::string_view next_field(std::string_view& text, char delimiter) {
+    const std::size_t end = text.find(delimiter);
+    const std::string_view field = text.substr(0, end);
+    text.remove_prefix((end == std::string_view::npos) ? text.size() : end + 1);
+    return field;
+}
+
+#endif //NETSIM_TEXT_PARSING_HPP
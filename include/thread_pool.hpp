@@ -0,0 +1,54 @@
+#ifndef NETSIM_THREAD_POOL_HPP
+#define NETSIM_THREAD_POOL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Stała pula wątków wykonujących to samo zadanie w fazach (fork-join). Wątek wywołujący
+// `run` bierze udział w pracy jako wykonawca nr 0. Zadania nie mogą zgłaszać wyjątków.
+class ThreadPool {
+public:
+    // 0 - liczba wątków sprzętowych.
+    explicit ThreadPool(unsigned threads = 0);
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool();
+
+    unsigned size() const { return static_cast<unsigned>(threads_.size()) + 1; }
+
+    // Wywołuje `task(i)` dla każdego i z [0, size()) i czeka na zakończenie wszystkich.
+    void run(const std::function<void(unsigned)>& task);
+
+    // Dzieli [0, n) na size() spójnych przedziałów i wywołuje `body(begin, end, i)`.
+    template<typename Body>
+    void parallel_for(std::size_t n, Body&& body) {
+        const std::size_t chunk = (n + size() - 1) / size();
+        run([&](unsigned i) {
+            const std::size_t begin = std::min(n, i * chunk);
+            const std::size_t end = std::min(n, begin + chunk);
+            if (begin != end) body(begin, end, i);
+        });
+    }
+
+private:
+    void work(unsigned index);
+
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    const std::function<void(unsigned)>* task_ = nullptr;
+    std::size_t generation_ = 0;
+    unsigned pending_ = 0;
+    bool stop_ = false;
+};
+
+#endif //NETSIM_THREAD_POOL_HPP
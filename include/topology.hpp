@@ -0,0 +1,55 @@
+#ifndef NETSIM_TOPOLOGY_HPP
+#define NETSIM_TOPOLOGY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <string>
+
+#include "distributions.hpp"
+#include "factory.hpp"
+
+// Kształt generowanej sieci:
+//   LAYERED       - warstwowy DAG: rampy -> warstwa 1 -> ... -> warstwa N -> magazyny,
+//   RANDOM        - losowy graf o zadanym stopniu wyjściowym (z cyklami),
+//   RECIRCULATING - warstwowy DAG z krawędziami wstecz (pętle poprawek),
+//   FAN_IN        - jedna szeroka warstwa robotników zbiegająca się w kilku magazynach.
+enum class TopologyShape {
+    LAYERED, RANDOM, RECIRCULATING, FAN_IN
+};
+
+std::optional<TopologyShape> topology_shape_from_string(const std::string& name);
+
+std::string to_string(TopologyShape shape);
+
+struct TopologySpec {
+    TopologyShape shape = TopologyShape::LAYERED;
+    std::size_t ramps = 1;
+    std::size_t workers = 16;
+    std::size_t storehouses = 1;
+    // LAYERED i RECIRCULATING: liczba warstw robotników.
+    std::size_t layers = 4;
+    // Liczba losowanych odbiorców każdego nadawcy (powtórzenia są pomijane).
+    std::size_t fan_out = 2;
+    // RECIRCULATING: prawdopodobieństwo krawędzi wstecz z robotnika spoza pierwszej warstwy.
+    double back_edge_probability = 0.1;
+    // RANDOM: prawdopodobieństwo, że robotnik przekazuje półprodukty wprost do magazynu.
+    double exit_probability = 0.1;
+    std::uint64_t seed = 1;
+    TimeDistribution delivery_interval = TimeDistribution::fixed(1);
+    TimeDistribution processing_time = TimeDistribution::fixed(1);
+    PackageQueueType queue_type = PackageQueueType::FIFO;
+};
+
+// Każda wygenerowana sieć jest spójna, a każdy węzeł ma nadawcę (rampy - odbiorcę), więc
+// cała sieć bierze udział w symulacji. Wynik zależy tylko od `spec` (także od ziarna).
+// Zgłaszają std::invalid_argument dla niepoprawnych parametrów.
+
+// Strumieniowo, w formacie `load_factory_structure` - pamięć nie zależy od rozmiaru sieci.
+void write_topology(const TopologySpec& spec, std::ostream& os);
+
+// Ta sama sieć zbudowana bezpośrednio w pamięci (przez `FactoryBuilder`).
+Factory generate_topology(const TopologySpec& spec);
+
+#endif //NETSIM_TOPOLOGY_HPP
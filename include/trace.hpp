@@ -0,0 +1,93 @@
+#ifndef NETSIM_TRACE_HPP
+#define NETSIM_TRACE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "types.hpp"
+
+// Plik tylko do odczytu zmapowany w pamięci (mmap) z dostępem sekwencyjnym.
+// Strony już przeczytane są zwalniane, a kolejne zapowiadane jądru z wyprzedzeniem,
+// dzięki czemu zajęta pamięć nie zależy od długości pliku. Bez mmap (lub gdy
+// mapowanie się nie uda) plik czytany jest blokami przez `read`.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    // nullptr, gdy plik nie jest zmapowany.
+    const char* data() const { return data_; }
+
+    bool is_mapped() const { return mapped_; }
+
+    std::size_t size() const { return size_; }
+
+    const std::string& path() const { return path_; }
+
+    // Zgłasza, że czytelnik doszedł do `offset` (zwalnia zaległe strony i ładuje kolejne).
+    void advise_consumed(std::size_t offset) const;
+
+    // Kopiuje do `out` co najwyżej `count` bajtów od `offset`; zwraca liczbę skopiowanych.
+    std::size_t read(std::size_t offset, char* out, std::size_t count) const;
+
+private:
+    std::string path_;
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+    bool mapped_ = false;
+    // Początek jeszcze nie zwolnionych stron zmapowanego pliku.
+    mutable std::atomic<std::size_t> released_{0};
+    // Plik niezmapowany pozostaje otwarty: POSIX czyta przez `pread`, inne systemy
+    // przez jeden strumień chroniony muteksem (kopie śladu współdzielą plik).
+    int fd_ = -1;
+    mutable std::ifstream stream_;
+    mutable std::mutex stream_mutex_;
+};
+
+// Strumień znaczników czasu przybycia (jedna tura w wierszu; puste wiersze
+// i komentarze "; ..." są pomijane). Kopie współdzielą zmapowany plik; plik
+// niezmapowany każda kopia czyta własnym blokiem o stałym rozmiarze.
+class ArrivalTrace {
+public:
+    explicit ArrivalTrace(const std::string& path);
+
+    // Zgłasza std::runtime_error dla wpisu, który nie jest liczbą lub nie mieści się w `Time`.
+    std::optional<Time> next();
+
+    const std::string& path() const { return file_->path(); }
+
+    std::size_t offset() const { return offset_; }
+
+    void seek(std::size_t offset) { offset_ = offset; }
+
+private:
+    // Znak pod `offset_` lub -1 na końcu pliku.
+    int peek() {
+        if (offset_ - window_begin_ >= window_size_ && !refill()) return -1;
+        const char* base = file_->is_mapped() ? file_->data() : chunk_.data();
+        return static_cast<unsigned char>(base[offset_ - window_begin_]);
+    }
+
+    bool refill();
+
+    std::shared_ptr<const MappedFile> file_;
+    std::size_t offset_ = 0;
+    std::size_t advised_ = 0;
+    // Dostępny fragment pliku: cały plik zmapowany albo ostatnio wczytany blok `chunk_`.
+    std::size_t window_begin_ = 0;
+    std::size_t window_size_ = 0;
+    std::vector<char> chunk_;
+};
+
+#endif //NETSIM_TRACE_HPP
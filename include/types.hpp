@@ -2,11 +2,13 @@
 #define NETSIM_TYPES_HPP
 
 #include <functional>
+#include <limits>
 #include <map>
 
 using ElementID = unsigned int;
 using Time = unsigned int;
 using TimeOffset = unsigned int;
-using ProbabilityGenerator = std::function<double()>;
+
+constexpr Time TIME_NEVER = std::numeric_limits<Time>::max();
 
 #endif //NETSIM_TYPES_HPP
\ No newline at end of file
@@ -2,7 +2,12 @@
 #include "gtest/gtest.h"
 
 #include "factory.hpp"
+#include "factory_builder.hpp"
 #include "nodes.hpp"
+#include "thread_pool.hpp"
+
+#include <random>
+#include <set>
 
 // DEBUG
 #include <iostream>
@@ -140,3 +145,418 @@ TEST(FactoryTest, RemoveWorkerTwoRemainingReceivers) {
     ASSERT_NE(it, prefs.end());
     EXPECT_DOUBLE_EQ(it->second, 1.0 / 2.0);
 }
+
+TEST(NodeCollectionTest, HandlesAndAddressesSurviveGrowth) {
+    NodeCollection<Storehouse> storehouses;
+    auto first = storehouses.add(Storehouse(1));
+    const Storehouse* address = &*storehouses.find_by_id(1);
+
+    for (ElementID id = 2; id <= 1000; ++id) storehouses.add(Storehouse(id));
+    EXPECT_EQ(&*storehouses.find_by_id(1), address);
+    EXPECT_EQ(storehouses.get(first), address);
+    EXPECT_EQ(storehouses.find_by_id(500)->get_id(), 500U);
+    EXPECT_EQ(storehouses.size(), 1000U);
+    EXPECT_THROW(storehouses.add(Storehouse(7)), std::invalid_argument);
+
+    storehouses.remove_by_id(1);
+    EXPECT_EQ(storehouses.get(first), nullptr);
+    EXPECT_EQ(storehouses.find_by_id(1), storehouses.end());
+
+    auto reused = storehouses.add(Storehouse(1001));
+    EXPECT_EQ(reused.slot, first.slot);
+    EXPECT_EQ(storehouses.get(first), nullptr);
+
+    std::size_t visited = 0;
+    for (const auto& storehouse : storehouses) visited += (storehouse.get_id() != 1) ? 1 : 0;
+    EXPECT_EQ(visited, 1000U);
+}
+
+TEST(FactoryTest, IncomingLinksFollowMovesAndRemovals) {
+    Worker w(1, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO));
+    Ramp r(1, 1);
+    r.receiver_preferences_.add_receiver(&w);
+    ASSERT_EQ(w.get_senders().size(), 1U);
+
+    // Przeniesienie odbiorcy zmienia klucz w preferencjach nadawcy.
+    Factory factory;
+    factory.add_worker(std::move(w));
+    Worker& moved = *factory.find_worker_by_id(1);
+    EXPECT_EQ(r.receiver_preferences_.get_preferences().count(&moved), 1U);
+    EXPECT_EQ(r.receiver_preferences_.choose_receiver(), &moved);
+    EXPECT_TRUE(w.get_senders().empty());
+
+    // Przeniesienie nadawcy aktualizuje indeks krawędzi przychodzących.
+    factory.add_ramp(std::move(r));
+    Ramp& ramp = *factory.find_ramp_by_id(1);
+    ASSERT_EQ(moved.get_senders().size(), 1U);
+    EXPECT_EQ(moved.get_senders().front(), &ramp.receiver_preferences_);
+
+    factory.remove_worker(1);
+    EXPECT_TRUE(ramp.receiver_preferences_.get_preferences().empty());
+}
+
+TEST(FactoryTest, ReceiverIndicesArePerFactory) {
+    Factory a;
+    Factory b;
+    for (Factory* factory: {&a, &b}) {
+        factory->add_worker(Worker(1, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+        factory->add_storehouse(Storehouse(1));
+    }
+    const Worker& wa = *a.find_worker_by_id(1);
+    const Worker& wb = *b.find_worker_by_id(1);
+    EXPECT_EQ(wa.get_index(), 0U);
+    EXPECT_EQ(wb.get_index(), 0U);
+    EXPECT_EQ(a.find_storehouse_by_id(1)->get_index(), 0U);
+    EXPECT_TRUE(a.owns(&wa));
+    EXPECT_FALSE(a.owns(&wb));
+    EXPECT_EQ(a.worker_index_bound(), 1U);
+
+    // Zwolnione gniazdo - i indeks - przejmuje kolejny robotnik.
+    a.add_worker(Worker(2, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    a.remove_worker(1);
+    a.add_worker(Worker(3, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    EXPECT_EQ(a.find_worker_by_id(3)->get_index(), 0U);
+    EXPECT_EQ(a.find_worker_by_id(2)->get_index(), 1U);
+
+    Storehouse loose(9);
+    EXPECT_FALSE(a.owns(&loose));
+}
+
+TEST(FactoryTest, RoutingHandlesFollowRelocatedReceivers) {
+    static_assert(sizeof(ReceiverHandle) == 4, "Routing entries are 4-byte handles");
+    Factory factory;
+    factory.add_ramp(Ramp(1, 1));
+    for (ElementID id = 1; id <= 3; ++id) {
+        factory.add_worker(Worker(id, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    }
+    Storehouse loose(7);
+    ReceiverPreferences& linked = factory.find_ramp_by_id(1)->receiver_preferences_;
+    linked.set_routing_policy(RoutingPolicyType::ROUND_ROBIN);
+    for (ElementID id = 1; id <= 3; ++id) linked.add_receiver(&*factory.find_worker_by_id(id));
+    linked.add_receiver(&loose);
+
+    factory.remove_worker(2);
+    factory.reorder({{ElementType::WORKER, 3}, {ElementType::WORKER, 1}, {ElementType::LOADING_RAMP, 1}});
+    // Kolejność preferencji (utworzenia odbiorców) jest zachowana; magazyn spoza fabryki też.
+    ReceiverPreferences& preferences = factory.find_ramp_by_id(1)->receiver_preferences_;
+    EXPECT_EQ(preferences.choose_receiver(), &*factory.find_worker_by_id(1));
+    EXPECT_EQ(preferences.choose_receiver(), &*factory.find_worker_by_id(3));
+    EXPECT_EQ(preferences.choose_receiver(), &loose);
+
+    Factory copy = factory.clone();
+    ReceiverPreferences& copied = copy.find_ramp_by_id(1)->receiver_preferences_;
+    std::set<IPackageReceiver*> chosen;
+    for (int i = 0; i < 3; ++i) chosen.insert(copied.choose_receiver());
+    EXPECT_EQ(chosen, (std::set<IPackageReceiver*>{&*copy.find_worker_by_id(1), &*copy.find_worker_by_id(3), &loose}));
+    preferences.remove_receiver(&loose);
+    copied.remove_receiver(&loose);
+}
+
+TEST(FactoryTest, ConsistencyReportListsOffendingNodes) {
+    // R1 -> W1 -> S,  R2 -> W1,  W1 -> W2 -> W2,  R3 (brak odbiorców)
+    Factory factory;
+    factory.add_ramp(Ramp(1, 1));
+    factory.add_ramp(Ramp(2, 1));
+    factory.add_ramp(Ramp(3, 1));
+    factory.add_worker(Worker(1, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    factory.add_worker(Worker(2, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    factory.add_storehouse(Storehouse(1));
+
+    Worker& w1 = *factory.find_worker_by_id(1);
+    Worker& w2 = *factory.find_worker_by_id(2);
+    factory.find_ramp_by_id(1)->receiver_preferences_.add_receiver(&w1);
+    factory.find_ramp_by_id(2)->receiver_preferences_.add_receiver(&w1);
+    w1.receiver_preferences_.add_receiver(&(*factory.find_storehouse_by_id(1)));
+    w1.receiver_preferences_.add_receiver(&w2);
+    w2.receiver_preferences_.add_receiver(&w2);
+
+    auto report = factory.check_consistency();
+    ASSERT_EQ(report.issues.size(), 2U);
+    EXPECT_EQ(report.issues[0].element_type, ElementType::LOADING_RAMP);
+    EXPECT_EQ(report.issues[0].id, 3U);
+    EXPECT_EQ(report.issues[0].problem, ConsistencyProblem::NO_RECEIVERS);
+    EXPECT_EQ(report.issues[1].element_type, ElementType::WORKER);
+    EXPECT_EQ(report.issues[1].id, 2U);
+    EXPECT_EQ(report.issues[1].problem, ConsistencyProblem::NO_REACHABLE_STOREHOUSE);
+
+    w2.receiver_preferences_.add_receiver(&(*factory.find_storehouse_by_id(1)));
+    factory.find_ramp_by_id(3)->receiver_preferences_.add_receiver(&w2);
+    EXPECT_TRUE(factory.is_consistent());
+}
+
+TEST(FactoryTest, MovedPreferencesUpdateConsistency) {
+    // R -> W -> S; przeniesienie połączeń robotnika poza fabrykę zostawia go bez odbiorców.
+    Factory factory;
+    factory.add_ramp(Ramp(1, 1));
+    factory.add_worker(Worker(1, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    factory.add_storehouse(Storehouse(1));
+    Worker& w = *(factory.find_worker_by_id(1));
+    factory.find_ramp_by_id(1)->receiver_preferences_.add_receiver(&w);
+    w.receiver_preferences_.add_receiver(&(*factory.find_storehouse_by_id(1)));
+    ASSERT_TRUE(factory.is_consistent());
+
+    ReceiverPreferences moved(std::move(w.receiver_preferences_));
+    EXPECT_FALSE(factory.is_consistent());
+
+    w.receiver_preferences_ = std::move(moved);
+    EXPECT_TRUE(factory.is_consistent());
+
+    // Kolejne zmiany po przeliczeniu znów są śledzone przyrostowo.
+    w.receiver_preferences_.remove_receiver(&(*factory.find_storehouse_by_id(1)));
+    EXPECT_FALSE(factory.is_consistent());
+}
+
+TEST(FactoryTest, ExternalNodesOutliveFactory) {
+    Storehouse outside(7);
+    Ramp feeder(7, 1);
+    {
+        Factory factory;
+        factory.add_ramp(Ramp(1, 1));
+        factory.add_worker(Worker(1, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+        Worker& w = *(factory.find_worker_by_id(1));
+        factory.find_ramp_by_id(1)->receiver_preferences_.add_receiver(&outside);
+        w.receiver_preferences_.add_receiver(&outside);
+        w.receiver_preferences_.add_receiver(&w);
+        feeder.receiver_preferences_.add_receiver(&w);
+        feeder.receiver_preferences_.add_receiver(&outside);
+    }
+    // Po zniszczeniu fabryki zostają tylko połączenia między węzłami zewnętrznymi.
+    ASSERT_EQ(outside.get_senders().size(), 1U);
+    EXPECT_EQ(outside.get_senders().front(), &feeder.receiver_preferences_);
+    ASSERT_EQ(feeder.receiver_preferences_.get_preferences().size(), 1U);
+    EXPECT_EQ(feeder.receiver_preferences_.get_preferences().begin()->first, &outside);
+    EXPECT_EQ(feeder.receiver_preferences_.choose_receiver(), &outside);
+}
+
+TEST(FactoryTest, IsConsistentDeepChain) {
+    const ElementID length = 100000;
+    Factory factory;
+    factory.add_ramp(Ramp(1, 1));
+    for (ElementID id = 1; id <= length; ++id) {
+        factory.add_worker(Worker(id, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    }
+    factory.add_storehouse(Storehouse(1));
+
+    factory.find_ramp_by_id(1)->receiver_preferences_.add_receiver(&(*factory.find_worker_by_id(1)));
+    for (ElementID id = 1; id < length; ++id) {
+        factory.find_worker_by_id(id)->receiver_preferences_.add_receiver(&(*factory.find_worker_by_id(id + 1)));
+    }
+    EXPECT_FALSE(factory.is_consistent());
+
+    factory.find_worker_by_id(length)->receiver_preferences_.add_receiver(&(*factory.find_storehouse_by_id(1)));
+    EXPECT_TRUE(factory.is_consistent());
+}
+
+TEST(FactoryTest, IncrementalConsistencyMatchesFullCheck) {
+    Factory factory;
+    std::mt19937 gen(7);
+    auto pick = [&gen](ElementID n) { return std::uniform_int_distribution<ElementID>(1, n)(gen); };
+    auto receiver = [&](ElementID id) -> IPackageReceiver* {
+        if (id % 2 == 0) {
+            auto s = factory.find_storehouse_by_id(id / 2);
+            return (s == factory.storehouse_end()) ? nullptr : &(*s);
+        }
+        auto w = factory.find_worker_by_id(id);
+        return (w == factory.worker_end()) ? nullptr : &(*w);
+    };
+    auto sender = [&](ElementID id) -> ReceiverPreferences* {
+        if (id % 2 == 0) {
+            auto r = factory.find_ramp_by_id(id / 2);
+            return (r == factory.ramp_end()) ? nullptr : &r->receiver_preferences_;
+        }
+        auto w = factory.find_worker_by_id(id);
+        return (w == factory.worker_end()) ? nullptr : &w->receiver_preferences_;
+    };
+
+    int consistent_steps = 0;
+    for (int step = 0; step < 3000; ++step) {
+        const ElementID id = pick(8);
+        switch (std::uniform_int_distribution<int>(0, 19)(gen)) {
+            case 0:
+                if (factory.find_ramp_by_id(id) == factory.ramp_end()) factory.add_ramp(Ramp(id, 1));
+                else factory.remove_ramp(id);
+                break;
+            case 1:
+                if (factory.find_worker_by_id(id) == factory.worker_end()) {
+                    factory.add_worker(Worker(id, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+                } else factory.remove_worker(id);
+                break;
+            case 2:
+                if (factory.find_storehouse_by_id(id) == factory.storehouse_end()) factory.add_storehouse(Storehouse(id));
+                else factory.remove_storehouse(id);
+                break;
+            case 3:
+            case 4:
+            case 5:
+            case 6: {
+                // Usunięcie losowej krawędzi nadawcy.
+                ReceiverPreferences* from = sender(pick(16));
+                if (!from || from->get_preferences().empty()) break;
+                auto it = from->get_preferences().begin();
+                std::advance(it, pick(static_cast<ElementID>(from->get_preferences().size())) - 1);
+                from->remove_receiver(it->first);
+                break;
+            }
+            default: {
+                ReceiverPreferences* from = sender(pick(16));
+                IPackageReceiver* to = receiver(pick(16));
+                if (from && to) from->add_receiver(to);
+            }
+        }
+        ASSERT_EQ(factory.is_consistent(), factory.check_consistency().is_consistent()) << "step " << step;
+        consistent_steps += factory.is_consistent();
+    }
+    // Oba stany muszą faktycznie wystąpić, by porównanie miało sens.
+    EXPECT_GT(consistent_steps, 100);
+    EXPECT_LT(consistent_steps, 2900);
+}
+
+TEST(FactoryTest, ParallelConsistencyCheckMatchesSerial) {
+    // Losowa sieć z wieloma odgałęzieniami (duże fronty) i jeden długi łańcuch (wiele poziomów).
+    const ElementID workers = 60000;
+    Factory factory;
+    for (ElementID id = 1; id <= 50; ++id) factory.add_ramp(Ramp(id, 1));
+    for (ElementID id = 1; id <= workers; ++id) {
+        factory.add_worker(Worker(id, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    }
+    factory.add_storehouse(Storehouse(1));
+
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<ElementID> any(1, workers);
+    auto worker = [&factory](ElementID id) { return &(*factory.find_worker_by_id(id)); };
+    for (auto it = factory.ramp_begin(); it != factory.ramp_end(); ++it) {
+        for (int k = 0; k < 3; ++k) it->receiver_preferences_.add_receiver(worker(any(gen)));
+    }
+    for (ElementID id = 1; id <= workers; ++id) {
+        if (id <= 20000) {
+            if (id < 20000) worker(id)->receiver_preferences_.add_receiver(worker(id + 1));
+            continue;
+        }
+        if (gen() % 50 == 0) worker(id)->receiver_preferences_.add_receiver(&(*factory.find_storehouse_by_id(1)));
+        if (gen() % 7 != 0) worker(id)->receiver_preferences_.add_receiver(worker(any(gen)));
+        if (gen() % 2 == 0) worker(id)->receiver_preferences_.add_receiver(worker(any(gen)));
+    }
+
+    auto compare = [&factory](ThreadPool& pool) {
+        auto serial = factory.check_consistency();
+        auto parallel = factory.check_consistency(pool);
+        ASSERT_EQ(serial.issues.size(), parallel.issues.size());
+        for (std::size_t i = 0; i < serial.issues.size(); ++i) {
+            EXPECT_EQ(serial.issues[i].element_type, parallel.issues[i].element_type);
+            EXPECT_EQ(serial.issues[i].id, parallel.issues[i].id);
+            EXPECT_EQ(serial.issues[i].problem, parallel.issues[i].problem);
+        }
+        EXPECT_EQ(parallel.is_consistent(), factory.is_consistent());
+    };
+
+    ThreadPool pool(4);
+    ThreadPool single(1);
+    compare(pool);
+    compare(single);
+    EXPECT_FALSE(factory.check_consistency(pool).issues.empty());
+
+    worker(20000)->receiver_preferences_.add_receiver(&(*factory.find_storehouse_by_id(1)));
+    compare(pool);
+}
+
+TEST(FactoryTest, BuilderMatchesIncrementalConstruction) {
+    const ElementID workers = 2000;
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<ElementID> any(1, workers);
+    std::vector<LinkSpec> links;
+    for (ElementID id = 1; id <= 10; ++id) {
+        links.push_back({{ElementType::LOADING_RAMP, id}, {ElementType::WORKER, any(gen)}});
+    }
+    for (ElementID id = 1; id <= workers; ++id) {
+        const int fanout = static_cast<int>(gen() % 4);
+        for (int k = 0; k < fanout; ++k) {
+            NodeRef to = (gen() % 5 == 0) ? NodeRef{ElementType::STOREHOUSE, static_cast<ElementID>(gen() % 3 + 1)}
+                                          : NodeRef{ElementType::WORKER, any(gen)};
+            links.push_back({{ElementType::WORKER, id}, to});
+        }
+    }
+    // Powtórzone połączenie jest pomijane, tak jak przez `add_receiver`.
+    links.push_back(links.front());
+
+    // Węzły w odwrotnej kolejności - połączenia rozwiązywane są dopiero w `build()`.
+    FactoryBuilder builder;
+    builder.reserve(10, workers, 3, links.size());
+    builder.add_links(links);
+    std::vector<Worker> bulk;
+    for (ElementID id = workers; id >= 1; --id) {
+        bulk.emplace_back(id, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO));
+    }
+    for (ElementID id = 1; id <= 10; ++id) builder.add_ramp(Ramp(id, 1));
+    for (ElementID id = 1; id <= 3; ++id) builder.add_storehouse(Storehouse(id));
+    builder.add_workers(std::move(bulk));
+    Factory built = builder.build();
+
+    Factory incremental;
+    for (ElementID id = 1; id <= 10; ++id) incremental.add_ramp(Ramp(id, 1));
+    for (ElementID id = workers; id >= 1; --id) {
+        incremental.add_worker(Worker(id, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+    }
+    for (ElementID id = 1; id <= 3; ++id) incremental.add_storehouse(Storehouse(id));
+    for (const LinkSpec& link: links) {
+        IPackageReceiver* to = (link.receiver.element_type == ElementType::WORKER)
+                               ? static_cast<IPackageReceiver*>(&*incremental.find_worker_by_id(link.receiver.id))
+                               : &*incremental.find_storehouse_by_id(link.receiver.id);
+        auto& preferences = (link.sender.element_type == ElementType::WORKER)
+                            ? incremental.find_worker_by_id(link.sender.id)->receiver_preferences_
+                            : incremental.find_ramp_by_id(link.sender.id)->receiver_preferences_;
+        preferences.add_receiver(to);
+    }
+
+    auto receivers = [](const ReceiverPreferences& preferences) {
+        std::vector<std::pair<ElementID, ReceiverType>> result;
+        for (const auto& elem: preferences.get_preferences()) {
+            result.emplace_back(elem.first->get_id(), elem.first->get_receiver_type());
+            EXPECT_NEAR(elem.second, 1. / preferences.get_preferences().size(), 1e-12);
+        }
+        return result;
+    };
+    for (ElementID id = 1; id <= workers; ++id) {
+        const Worker& w = *built.find_worker_by_id(id);
+        EXPECT_EQ(receivers(w.receiver_preferences_), receivers(incremental.find_worker_by_id(id)->receiver_preferences_));
+        EXPECT_EQ(w.get_senders().size(), incremental.find_worker_by_id(id)->get_senders().size());
+    }
+    for (ElementID id = 1; id <= 10; ++id) {
+        EXPECT_EQ(receivers(built.find_ramp_by_id(id)->receiver_preferences_),
+                  receivers(incremental.find_ramp_by_id(id)->receiver_preferences_));
+    }
+
+    EXPECT_EQ(built.is_consistent(), incremental.is_consistent());
+    EXPECT_EQ(built.check_consistency().issues.size(), incremental.check_consistency().issues.size());
+    EXPECT_EQ(built.is_consistent(), built.check_consistency().is_consistent());
+
+    // Zbudowana fabryka dalej śledzi spójność przyrostowo.
+    for (auto w = built.worker_begin(); w != built.worker_end(); ++w) {
+        w->receiver_preferences_.add_receiver(&*built.find_storehouse_by_id(1));
+    }
+    EXPECT_TRUE(built.is_consistent());
+    built.remove_storehouse(1);
+    EXPECT_EQ(built.is_consistent(), built.check_consistency().is_consistent());
+}
+
+TEST(FactoryTest, BuilderRejectsInvalidLinks) {
+    FactoryBuilder builder;
+    builder.add_ramp(Ramp(1, 1));
+    builder.add_storehouse(Storehouse(1));
+    builder.add_link({ElementType::LOADING_RAMP, 1}, {ElementType::WORKER, 7});
+    EXPECT_THROW(builder.build(), std::invalid_argument);
+
+    FactoryBuilder reversed;
+    reversed.add_ramp(Ramp(1, 1));
+    reversed.add_storehouse(Storehouse(1));
+    reversed.add_link({ElementType::STOREHOUSE, 1}, {ElementType::LOADING_RAMP, 1});
+    EXPECT_THROW(reversed.build(), std::invalid_argument);
+
+    FactoryBuilder valid;
+    valid.add_ramp(Ramp(1, 1));
+    valid.add_storehouse(Storehouse(1));
+    valid.add_link({ElementType::LOADING_RAMP, 1}, {ElementType::STOREHOUSE, 1});
+    EXPECT_THROW(valid.add_storehouse(Storehouse(1)), std::invalid_argument);
+    Factory factory = valid.build();
+    EXPECT_TRUE(factory.is_consistent());
+    EXPECT_TRUE(valid.build().is_consistent());
+}
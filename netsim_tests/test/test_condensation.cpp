@@ -0,0 +1,88 @@
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "condensation.hpp"
+#include "factory.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace {
+    Worker make_worker(ElementID id) { return Worker(id, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)); }
+
+    void link(Factory& factory, ElementID from, ElementID to) {
+        factory.find_worker_by_id(from)->receiver_preferences_.add_receiver(&(*factory.find_worker_by_id(to)));
+    }
+}
+
+TEST(CondensationTest, ComponentsCyclesAndLevels) {
+    // R1 -> W1 -> W2 <-> W3 -> W4 (pętla własna) -> S1,  W2 -> S1,  W5 (odłączony)
+    Factory factory;
+    factory.add_ramp(Ramp(1, 1));
+    for (ElementID id = 1; id <= 5; ++id) factory.add_worker(make_worker(id));
+    factory.add_storehouse(Storehouse(1));
+    Storehouse* storehouse = &(*factory.find_storehouse_by_id(1));
+
+    factory.find_ramp_by_id(1)->receiver_preferences_.add_receiver(&(*factory.find_worker_by_id(1)));
+    link(factory, 1, 2);
+    link(factory, 2, 3);
+    link(factory, 3, 2);
+    link(factory, 3, 4);
+    link(factory, 4, 4);
+    factory.find_worker_by_id(2)->receiver_preferences_.add_receiver(storehouse);
+    factory.find_worker_by_id(4)->receiver_preferences_.add_receiver(storehouse);
+
+    Condensation graph(factory);
+    EXPECT_EQ(graph.node_count(), 7U);
+    EXPECT_EQ(graph.component_count(), 6U);
+
+    const auto ramp = graph.component_of(ElementType::LOADING_RAMP, 1);
+    const auto w1 = graph.component_of(ElementType::WORKER, 1);
+    const auto loop = graph.component_of(ElementType::WORKER, 2);
+    const auto w4 = graph.component_of(ElementType::WORKER, 4);
+    const auto w5 = graph.component_of(ElementType::WORKER, 5);
+    const auto sink = graph.component_of(ElementType::STOREHOUSE, 1);
+    EXPECT_EQ(graph.component_of(ElementType::WORKER, 3), loop);
+    EXPECT_EQ(graph.members(loop).size(), 2U);
+    EXPECT_THROW(graph.component_of(ElementType::WORKER, 6), std::invalid_argument);
+
+    EXPECT_THAT(graph.cycles(), ::testing::ElementsAre(loop, w4));
+    EXPECT_FALSE(graph.is_cycle(w1));
+    EXPECT_FALSE(graph.is_cycle(w5));
+
+    EXPECT_EQ(std::vector<std::uint32_t>(graph.successors(loop).begin(), graph.successors(loop).end()),
+              (std::vector<std::uint32_t>{w4, sink}));
+    EXPECT_TRUE(graph.successors(w4).size() == 1 && *graph.successors(w4).begin() == sink);
+
+    EXPECT_EQ(graph.level(ramp), 0U);
+    EXPECT_EQ(graph.level(w1), 1U);
+    EXPECT_EQ(graph.level(loop), 2U);
+    EXPECT_EQ(graph.level(w4), 3U);
+    EXPECT_EQ(graph.level(sink), 4U);
+    EXPECT_EQ(graph.level(w5), 0U);
+    EXPECT_EQ(graph.level_count(), 5U);
+}
+
+TEST(CondensationTest, TopologicalOrderOnDeepGraph) {
+    // Długi łańcuch zamknięty w co setnym miejscu w krótkie pętle - bez rekurencji.
+    const ElementID length = 100000;
+    Factory factory;
+    factory.add_ramp(Ramp(1, 1));
+    for (ElementID id = 1; id <= length; ++id) factory.add_worker(make_worker(id));
+    factory.find_ramp_by_id(1)->receiver_preferences_.add_receiver(&(*factory.find_worker_by_id(1)));
+    for (ElementID id = 1; id < length; ++id) {
+        link(factory, id, id + 1);
+        if (id % 100 == 0) link(factory, id + 1, id);
+    }
+
+    Condensation graph(factory);
+    EXPECT_EQ(graph.component_count(), 1 + length - (length - 1) / 100);
+    EXPECT_EQ(graph.cycles().size(), static_cast<std::size_t>((length - 1) / 100));
+    EXPECT_EQ(graph.level_count(), graph.component_count());
+    for (std::uint32_t c = 0; c < graph.component_count(); ++c) {
+        for (std::uint32_t d: graph.successors(c)) {
+            EXPECT_LT(c, d);
+            EXPECT_LT(graph.level(c), graph.level(d));
+        }
+    }
+}
@@ -0,0 +1,105 @@
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "distributions.hpp"
+#include "factory.hpp"
+#include "random.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+namespace {
+    template<typename Sampler>
+    std::pair<double, double> moments(Sampler sampler, int n) {
+        double sum = 0, sum_sq = 0;
+        for (int i = 0; i < n; ++i) {
+            double x = sampler();
+            sum += x;
+            sum_sq += x * x;
+        }
+        double mean = sum / n;
+        return {mean, sum_sq / n - mean * mean};
+    }
+}
+
+TEST(ZigguratTest, StandardNormalMoments) {
+    UniformBuffer gen(RandomStream(1, 1));
+    auto m = moments([&gen]() { return sample_standard_normal(gen); }, 200000);
+    EXPECT_NEAR(m.first, 0.0, 0.01);
+    EXPECT_NEAR(m.second, 1.0, 0.02);
+}
+
+TEST(ZigguratTest, StandardExponentialMoments) {
+    UniformBuffer gen(RandomStream(1, 2));
+    auto m = moments([&gen]() { return sample_standard_exponential(gen); }, 200000);
+    EXPECT_NEAR(m.first, 1.0, 0.01);
+    EXPECT_NEAR(m.second, 1.0, 0.03);
+}
+
+TEST(AliasTableTest, MatchesWeights) {
+    AliasTable table({1, 3, 0, 6});
+    UniformBuffer gen(RandomStream(1, 3));
+
+    std::vector<int> counts(4, 0);
+    const int n = 100000;
+    for (int i = 0; i < n; ++i) ++counts[table.sample(gen.next())];
+
+    EXPECT_NEAR(counts[0] / double(n), 0.1, 0.01);
+    EXPECT_NEAR(counts[1] / double(n), 0.3, 0.01);
+    EXPECT_EQ(counts[2], 0);
+    EXPECT_NEAR(counts[3] / double(n), 0.6, 0.01);
+}
+
+TEST(TimeDistributionTest, ParseAndFormat) {
+    EXPECT_TRUE(TimeDistribution::parse("3").is_fixed());
+    EXPECT_EQ(TimeDistribution::parse("3").nominal(), 3U);
+    EXPECT_EQ(TimeDistribution::parse("3").to_string(), "3");
+
+    for (std::string spec : {"exp:5", "erlang:3:6", "lognormal:1:0.5", "empirical:1@0.25,4@0.75"}) {
+        EXPECT_EQ(TimeDistribution::parse(spec).to_string(), spec);
+    }
+    EXPECT_EQ(TimeDistribution::parse("erlang:3:6").nominal(), 6U);
+    EXPECT_EQ(TimeDistribution::parse("empirical:1@0.25,5@0.75").nominal(), 4U);
+
+    EXPECT_THROW(TimeDistribution::parse("exp"), std::invalid_argument);
+    EXPECT_THROW(TimeDistribution::parse("gamma:1:2"), std::invalid_argument);
+    EXPECT_THROW(TimeDistribution::parse("exp:-1"), std::invalid_argument);
+    EXPECT_THROW(TimeDistribution::parse("0"), std::invalid_argument);
+    EXPECT_THROW(TimeDistribution::parse("empirical:0@1"), std::invalid_argument);
+    EXPECT_THROW(TimeDistribution::parse("empirical:2@1,0@1"), std::invalid_argument);
+    EXPECT_THROW(TimeDistribution::parse("lognormal:nan:1"), std::invalid_argument);
+    EXPECT_THROW(TimeDistribution::parse("lognormal:1:inf"), std::invalid_argument);
+    EXPECT_THROW(TimeDistribution::parse("exp:inf"), std::invalid_argument);
+    EXPECT_THROW(TimeDistribution::parse("erlang:4000000000:2"), std::invalid_argument);
+    EXPECT_NO_THROW(TimeDistribution::parse("erlang:1000:2"));
+}
+
+TEST(TimeDistributionTest, SampleMeanInTurns) {
+    UniformBuffer gen(RandomStream(4, 4));
+    auto dist = TimeDistribution::erlang(4, 20);
+    auto m = moments([&]() { return static_cast<double>(dist.sample(gen)); }, 50000);
+    EXPECT_NEAR(m.first, 20.0, 0.3);
+    EXPECT_NEAR(m.second, 100.0, 5.0);
+}
+
+TEST(TimeDistributionTest, WorkerUsesSampledDurations) {
+    std::istringstream iss("WORKER id=1 processing-time=empirical:2@1,3@1 queue-type=FIFO\n"
+                           "STOREHOUSE id=1\n"
+                           "LINK src=worker-1 dest=store-1\n");
+    auto factory = load_factory_structure(iss);
+    Worker& w = *factory.find_worker_by_id(1);
+    EXPECT_EQ(w.get_processing_time().get_type(), DistributionType::EMPIRICAL);
+
+    std::vector<TimeOffset> durations;
+    for (ElementID i = 1; i <= 20; ++i) w.receive_package(Package());
+    for (Time t = 1; durations.size() < 20 && t < 200; ++t) {
+        w.send_package();
+        w.do_work(t);
+        const auto& slot = w.get_processing_slots().front();
+        if (slot.package.has_value() && slot.start_time == t) durations.push_back(slot.duration);
+    }
+    ASSERT_EQ(durations.size(), 20U);
+    EXPECT_NE(std::find(durations.begin(), durations.end(), 2U), durations.end());
+    EXPECT_NE(std::find(durations.begin(), durations.end(), 3U), durations.end());
+}
@@ -3,6 +3,8 @@
 
 #include "factory.hpp"
 
+#include <cstdio>
+#include <fstream>
 #include <set>
 
 //using ::testing::Return;
@@ -243,3 +245,159 @@ TEST(FactoryIOTest, LoadAndSaveTest) {
     ASSERT_LT(first_worker_it, first_storehouse_it);
     ASSERT_LT(first_storehouse_it, first_link_it);
 }
+
+TEST(FactoryIOTest, ParseRoutingPolicy) {
+    std::istringstream iss("LOADING_RAMP id=1 delivery-interval=3 routing=round-robin\n"
+                           "WORKER id=1 processing-time=2 queue-type=FIFO routing=jsq\n"
+                           "WORKER id=2 processing-time=2 queue-type=LIFO\n");
+    auto factory = load_factory_structure(iss);
+
+    EXPECT_EQ(factory.find_ramp_by_id(1)->receiver_preferences_.get_routing_policy(),
+              RoutingPolicyType::ROUND_ROBIN);
+    EXPECT_EQ(factory.find_worker_by_id(1)->receiver_preferences_.get_routing_policy(),
+              RoutingPolicyType::JOIN_SHORTEST_QUEUE);
+    EXPECT_EQ(factory.find_worker_by_id(2)->receiver_preferences_.get_routing_policy(),
+              RoutingPolicyType::WEIGHTED_RANDOM);
+
+    std::ostringstream oss;
+    save_factory_structure(factory, oss);
+    EXPECT_NE(oss.str().find("LOADING_RAMP id=1 delivery-interval=3 routing=round-robin\n"), std::string::npos);
+    EXPECT_NE(oss.str().find("WORKER id=1 processing-time=2 queue-type=FIFO routing=jsq\n"), std::string::npos);
+    EXPECT_NE(oss.str().find("WORKER id=2 processing-time=2 queue-type=LIFO\n"), std::string::npos);
+}
+
+TEST(FactoryIOTest, ParseUnknownRoutingPolicyThrows) {
+    std::istringstream iss("LOADING_RAMP id=1 delivery-interval=3 routing=fastest");
+    EXPECT_THROW(load_factory_structure(iss), std::invalid_argument);
+}
+
+TEST(FactoryIOTest, ParseWorkerServers) {
+    std::istringstream iss("WORKER id=1 processing-time=2 queue-type=FIFO servers=4\n"
+                           "WORKER id=2 processing-time=2 queue-type=FIFO\n");
+    auto factory = load_factory_structure(iss);
+
+    EXPECT_EQ(factory.find_worker_by_id(1)->get_servers(), 4U);
+    EXPECT_EQ(factory.find_worker_by_id(2)->get_servers(), 1U);
+
+    std::ostringstream oss;
+    save_factory_structure(factory, oss);
+    EXPECT_NE(oss.str().find("WORKER id=1 processing-time=2 queue-type=FIFO servers=4\n"), std::string::npos);
+    EXPECT_NE(oss.str().find("WORKER id=2 processing-time=2 queue-type=FIFO\n"), std::string::npos);
+}
+
+TEST(FactoryIOTest, ParseWorkerTemplates) {
+    std::istringstream iss("WORKER_TEMPLATE name=press processing-time=erlang:2:3 queue-type=LIFO servers=2\n"
+                           "WORKER id=1 template=press\n"
+                           "WORKER id=2 template=press routing=round-robin\n"
+                           "WORKER id=3 processing-time=1 queue-type=FIFO\n");
+    auto factory = load_factory_structure(iss);
+
+    const auto& w1 = *(factory.find_worker_by_id(1));
+    const auto& w2 = *(factory.find_worker_by_id(2));
+    EXPECT_EQ(w1.get_config(), w2.get_config());
+    EXPECT_EQ(w1.get_config(), factory.find_worker_template("press"));
+    EXPECT_EQ(w2.get_queue_type(), PackageQueueType::LIFO);
+    EXPECT_EQ(w2.get_servers(), 2U);
+    EXPECT_EQ(w2.receiver_preferences_.get_routing_policy(), RoutingPolicyType::ROUND_ROBIN);
+
+    std::ostringstream oss;
+    save_factory_structure(factory, oss);
+    EXPECT_NE(oss.str().find("WORKER_TEMPLATE name=press processing-time=erlang:2:3 queue-type=LIFO servers=2\n"),
+              std::string::npos);
+    EXPECT_NE(oss.str().find("WORKER id=1 template=press\n"), std::string::npos);
+    EXPECT_NE(oss.str().find("WORKER id=2 template=press routing=round-robin\n"), std::string::npos);
+    EXPECT_NE(oss.str().find("WORKER id=3 processing-time=1 queue-type=FIFO\n"), std::string::npos);
+}
+
+TEST(FactoryIOTest, ParseWorkerTemplateErrors) {
+    std::istringstream unknown("WORKER id=1 template=missing");
+    EXPECT_THROW(load_factory_structure(unknown), std::invalid_argument);
+
+    std::istringstream overridden("WORKER_TEMPLATE name=press processing-time=2 queue-type=FIFO\n"
+                                  "WORKER id=1 template=press servers=3\n");
+    EXPECT_THROW(load_factory_structure(overridden), std::invalid_argument);
+}
+
+TEST(FactoryIOTest, ParseToleratesLayoutDetails) {
+    // Wiersze CRLF, tabulatory, wcięcia, brak końcowego znaku nowego wiersza i komentarz dłuższy niż blok odczytu.
+    std::string text = "; " + std::string(3 << 20, 'x') + "\n"
+                       "LOADING_RAMP\tid=1  delivery-interval=3\r\n"
+                       "  STOREHOUSE id=7\r\n"
+                       "\r\n"
+                       "LINK src=ramp-1 dest=store-7 note=ignored";
+    std::istringstream iss(text);
+    auto factory = load_factory_structure(iss);
+
+    const auto& r = *(factory.find_ramp_by_id(1));
+    EXPECT_EQ(r.get_delivery_interval(), 3U);
+    ASSERT_EQ(r.receiver_preferences_.get_preferences().size(), 1U);
+    EXPECT_EQ(r.receiver_preferences_.get_preferences().begin()->first->get_id(), 7U);
+}
+
+TEST(FactoryIOTest, ParseMalformedLinesThrow) {
+    for (const char* line: {"WORKER id=1 queue-type=FIFO", "WORKER id=x1 processing-time=2 queue-type=FIFO",
+                            "WORKER id=1 processing-time=2q queue-type=FIFO", "STOREHOUSE id", "FACTORY id=1",
+                            "WORKER id=1 processing-time=2 queue-type=FIFO servers=two",
+                            "LINK src=ramp1 dest=store-1"}) {
+        std::istringstream iss(line);
+        EXPECT_THROW(load_factory_structure(iss), std::invalid_argument) << line;
+    }
+}
+
+TEST(FactoryIOTest, ParseStochasticDeliveryInterval) {
+    std::istringstream iss("LOADING_RAMP id=1 delivery-interval=exp:2.5");
+    auto factory = load_factory_structure(iss);
+
+    const auto& r = *(factory.ramp_cbegin());
+    EXPECT_EQ(r.get_delivery_distribution().get_type(), DistributionType::EXPONENTIAL);
+    EXPECT_EQ(r.get_delivery_interval(), 3U);
+
+    std::ostringstream oss;
+    save_factory_structure(factory, oss);
+    EXPECT_NE(oss.str().find("LOADING_RAMP id=1 delivery-interval=exp:2.5\n"), std::string::npos);
+}
+
+TEST(FactoryIOTest, TraceDrivenRamp) {
+    std::string path = ::testing::TempDir() + "netsim_trace_test.txt";
+    {
+        std::ofstream trace(path);
+        trace << "; recorded arrivals\n2\n2\n5\n\n9\n";
+    }
+
+    std::istringstream iss("LOADING_RAMP id=1 trace=" + path + "\n"
+                           "STOREHOUSE id=1\n"
+                           "LINK src=ramp-1 dest=store-1\n");
+    auto factory = load_factory_structure(iss);
+    Ramp& r = *factory.find_ramp_by_id(1);
+    ASSERT_TRUE(r.get_trace().has_value());
+    EXPECT_EQ(r.get_next_delivery_time(), 2U);
+
+    std::vector<Time> deliveries;
+    for (Time t = 1; t <= 12; ++t) {
+        r.deliver_goods(t);
+        if (r.get_sending_buffer().has_value()) deliveries.push_back(t);
+        r.send_package();
+    }
+    EXPECT_EQ(deliveries, (std::vector<Time>{2, 3, 5, 9}));
+    EXPECT_EQ(r.get_next_delivery_time(), TIME_NEVER);
+
+    std::ostringstream oss;
+    save_factory_structure(factory, oss);
+    EXPECT_NE(oss.str().find("LOADING_RAMP id=1 trace=" + path + "\n"), std::string::npos);
+
+    std::remove(path.c_str());
+}
+
+TEST(FactoryIOTest, TraceArrivalOutOfRangeThrows) {
+    std::string path = ::testing::TempDir() + "netsim_trace_overflow.txt";
+    for (const char* entry: {"4294967295", "99999999999999999999"}) {
+        {
+            std::ofstream trace(path);
+            trace << "3\n" << entry << "\n";
+        }
+        ArrivalTrace trace(path);
+        EXPECT_EQ(trace.next(), std::optional<Time>(3));
+        EXPECT_THROW(trace.next(), std::runtime_error) << entry;
+    }
+    std::remove(path.c_str());
+}
@@ -72,6 +72,26 @@ TEST(ReceiverPreferencesTest, AddReceiversRescalesProbability) {
     EXPECT_EQ(rp.get_preferences().at(&r2), 0.5);
 }
 
+TEST(ReceiverPreferencesTest, AddReceiversKeepsExistingLinks) {
+    // Hurtowe dodanie działa jak kolejne `add_receiver` - bez duplikatów i bez zmiany dotychczasowych wag.
+    ReceiverPreferences batch, single;
+    MockReceiver r1, r2, r3;
+    batch.add_receiver(&r1);
+    single.add_receiver(&r1);
+
+    batch.add_receivers({&r3, &r1, &r2, &r3});
+    single.add_receiver(&r2);
+    single.add_receiver(&r3);
+    ASSERT_EQ(batch.get_preferences().size(), 3U);
+    for (const auto& elem: single.get_preferences()) {
+        EXPECT_DOUBLE_EQ(batch.get_preferences().at(elem.first), elem.second);
+    }
+    EXPECT_EQ(r1.get_senders().size(), 2U);
+
+    batch.add_receivers({&r1});
+    EXPECT_DOUBLE_EQ(batch.get_preferences().at(&r1), 1. / 3);
+}
+
 TEST(ReceiverPreferencesTest, RemoveReceiversRescalesProbability) {
     // Upewnij się, że usunięcie odbiorcy spowoduje przeskalowanie pozostałych prawdopodobieństw.
     ReceiverPreferences rp;
@@ -159,3 +179,195 @@ TEST(PackageSenderTest, SendPackage) {
     // Upewnij się, że proces wysyłania zachodzi tylko wówczas, gdy w bufor jest pełny.
     sender.send_package();
 }
+
+// -----------------
+
+TEST(RoutingPolicyTest, RoundRobinCyclesReceivers) {
+    ReceiverPreferences rp;
+    rp.set_routing_policy(RoutingPolicyType::ROUND_ROBIN);
+
+    MockReceiver r1, r2, r3;
+    rp.add_receiver(&r1);
+    rp.add_receiver(&r2);
+    rp.add_receiver(&r3);
+
+    std::vector<IPackageReceiver*> order;
+    for (const auto& elem : rp.get_preferences()) order.push_back(elem.first);
+
+    for (int round = 0; round < 2; ++round) {
+        for (auto* expected : order) EXPECT_EQ(rp.choose_receiver(), expected);
+    }
+}
+
+TEST(RoutingPolicyTest, JoinShortestQueuePicksLeastLoaded) {
+    Worker w1(1, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO));
+    Worker w2(2, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO));
+    w1.receive_package(Package());
+    w1.receive_package(Package());
+    w2.receive_package(Package());
+    EXPECT_EQ(w1.get_load(), 2U);
+    EXPECT_EQ(w2.get_load(), 1U);
+
+    ReceiverPreferences rp;
+    rp.set_routing_policy(RoutingPolicyType::JOIN_SHORTEST_QUEUE);
+    rp.add_receiver(&w1);
+    rp.add_receiver(&w2);
+
+    EXPECT_EQ(rp.choose_receiver(), &w2);
+    w2.receive_package(Package());
+    w2.receive_package(Package());
+    EXPECT_EQ(rp.choose_receiver(), &w1);
+
+    w2.pop();
+    w2.pop();
+    w2.pop();
+    EXPECT_EQ(w2.get_load(), 0U);
+    EXPECT_EQ(rp.choose_receiver(), &w2);
+}
+
+class PowerOfTwoChoicesTest : public GlobalFunctionsFixture {
+};
+
+TEST_F(PowerOfTwoChoicesTest, PicksLessLoadedOfTwoSamples) {
+    EXPECT_CALL(global_functions_mock, generate_canonical()).WillOnce(Return(0.2)).WillOnce(Return(0.9));
+
+    Worker w1(1, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO));
+    Worker w2(2, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO));
+    w1.receive_package(Package());
+
+    ReceiverPreferences rp;
+    rp.set_routing_policy(RoutingPolicyType::POWER_OF_TWO_CHOICES);
+    rp.add_receiver(&w1);
+    rp.add_receiver(&w2);
+
+    EXPECT_EQ(rp.choose_receiver(), &w2);
+}
+
+// -----------------
+
+TEST(WorkerTest, MultipleServersProcessInParallel) {
+    Worker w(1, 2, std::make_unique<PackageQueue>(PackageQueueType::FIFO), 2);
+    auto store = std::make_unique<Storehouse>(1);
+    w.receiver_preferences_.add_receiver(store.get());
+    EXPECT_EQ(w.get_servers(), 2U);
+
+    w.receive_package(Package(1));
+    w.receive_package(Package(2));
+    w.receive_package(Package(3));
+
+    w.do_work(1);
+    EXPECT_EQ(w.size(), 1U);
+    EXPECT_TRUE(w.get_processing_slots()[0].package.has_value());
+    EXPECT_TRUE(w.get_processing_slots()[1].package.has_value());
+
+    w.send_package();
+    w.do_work(2);
+    ASSERT_TRUE(w.get_sending_buffer().has_value());
+    EXPECT_EQ(w.get_sending_buffer()->get_id(), 1U);
+
+    // Obie paczki ukończone w turze 2 trafiają do magazynu w następnej turze.
+    w.send_package();
+    EXPECT_EQ(store->size(), 2U);
+    EXPECT_FALSE(w.get_sending_buffer().has_value());
+
+    w.do_work(3);
+    EXPECT_EQ(w.get_processing_buffer()->get_id(), 3U);
+    EXPECT_EQ(w.get_package_processing_start_time(), 3U);
+}
+
+// -----------------
+
+TEST(RampTest, FixedIntervalKeepsPhase) {
+    Ramp r(1, 3);
+    EXPECT_EQ(r.get_next_delivery_time(), 1U);
+
+    r.deliver_goods(5);
+    EXPECT_FALSE(r.get_sending_buffer().has_value());
+    EXPECT_EQ(r.get_next_delivery_time(), 7U);
+
+    r.deliver_goods(7);
+    EXPECT_TRUE(r.get_sending_buffer().has_value());
+    EXPECT_EQ(r.get_next_delivery_time(), 10U);
+}
+
+TEST(RampTest, PoissonArrivals) {
+    Ramp r(1, TimeDistribution::exponential(4));
+    r.reseed(4);
+    auto store = std::make_unique<Storehouse>(1);
+    r.receiver_preferences_.add_receiver(store.get());
+
+    const Time turns = 20000;
+    Time previous = 0;
+    for (Time t = 1; t <= turns; ++t) {
+        Time next = r.get_next_delivery_time();
+        r.deliver_goods(t);
+        if (t == next) {
+            ASSERT_TRUE(r.get_sending_buffer().has_value());
+            EXPECT_GT(r.get_next_delivery_time(), t);
+            EXPECT_GT(t, previous);
+            previous = t;
+        } else {
+            ASSERT_FALSE(r.get_sending_buffer().has_value());
+        }
+        r.send_package();
+    }
+    EXPECT_NEAR(store->size() / double(turns), 1.0 / 4, 0.01);
+}
+
+TEST(WorkerTest, NextEventTime) {
+    Worker w(1, 3, std::make_unique<PackageQueue>(PackageQueueType::FIFO));
+    Storehouse s(1);
+    w.receiver_preferences_.add_receiver(&s);
+    EXPECT_EQ(w.get_next_event_time(1), TIME_NEVER);
+
+    w.receive_package(Package());
+    EXPECT_EQ(w.get_next_event_time(1), 1U);
+
+    w.do_work(1);
+    // Obróbka trwa tury 1-3; do tego czasu robotnik nie musi być odwiedzany.
+    EXPECT_EQ(w.get_next_event_time(2), 3U);
+    w.do_work(3);
+    EXPECT_EQ(w.get_next_event_time(4), 4U);
+    w.send_package();
+    EXPECT_EQ(w.get_next_event_time(4), TIME_NEVER);
+}
+
+TEST(ReceiverKindTest, DispatchFollowsMovedReceiver) {
+    Worker w(1, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO));
+    Storehouse s(1);
+    EXPECT_EQ(w.get_kind(), ReceiverKind::WORKER);
+    EXPECT_EQ(s.get_kind(), ReceiverKind::STOREHOUSE);
+    // Indeks nadaje dopiero fabryka.
+    EXPECT_EQ(w.get_index(), IPackageReceiver::NO_INDEX);
+
+    ReceiverPreferences rp;
+    rp.add_receiver(&w);
+    Worker moved(std::move(w));
+    EXPECT_EQ(rp.choose_receiver(), &moved);
+    EXPECT_TRUE(w.get_senders().empty());
+
+    deliver_package(rp.choose_receiver(), Package());
+    deliver_package(&s, Package());
+    EXPECT_EQ(moved.size(), 1U);
+    EXPECT_EQ(s.size(), 1U);
+}
+
+TEST(ReceiverPreferencesTest, RemovalKeepsIncomingLinksConsistent) {
+    Storehouse s(1);
+    std::vector<ReceiverPreferences> senders(6);
+    for (auto& sender: senders) sender.add_receiver(&s);
+
+    senders[1].remove_receiver(&s);
+    senders[4] = ReceiverPreferences(senders[0]);
+    senders[2] = std::move(senders[5]);
+    senders[0].remove_receiver(&s);
+
+    std::vector<const ReceiverPreferences*> expected{&senders[2], &senders[3], &senders[4]};
+    std::vector<const ReceiverPreferences*> actual(s.get_senders().begin(), s.get_senders().end());
+    std::sort(expected.begin(), expected.end());
+    std::sort(actual.begin(), actual.end());
+    EXPECT_EQ(actual, expected);
+
+    for (auto& sender: senders) sender.remove_receiver(&s);
+    EXPECT_TRUE(s.get_senders().empty());
+}
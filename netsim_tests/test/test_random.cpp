@@ -0,0 +1,114 @@
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include "helpers.hpp"
+#include "random.hpp"
+
+#include <vector>
+
+#include "global_functions_mock.hpp"
+
+using ::testing::Return;
+
+TEST(Xoshiro256ppTest, IsDeterministicForSeed) {
+    Xoshiro256pp a(42);
+    Xoshiro256pp b(42);
+    Xoshiro256pp c(43);
+
+    bool differs = false;
+    for (int i = 0; i < 100; ++i) {
+        auto x = a();
+        EXPECT_EQ(x, b());
+        differs = differs || (x != c());
+    }
+    EXPECT_TRUE(differs);
+}
+
+TEST(Xoshiro256ppTest, CanonicalIsInUnitInterval) {
+    Xoshiro256pp g(7);
+    double sum = 0;
+    const int n = 100000;
+    for (int i = 0; i < n; ++i) {
+        double u = g.canonical();
+        ASSERT_GE(u, 0.0);
+        ASSERT_LT(u, 1.0);
+        sum += u;
+    }
+    EXPECT_NEAR(sum / n, 0.5, 0.01);
+}
+
+TEST(ProbabilityGeneratorTest, DefaultUsesGlobalEngine) {
+    ProbabilityGenerator gen;
+    EXPECT_TRUE(gen.is_default());
+
+    ProbabilityGenerator from_default(default_probability_generator);
+    EXPECT_TRUE(from_default.is_default());
+
+    double u = gen();
+    EXPECT_GE(u, 0.0);
+    EXPECT_LT(u, 1.0);
+}
+
+class ProbabilityGeneratorMockTest : public GlobalFunctionsFixture {
+};
+
+TEST_F(ProbabilityGeneratorMockTest, MockIsInjectable) {
+    EXPECT_CALL(global_functions_mock, generate_canonical()).WillOnce(Return(0.25));
+
+    ProbabilityGenerator gen = probability_generator;
+    EXPECT_FALSE(gen.is_default());
+    EXPECT_EQ(gen(), 0.25);
+}
+
+TEST(Philox4x32Test, KnownAnswer) {
+    // Wektor kontrolny z biblioteki Random123 (licznik = 0, klucz = 0).
+    std::uint32_t ctr[4] = {0, 0, 0, 0};
+    philox4x32_10(ctr, 0, 0);
+    EXPECT_EQ(ctr[0], 0x6627e8d5U);
+    EXPECT_EQ(ctr[1], 0xe169c58dU);
+    EXPECT_EQ(ctr[2], 0xbc57ac4cU);
+    EXPECT_EQ(ctr[3], 0x9b00dbd8U);
+}
+
+TEST(RandomStreamTest, IsCounterBased) {
+    RandomStream s(123, 7);
+    std::vector<std::uint64_t> drawn;
+    for (int i = 0; i < 10; ++i) drawn.push_back(s());
+
+    RandomStream t(123, 7);
+    t.seek(5);
+    EXPECT_EQ(t(), drawn[5]);
+    EXPECT_EQ(s.at(3), drawn[3]);
+}
+
+TEST(RandomStreamTest, StreamsAreIndependent) {
+    EXPECT_NE(RandomStream(1, 1)(), RandomStream(1, 2)());
+    EXPECT_NE(RandomStream(1, 1)(), RandomStream(2, 1)());
+    EXPECT_EQ(node_stream(StreamKind::WORKER_ROUTING, 3, 99), node_stream(StreamKind::WORKER_ROUTING, 3, 99));
+    EXPECT_NE(node_stream(StreamKind::WORKER_ROUTING, 3, 99), node_stream(StreamKind::RAMP_ROUTING, 3, 99));
+}
+
+TEST(UniformBatchTest, MatchesScalarStream) {
+    RandomStream stream(5, 11);
+    const std::size_t n = 70;
+    std::vector<double> batch(n), scalar(n);
+
+    generate_uniform_batch(stream, 4, batch.data(), n);
+    generate_uniform_batch_scalar(stream, 4, scalar.data(), n);
+
+    for (std::size_t i = 0; i < n; ++i) {
+        EXPECT_EQ(batch[i], scalar[i]) << "(at " << i << ")";
+        EXPECT_EQ(batch[i], to_unit_double(stream.at(4 + i))) << "(at " << i << ")";
+    }
+}
+
+TEST(UniformBatchTest, BufferFollowsStream) {
+    RandomStream stream(5, 12);
+    stream.seek(3);
+    UniformBuffer buffer(stream);
+
+    for (int i = 0; i < 40; ++i) {
+        EXPECT_EQ(buffer.next(), stream.canonical());
+        EXPECT_EQ(buffer.stream(), stream);
+    }
+}
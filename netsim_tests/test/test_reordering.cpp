@@ -0,0 +1,129 @@
+#include "gtest/gtest.h"
+
+#include "factory.hpp"
+#include "reordering.hpp"
+#include "reports.hpp"
+#include "simulation.hpp"
+#include "topology.hpp"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+    Worker make_worker(ElementID id) { return Worker(id, 2, std::make_unique<PackageQueue>(PackageQueueType::FIFO)); }
+
+    void link(Factory& factory, ElementID from, ElementID to) {
+        factory.find_worker_by_id(from)->receiver_preferences_.add_receiver(&(*factory.find_worker_by_id(to)));
+    }
+
+    std::vector<ElementID> worker_order(const Factory& factory) {
+        std::vector<ElementID> ids;
+        for (auto w = factory.worker_cbegin(); w != factory.worker_cend(); ++w) ids.push_back(w->get_id());
+        return ids;
+    }
+
+    std::string structure_report(const Factory& factory) {
+        std::ostringstream os;
+        generate_structure_report(factory, os);
+        save_factory_structure(factory, os);
+        return os.str();
+    }
+
+    // R1 -> W7 -> {W2, W9},  W9 -> W4 -> S1,  W2 -> S1,  W5 -> S1 (nieosiągalny); wstawiani w innej kolejności.
+    void build_tree(Factory& factory) {
+        factory.add_ramp(Ramp(1, 1));
+        for (ElementID id: {4, 9, 5, 2, 7}) factory.add_worker(make_worker(id));
+        factory.add_worker(make_worker(3));
+        factory.remove_worker(3);
+        factory.add_storehouse(Storehouse(1));
+        factory.find_ramp_by_id(1)->receiver_preferences_.add_receiver(&(*factory.find_worker_by_id(7)));
+        link(factory, 7, 2);
+        link(factory, 7, 9);
+        link(factory, 9, 4);
+        Storehouse* storehouse = &(*factory.find_storehouse_by_id(1));
+        for (ElementID id: {4, 2, 5}) factory.find_worker_by_id(id)->receiver_preferences_.add_receiver(storehouse);
+    }
+}
+
+TEST(ReorderingTest, BreadthFirstPlacesReceiversTogether) {
+    Factory factory;
+    build_tree(factory);
+    const std::string before = structure_report(factory);
+
+    // Odbiorcy W7 (w kolejności preferencji, czyli utworzenia) zaraz za nim, nieosiągalny W5 na końcu.
+    reorder_for_locality(factory);
+    EXPECT_EQ(worker_order(factory), (std::vector<ElementID>{7, 9, 2, 4, 5}));
+    EXPECT_EQ(structure_report(factory), before);
+    EXPECT_TRUE(factory.is_consistent());
+
+    // Połączenia i śledzenie spójności działają po przeniesieniu węzłów.
+    factory.find_worker_by_id(5)->receiver_preferences_.remove_receiver(&(*factory.find_storehouse_by_id(1)));
+    EXPECT_TRUE(factory.is_consistent());
+    link(factory, 4, 5);
+    EXPECT_FALSE(factory.is_consistent());
+    EXPECT_EQ(factory.is_consistent(), factory.check_consistency().is_consistent());
+}
+
+TEST(ReorderingTest, ReverseCuthillMckeeIsAPermutation) {
+    TopologySpec spec;
+    spec.shape = TopologyShape::RECIRCULATING;
+    spec.workers = 3000;
+    spec.ramps = 4;
+    spec.storehouses = 3;
+    spec.layers = 12;
+    spec.fan_out = 3;
+    Factory factory = generate_topology(spec);
+    const std::string before = structure_report(factory);
+
+    const auto order = locality_order(factory, NodeOrdering::REVERSE_CUTHILL_MCKEE);
+    EXPECT_EQ(order.size(), spec.ramps + spec.workers + spec.storehouses);
+    reorder_for_locality(factory, NodeOrdering::REVERSE_CUTHILL_MCKEE);
+    EXPECT_EQ(structure_report(factory), before);
+    EXPECT_TRUE(factory.is_consistent());
+
+    // Kolejność zależy tylko od struktury.
+    const auto again = locality_order(factory, NodeOrdering::REVERSE_CUTHILL_MCKEE);
+    ASSERT_EQ(again.size(), order.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        EXPECT_EQ(again[i].element_type, order[i].element_type);
+        EXPECT_EQ(again[i].id, order[i].id);
+    }
+}
+
+TEST(ReorderingTest, ReorderedFactorySimulatesTheSameFlow) {
+    TopologySpec spec;
+    spec.shape = TopologyShape::RANDOM;
+    spec.workers = 400;
+    spec.ramps = 5;
+    spec.storehouses = 4;
+    spec.fan_out = 3;
+    spec.processing_time = TimeDistribution::exponential(2);
+    Factory reference = generate_topology(spec);
+    Factory reordered = generate_topology(spec);
+    reorder_for_locality(reordered);
+
+    simulate(reference, 200, [](Factory&, TimeOffset) {});
+    simulate(reordered, 200, [](Factory&, TimeOffset) {});
+    // Dostawy nie zależą od kolejności odwiedzania węzłów.
+    EXPECT_EQ(reordered.get_package_registry().size(), reference.get_package_registry().size());
+    EXPECT_GT(reordered.get_package_registry().size(), 0U);
+}
+
+TEST(ReorderingTest, CustomOrderKeepsRemainingNodesAndValidates) {
+    Factory factory;
+    build_tree(factory);
+    const auto before = worker_order(factory);
+
+    factory.reorder({{ElementType::WORKER, 5}, {ElementType::WORKER, 4}});
+    EXPECT_EQ(worker_order(factory), (std::vector<ElementID>{5, 4, 9, 2, 7}));
+
+    const auto current = worker_order(factory);
+    EXPECT_THROW(factory.reorder({{ElementType::WORKER, 8}}), std::invalid_argument);
+    EXPECT_THROW(factory.reorder({{ElementType::WORKER, 2}, {ElementType::WORKER, 2}}), std::invalid_argument);
+    EXPECT_THROW(factory.reorder({{ElementType::LINK, 1}}), std::invalid_argument);
+    EXPECT_EQ(worker_order(factory), current);
+    EXPECT_TRUE(factory.is_consistent());
+    EXPECT_NE(before, current);
+}
@@ -368,3 +368,38 @@ TEST(ReportsTest, TurnReportPackageInStock) {
 
     perform_turn_report_check(factory, t, expected_report_lines);
 }
+
+TEST(ReportsTest, TurnReportMultipleServers) {
+    Factory factory;
+
+    factory.add_worker(Worker(1, 3, std::make_unique<PackageQueue>(PackageQueueType::FIFO), 3));
+    factory.add_storehouse(Storehouse(1));
+
+    Worker& w = *(factory.find_worker_by_id(1));
+    w.receiver_preferences_.add_receiver(&(*factory.find_storehouse_by_id(1)));
+
+    Time t = 1;
+    w.receive_package(Package(7));
+    w.receive_package(Package(8));
+    w.do_work(t);
+
+    std::vector<std::string> expected_report_lines{
+            "=== [ Turn: " + std::to_string(t) + " ] ===",
+            "",
+            "== WORKERS ==",
+            "",
+            "WORKER #1",
+            "  PBuffer: #7 (pt = 1), #8 (pt = 1), (empty)",
+            "  Queue: (empty)",
+            "  SBuffer: (empty)",
+            "",
+            "",
+            "== STOREHOUSES ==",
+            "",
+            "STOREHOUSE #1",
+            "  Stock: (empty)",
+            "",
+    };
+
+    perform_turn_report_check(factory, t, expected_report_lines);
+}
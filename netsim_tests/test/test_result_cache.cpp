@@ -0,0 +1,144 @@
+#include "gtest/gtest.h"
+
+#include "factory.hpp"
+#include "result_cache.hpp"
+#include "simulation.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    const std::string STRUCTURE =
+            "LOADING_RAMP id=1 delivery-interval=exp:1.5\n"
+            "WORKER id=1 processing-time=erlang:2:3 queue-type=FIFO\n"
+            "WORKER id=2 processing-time=2 queue-type=LIFO routing=round-robin\n"
+            "STOREHOUSE id=1\n"
+            "LINK src=ramp-1 dest=worker-1\n"
+            "LINK src=ramp-1 dest=worker-2\n"
+            "LINK src=worker-1 dest=worker-2\n"
+            "LINK src=worker-1 dest=store-1\n"
+            "LINK src=worker-2 dest=store-1\n";
+
+    Factory load(const std::string& text) {
+        std::istringstream iss(text);
+        return load_factory_structure(iss);
+    }
+
+    Worker make_worker(ElementID id) { return Worker(id, 2, std::make_unique<PackageQueue>(PackageQueueType::FIFO)); }
+
+    // R1 -> {W1, W2} -> S1; robotnicy wstawiani w kolejności `first`, `second`.
+    Factory build(ElementID first, ElementID second) {
+        Factory factory;
+        factory.add_ramp(Ramp(1, 1));
+        factory.add_worker(make_worker(first));
+        factory.add_worker(make_worker(second));
+        factory.add_storehouse(Storehouse(1));
+        Storehouse* storehouse = &(*factory.find_storehouse_by_id(1));
+        for (ElementID id: {first, second}) {
+            factory.find_ramp_by_id(1)->receiver_preferences_.add_receiver(&(*factory.find_worker_by_id(id)));
+            factory.find_worker_by_id(id)->receiver_preferences_.add_receiver(storehouse);
+        }
+        return factory;
+    }
+
+    std::string cache_directory(const std::string& name) {
+        std::string path = ::testing::TempDir() + name;
+        std::filesystem::remove_all(path);
+        return path;
+    }
+}
+
+TEST(ResultCacheTest, StructureHashIgnoresInsertionOrder) {
+    Factory a = build(1, 2);
+    Factory b = build(2, 1);
+    EXPECT_EQ(structure_hash(a), structure_hash(b));
+    // Kolejność odwiedzania robotników i odbiorców rampy jest inna, więc inne są też wyniki symulacji.
+    EXPECT_NE(execution_order_hash(a), execution_order_hash(b));
+
+    Factory c = load(STRUCTURE);
+    Factory d = load(STRUCTURE);
+    EXPECT_EQ(scenario_key(c, 7, 100), scenario_key(d, 7, 100));
+}
+
+TEST(ResultCacheTest, StructureHashTracksParameters) {
+    const std::uint64_t base = structure_hash(load(STRUCTURE));
+
+    auto changed = [&](const std::string& from, const std::string& to) {
+        std::string text = STRUCTURE;
+        text.replace(text.find(from), from.size(), to);
+        return structure_hash(load(text));
+    };
+    EXPECT_NE(changed("exp:1.5", "exp:1.6"), base);
+    EXPECT_NE(changed("erlang:2:3", "erlang:3:3"), base);
+    EXPECT_NE(changed("queue-type=LIFO", "queue-type=FIFO"), base);
+    EXPECT_NE(changed("queue-type=LIFO", "queue-type=LIFO servers=2"), base);
+    EXPECT_NE(changed("routing=round-robin", "routing=jsq"), base);
+    EXPECT_NE(changed("LINK src=worker-1 dest=worker-2\n", ""), base);
+    EXPECT_NE(changed("LINK src=ramp-1 dest=worker-2\n", "LINK src=ramp-1 dest=store-1\n"), base);
+}
+
+TEST(ResultCacheTest, RepeatedScenarioIsServedFromCache) {
+    ResultCache cache(cache_directory("netsim_result_cache"));
+
+    Factory first = load(STRUCTURE);
+    SimulationSummary computed = cache.run(first, 11, 40);
+    EXPECT_EQ(first.get_time(), 41U);
+    EXPECT_EQ(computed, summarize(first));
+
+    Factory second = load(STRUCTURE);
+    ScenarioKey key = scenario_key(second, 11, 40);
+    ASSERT_TRUE(cache.find(key).has_value());
+    EXPECT_EQ(cache.run(second, 11, 40), computed);
+    EXPECT_EQ(second.get_time(), 1U);
+
+    EXPECT_FALSE(cache.find(scenario_key(second, 12, 40)).has_value());
+    EXPECT_FALSE(cache.find(scenario_key(second, 11, 41)).has_value());
+
+    // Uszkodzony wpis to brak wpisu - wynik jest liczony ponownie.
+    for (const auto& entry: std::filesystem::directory_iterator(cache.directory())) {
+        std::ofstream(entry.path(), std::ios::trunc) << "NETSIM-RESULT 1\ngarbage\n";
+    }
+    EXPECT_FALSE(cache.find(key).has_value());
+    EXPECT_EQ(cache.run(second, 11, 40), computed);
+    EXPECT_EQ(second.get_time(), 41U);
+
+    std::filesystem::remove_all(cache.directory());
+}
+
+TEST(ResultCacheTest, CorruptedCountsAreIgnored) {
+    ResultCache cache(cache_directory("netsim_result_cache_counts"));
+    Factory factory = load(STRUCTURE);
+    const ScenarioKey key = scenario_key(factory, 5, 20);
+    cache.run(factory, 5, 20);
+
+    // Zapis przez plik tymczasowy nie zostawia śladów w katalogu.
+    std::vector<std::filesystem::path> entries;
+    for (const auto& entry: std::filesystem::directory_iterator(cache.directory())) entries.push_back(entry.path());
+    ASSERT_EQ(entries.size(), 1U);
+    EXPECT_EQ(entries[0].extension(), ".result");
+
+    std::ifstream in(entries[0]);
+    std::string header, key_line, counts;
+    std::getline(in, header);
+    std::getline(in, key_line);
+    std::getline(in, counts);
+    in.close();
+    std::ofstream(entries[0], std::ios::trunc) << header << "\n" << key_line << "\n"
+                                               << counts.substr(0, counts.find(' ')) << " 2305843009213693952 1\n";
+    EXPECT_FALSE(cache.find(key).has_value());
+
+    std::filesystem::remove_all(cache.directory());
+}
+
+TEST(ResultCacheTest, RequiresFactoryBeforeFirstTurn) {
+    ResultCache cache(cache_directory("netsim_result_cache_started"));
+    Factory factory = load(STRUCTURE);
+    simulate(factory, 3);
+    EXPECT_THROW(cache.run(factory, 1, 10), std::logic_error);
+    std::filesystem::remove_all(cache.directory());
+}
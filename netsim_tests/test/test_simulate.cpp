@@ -5,6 +5,11 @@
 #include "simulation.hpp"
 #include "helpers.hpp"
 #include "reports.hpp"
+#include "compiled_factory.hpp"
+#include "checkpoint.hpp"
+
+#include <sstream>
+#include <thread>
 
 using ::testing::Return;
 using ::testing::_;
@@ -35,3 +40,400 @@ TEST(SimulationTest, Simulate) {
     ASSERT_NE(storehouse_it->cbegin(), storehouse_it->cend());
     EXPECT_EQ(storehouse_it->cbegin()->get_id(), 1);
 }
+
+namespace {
+    void build_two_stage_factory(Factory& factory) {
+        factory.add_ramp(Ramp(1, 1));
+        factory.add_worker(Worker(1, 2, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+        factory.add_worker(Worker(2, 3, std::make_unique<PackageQueue>(PackageQueueType::LIFO)));
+        factory.add_storehouse(Storehouse(1));
+        factory.add_storehouse(Storehouse(2));
+
+        Ramp& r = *(factory.find_ramp_by_id(1));
+        r.receiver_preferences_.add_receiver(&(*factory.find_worker_by_id(1)));
+        r.receiver_preferences_.add_receiver(&(*factory.find_worker_by_id(2)));
+        for (auto w = factory.worker_begin(); w != factory.worker_end(); ++w) {
+            w->receiver_preferences_.add_receiver(&(*factory.find_storehouse_by_id(1)));
+            w->receiver_preferences_.add_receiver(&(*factory.find_storehouse_by_id(2)));
+        }
+    }
+
+    std::vector<std::size_t> stock_sizes(Factory& factory) {
+        std::vector<std::size_t> sizes;
+        for (auto s = factory.storehouse_cbegin(); s != factory.storehouse_cend(); ++s) sizes.push_back(s->size());
+        for (auto w = factory.worker_cbegin(); w != factory.worker_cend(); ++w) sizes.push_back(w->size());
+        return sizes;
+    }
+
+    std::vector<std::size_t> simulate_stock_sizes(std::uint64_t seed) {
+        Factory factory;
+        build_two_stage_factory(factory);
+        factory.reseed(seed);
+        simulate(factory, 200, [](Factory&, TimeOffset) {});
+        return stock_sizes(factory);
+    }
+
+    // Sieć z rzadkimi dostawami, losowymi czasami obróbki i powrotem od robotnika 2 do 1.
+    void build_sparse_factory(Factory& factory) {
+        factory.add_ramp(Ramp(1, TimeDistribution::exponential(7)));
+        factory.add_ramp(Ramp(2, 13));
+        factory.add_worker(Worker(1, TimeDistribution::erlang(2, 4), std::make_unique<PackageQueue>(PackageQueueType::FIFO), 2));
+        factory.add_worker(Worker(2, TimeDistribution::exponential(3), std::make_unique<PackageQueue>(PackageQueueType::LIFO)));
+        factory.add_storehouse(Storehouse(1));
+
+        Worker& w1 = *(factory.find_worker_by_id(1));
+        Worker& w2 = *(factory.find_worker_by_id(2));
+        factory.find_ramp_by_id(1)->receiver_preferences_.add_receiver(&w2);
+        factory.find_ramp_by_id(2)->receiver_preferences_.add_receiver(&w1);
+        factory.find_ramp_by_id(2)->receiver_preferences_.add_receiver(&(*factory.find_storehouse_by_id(1)));
+        w1.receiver_preferences_.add_receiver(&w2);
+        w1.receiver_preferences_.add_receiver(&(*factory.find_storehouse_by_id(1)));
+        w2.receiver_preferences_.add_receiver(&w1);
+        w2.receiver_preferences_.add_receiver(&(*factory.find_storehouse_by_id(1)));
+    }
+}
+
+TEST(SimulationTest, SkippingIdleNodesMatchesFullScan) {
+    Factory event_driven;
+    build_sparse_factory(event_driven);
+    event_driven.reseed(77);
+    std::vector<std::vector<std::size_t>> event_driven_turns;
+    simulate(event_driven, 300, [&](Factory& f, TimeOffset) { event_driven_turns.push_back(stock_sizes(f)); });
+
+    Factory full_scan;
+    build_sparse_factory(full_scan);
+    full_scan.reseed(77);
+    std::vector<std::vector<std::size_t>> full_scan_turns;
+    for (Time time = 1; time <= 300; ++time) {
+        for (auto ramp = full_scan.ramp_begin(); ramp != full_scan.ramp_end(); ++ramp) {
+            ramp->deliver_goods(time);
+            ramp->send_package();
+        }
+        for (auto worker = full_scan.worker_begin(); worker != full_scan.worker_end(); ++worker) {
+            worker->send_package();
+            worker->do_work(time);
+        }
+        full_scan_turns.push_back(stock_sizes(full_scan));
+    }
+
+    EXPECT_EQ(event_driven_turns, full_scan_turns);
+    EXPECT_GT(event_driven_turns.back().front(), 0U);
+}
+
+TEST(SimulationTest, IsReproducibleForSeed) {
+    auto first = simulate_stock_sizes(2024);
+    EXPECT_EQ(first, simulate_stock_sizes(2024));
+
+    bool differs = false;
+    for (std::uint64_t seed = 1; seed < 10 && !differs; ++seed) differs = simulate_stock_sizes(seed) != first;
+    EXPECT_TRUE(differs);
+}
+
+TEST(SimulationTest, FactoriesOnSeparateThreadsAreIndependent) {
+    const auto expected = simulate_stock_sizes(2024);
+    std::vector<std::vector<std::size_t>> results(4);
+    std::vector<std::thread> threads;
+    for (auto& result: results) {
+        threads.emplace_back([&result]() {
+            for (int i = 0; i < 20; ++i) result = simulate_stock_sizes(2024);
+        });
+    }
+    for (auto& thread: threads) thread.join();
+    for (const auto& result: results) EXPECT_EQ(result, expected);
+}
+
+namespace {
+    // Identyfikatory półproduktów zastąpione kolejnością utworzenia (zwolnione numery są używane ponownie).
+    std::vector<std::size_t> package_order(Factory& factory) {
+        std::vector<ElementID> ids;
+        for (auto s = factory.storehouse_cbegin(); s != factory.storehouse_cend(); ++s) {
+            for (const auto& package : *s) ids.push_back(package.get_id());
+        }
+        for (auto w = factory.worker_cbegin(); w != factory.worker_cend(); ++w) {
+            for (const auto& package : *w) ids.push_back(package.get_id());
+        }
+        std::vector<ElementID> sorted = ids;
+        std::sort(sorted.begin(), sorted.end());
+        std::vector<std::size_t> order;
+        for (auto id : ids) order.push_back(std::lower_bound(sorted.begin(), sorted.end(), id) - sorted.begin());
+        return order;
+    }
+
+    std::vector<std::size_t> detailed_state(Factory& factory) {
+        std::vector<std::size_t> state = package_order(factory);
+        for (auto r = factory.ramp_cbegin(); r != factory.ramp_cend(); ++r) state.push_back(r->get_next_delivery_time());
+        for (auto w = factory.worker_cbegin(); w != factory.worker_cend(); ++w) {
+            state.push_back(w->get_load());
+            state.push_back(w->get_sending_buffer().has_value());
+            for (const auto& slot : w->get_processing_slots()) {
+                state.push_back(slot.package.has_value());
+                state.push_back(slot.start_time);
+                state.push_back(slot.duration);
+            }
+        }
+        return state;
+    }
+}
+
+TEST(SimulationTest, CompiledFactoryMatchesSimulate) {
+    Factory reference;
+    build_sparse_factory(reference);
+    reference.find_worker_by_id(1)->receiver_preferences_.set_routing_policy(RoutingPolicyType::JOIN_SHORTEST_QUEUE);
+    reference.find_ramp_by_id(2)->receiver_preferences_.set_routing_policy(RoutingPolicyType::POWER_OF_TWO_CHOICES);
+    reference.reseed(5);
+    simulate(reference, 300, [](Factory&, TimeOffset) {});
+
+    Factory compiled;
+    build_sparse_factory(compiled);
+    compiled.find_worker_by_id(1)->receiver_preferences_.set_routing_policy(RoutingPolicyType::JOIN_SHORTEST_QUEUE);
+    compiled.find_ramp_by_id(2)->receiver_preferences_.set_routing_policy(RoutingPolicyType::POWER_OF_TWO_CHOICES);
+    compiled.reseed(5);
+    {
+        CompiledFactory frozen(compiled);
+        frozen.run(120);
+        EXPECT_EQ(frozen.get_time(), 121U);
+        frozen.write_back();
+        EXPECT_THROW(frozen.run(1), std::logic_error);
+    }
+    CompiledFactory resumed(compiled, 121);
+    resumed.run(180);
+    resumed.write_back();
+
+    EXPECT_EQ(detailed_state(compiled), detailed_state(reference));
+}
+
+TEST(SimulationTest, CompiledFactoryWritesBackOnDestruction) {
+    Factory reference;
+    build_sparse_factory(reference);
+    reference.reseed(3);
+    simulate(reference, 80, [](Factory&, TimeOffset) {});
+
+    Factory compiled;
+    build_sparse_factory(compiled);
+    compiled.reseed(3);
+    {
+        CompiledFactory frozen(compiled);
+        frozen.run(80);
+    }
+
+    EXPECT_EQ(compiled.get_time(), reference.get_time());
+    EXPECT_EQ(detailed_state(compiled), detailed_state(reference));
+}
+
+
+namespace {
+    // Numery wszystkich półproduktów fabryki: magazyny, kolejki, stanowiska i bufory.
+    std::vector<ElementID> package_ids(Factory& factory) {
+        std::vector<ElementID> ids;
+        for (auto s = factory.storehouse_cbegin(); s != factory.storehouse_cend(); ++s) {
+            for (const auto& package : *s) ids.push_back(package.get_id());
+        }
+        for (auto w = factory.worker_cbegin(); w != factory.worker_cend(); ++w) {
+            for (const auto& package : *w) ids.push_back(package.get_id());
+            for (const auto& slot : w->get_processing_slots()) {
+                if (slot.package) ids.push_back(slot.package->get_id());
+            }
+            if (w->get_sending_buffer()) ids.push_back(w->get_sending_buffer()->get_id());
+        }
+        for (auto r = factory.ramp_cbegin(); r != factory.ramp_cend(); ++r) {
+            if (r->get_sending_buffer()) ids.push_back(r->get_sending_buffer()->get_id());
+        }
+        return ids;
+    }
+}
+
+TEST(SimulationTest, ClonedFactoryContinuesIndependently) {
+    Factory reference;
+    build_sparse_factory(reference);
+    reference.reseed(9);
+    simulate(reference, 250, [](Factory&, TimeOffset) {});
+
+    Factory warm;
+    build_sparse_factory(warm);
+    warm.reseed(9);
+    simulate(warm, 100, [](Factory&, TimeOffset) {});
+
+    Factory branch = warm.clone();
+    Factory slow = warm.clone();
+    EXPECT_EQ(branch.get_time(), 101U);
+    EXPECT_TRUE(branch.is_consistent());
+    EXPECT_EQ(package_ids(branch), package_ids(warm));
+    EXPECT_EQ(detailed_state(branch), detailed_state(warm));
+    EXPECT_NE(&*branch.find_worker_by_id(1), &*warm.find_worker_by_id(1));
+
+    slow.find_worker_by_id(2)->set_config(
+            std::make_shared<const WorkerConfig>("", TimeDistribution::fixed(20), PackageQueueType::LIFO));
+    EXPECT_THROW(slow.find_worker_by_id(1)->set_config(
+            std::make_shared<const WorkerConfig>("", TimeDistribution::fixed(1), PackageQueueType::FIFO, 3)),
+                 std::invalid_argument);
+
+    // Gałęzie kontynuują niezależnie: szczegółowa symulacja, zamrożona fabryka i zmieniony robotnik.
+    simulate(warm, 150, [](Factory&, TimeOffset) {});
+    simulate(branch, 150);
+    simulate(slow, 150, [](Factory&, TimeOffset) {});
+
+    EXPECT_EQ(package_ids(warm), package_ids(reference));
+    EXPECT_EQ(detailed_state(warm), detailed_state(reference));
+    EXPECT_EQ(package_ids(branch), package_ids(reference));
+    EXPECT_EQ(detailed_state(branch), detailed_state(reference));
+    EXPECT_EQ(branch.get_time(), 251U);
+    EXPECT_NE(detailed_state(slow), detailed_state(reference));
+
+    // Każda fabryka ma własny rejestr numerów półproduktów.
+    for (Factory* factory : {&reference, &warm, &branch, &slow}) {
+        EXPECT_EQ(factory->get_package_registry().size(), package_ids(*factory).size());
+    }
+}
+
+namespace {
+    class Shelf : public IPackageStockpile {
+    public:
+        void push(Package&& package) override { packages_.push_back(std::move(package)); }
+
+        bool empty() const override { return packages_.empty(); }
+
+        size_t size() const override { return packages_.size(); }
+
+        const_iterator begin() const override { return packages_.begin(); }
+
+        const_iterator cbegin() const override { return packages_.cbegin(); }
+
+        const_iterator end() const override { return packages_.end(); }
+
+        const_iterator cend() const override { return packages_.cend(); }
+
+    private:
+        std::list<Package> packages_;
+    };
+}
+
+TEST(SimulationTest, ClonedStorehouseRejectsCustomStockpile) {
+    Factory factory;
+    factory.add_storehouse(Storehouse(1, std::make_unique<PackageQueue>(PackageQueueType::LIFO)));
+    Storehouse& original = *factory.find_storehouse_by_id(1);
+    for (int i = 0; i < 3; ++i) original.receive_package(Package(factory.get_package_registry()));
+
+    Factory copy = factory.clone();
+    const Storehouse& cloned = *copy.find_storehouse_by_id(1);
+    std::vector<ElementID> expected, actual;
+    for (const auto& package: original) expected.push_back(package.get_id());
+    for (const auto& package: cloned) actual.push_back(package.get_id());
+    EXPECT_EQ(actual, expected);
+
+    factory.add_storehouse(Storehouse(2, std::make_unique<Shelf>()));
+    EXPECT_THROW(factory.clone(), std::logic_error);
+}
+
+namespace {
+    // Fabryka, w której kolejność utworzenia odbiorców i układ węzłów różnią się od kolejności numerów.
+    void build_rearranged_factory(Factory& factory) {
+        build_sparse_factory(factory);
+        factory.add_worker(Worker(4, 2, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+        factory.add_storehouse(Storehouse(0));
+        factory.add_worker(Worker(3, TimeDistribution::exponential(2), std::make_unique<PackageQueue>(PackageQueueType::LIFO)));
+        factory.remove_worker(4);
+
+        Worker& w3 = *(factory.find_worker_by_id(3));
+        w3.receiver_preferences_.add_receiver(&(*factory.find_storehouse_by_id(0)));
+        w3.receiver_preferences_.add_receiver(&(*factory.find_storehouse_by_id(1)));
+        factory.find_worker_by_id(1)->receiver_preferences_.add_receiver(&w3);
+        factory.find_ramp_by_id(2)->receiver_preferences_.add_receiver(&(*factory.find_storehouse_by_id(0)));
+    }
+}
+
+TEST(SimulationTest, RestoredCheckpointContinuesIdentically) {
+    Factory reference;
+    build_rearranged_factory(reference);
+    reference.reseed(31);
+    simulate(reference, 250, [](Factory&, TimeOffset) {});
+
+    Factory warm;
+    build_rearranged_factory(warm);
+    warm.reseed(31);
+    simulate(warm, 100, [](Factory&, TimeOffset) {});
+
+    std::stringstream checkpoint;
+    save_checkpoint(warm, checkpoint);
+    const std::string data = checkpoint.str();
+    Factory restored = load_checkpoint(checkpoint);
+    EXPECT_EQ(restored.get_time(), 101U);
+    EXPECT_TRUE(restored.is_consistent());
+    EXPECT_EQ(package_ids(restored), package_ids(warm));
+    EXPECT_EQ(detailed_state(restored), detailed_state(warm));
+
+    simulate(restored, 150, [](Factory&, TimeOffset) {});
+    EXPECT_EQ(package_ids(restored), package_ids(reference));
+    EXPECT_EQ(detailed_state(restored), detailed_state(reference));
+    EXPECT_EQ(restored.get_package_registry().size(), package_ids(restored).size());
+
+    // Kolejne numery półproduktów nie kolidują z numerami odtworzonymi.
+    EXPECT_EQ(restored.get_package_registry().size(), reference.get_package_registry().size());
+
+    std::istringstream truncated(data.substr(0, data.size() - 1));
+    EXPECT_THROW(load_checkpoint(truncated), std::invalid_argument);
+    std::istringstream foreign("not a checkpoint at all");
+    EXPECT_THROW(load_checkpoint(foreign), std::invalid_argument);
+    std::istringstream trailing(data + "x");
+    EXPECT_THROW(load_checkpoint(trailing), std::invalid_argument);
+}
+
+namespace {
+    std::string varint(std::uint64_t value) {
+        std::string bytes;
+        for (; value >= 0x80; value >>= 7) bytes.push_back(static_cast<char>(value | 0x80));
+        bytes.push_back(static_cast<char>(value));
+        return bytes;
+    }
+
+    // Punkt kontrolny sieci rampa 1 -> robotnik 1 -> magazyn 1 z półproduktem 1 na stanowisku
+    // robotnika (obrabianym przez `duration` tur) i `stock` w magazynie.
+    std::string handmade_checkpoint(TimeOffset duration, const std::vector<ElementID>& stock) {
+        Factory factory;
+        factory.add_ramp(Ramp(1, 1));
+        factory.add_worker(Worker(1, 1, std::make_unique<PackageQueue>(PackageQueueType::FIFO)));
+        factory.add_storehouse(Storehouse(1));
+        factory.find_ramp_by_id(1)->receiver_preferences_.add_receiver(&*factory.find_worker_by_id(1));
+        factory.find_worker_by_id(1)->receiver_preferences_.add_receiver(&*factory.find_storehouse_by_id(1));
+        std::ostringstream structure;
+        save_factory_structure(factory, structure);
+
+        const std::string single_layout = varint(1) + varint(2) + varint(0);
+        const std::string default_routing = varint(0) + varint(0);
+        const std::string stream = varint(0) + varint(0) + varint(0);
+        std::string data = std::string("NETSIMCK", 8) + varint(1) + varint(structure.str().size()) + structure.str();
+        data += single_layout + single_layout + single_layout;
+        data += varint(2) + varint(0) + varint(1) + varint(1) + varint(1);
+        data += varint(1) + varint(1) + varint(1) + varint(0);
+        data += varint(1) + varint(1) + stream + varint(0) + default_routing + varint(0);
+        data += varint(1) + stream + default_routing + varint(0);
+        data += varint(2) + varint(1) + varint(duration) + varint(0) + varint(0);
+        data += varint(1) + varint(stock.size());
+        for (ElementID id: stock) data += varint(id);
+        return data;
+    }
+}
+
+TEST(SimulationTest, CorruptedCheckpointIsRejected) {
+    std::istringstream valid(handmade_checkpoint(2, {}));
+    Factory restored = load_checkpoint(valid);
+    ASSERT_TRUE(restored.find_worker_by_id(1)->get_processing_slots()[0].package.has_value());
+
+    std::istringstream duplicated(handmade_checkpoint(2, {1}));
+    EXPECT_THROW(load_checkpoint(duplicated), std::invalid_argument);
+    std::istringstream instant(handmade_checkpoint(0, {}));
+    EXPECT_THROW(load_checkpoint(instant), std::invalid_argument);
+
+    // Uszkodzone liczniki nie mogą wymusić alokacji ponad rozmiar danych.
+    const std::string header = std::string("NETSIMCK", 8) + varint(1) + varint(0);
+    const std::string empty_layout = varint(0) + varint(0);
+    std::istringstream slots(header + varint(std::numeric_limits<std::uint32_t>::max()));
+    EXPECT_THROW(load_checkpoint(slots), std::invalid_argument);
+    std::istringstream assigned(header + empty_layout + empty_layout + empty_layout + varint(0) + varint(1) +
+                                varint(std::uint64_t{1} << 61));
+    EXPECT_THROW(load_checkpoint(assigned), std::invalid_argument);
+
+    // Wersja 1 zakodowana na dziesięciu bajtach z bitami wykraczającymi poza 64 bity.
+    std::istringstream overlong(std::string("NETSIMCK", 8) + "\x81" + std::string(8, '\x80') + "\x02" +
+                                handmade_checkpoint(2, {}).substr(9));
+    EXPECT_THROW(load_checkpoint(overlong), std::invalid_argument);
+}
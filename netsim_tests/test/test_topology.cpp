@@ -0,0 +1,105 @@
+#include "gtest/gtest.h"
+
+#include "condensation.hpp"
+#include "factory.hpp"
+#include "topology.hpp"
+
+#include <sstream>
+#include <string>
+
+namespace {
+    std::string structure_of(const Factory& factory) {
+        std::ostringstream os;
+        save_factory_structure(factory, os);
+        return os.str();
+    }
+
+    std::string generated_text(const TopologySpec& spec) {
+        std::ostringstream os;
+        write_topology(spec, os);
+        return os.str();
+    }
+
+    TopologySpec make_spec(TopologyShape shape) {
+        TopologySpec spec;
+        spec.shape = shape;
+        spec.ramps = 3;
+        spec.workers = 500;
+        spec.storehouses = 4;
+        spec.layers = 7;
+        spec.fan_out = 3;
+        spec.back_edge_probability = 0.2;
+        spec.seed = 17;
+        spec.processing_time = TimeDistribution::exponential(3);
+        return spec;
+    }
+}
+
+TEST(TopologyTest, GeneratedNetworksAreConsistentAndFullyConnected) {
+    for (TopologyShape shape: {TopologyShape::LAYERED, TopologyShape::RANDOM, TopologyShape::RECIRCULATING,
+                               TopologyShape::FAN_IN}) {
+        const TopologySpec spec = make_spec(shape);
+        std::istringstream text(generated_text(spec));
+        Factory loaded = load_factory_structure(text);
+
+        std::size_t workers = 0;
+        for (auto w = loaded.worker_cbegin(); w != loaded.worker_cend(); ++w) {
+            ++workers;
+            EXPECT_FALSE(w->get_senders().empty()) << to_string(shape) << " worker " << w->get_id();
+            EXPECT_FALSE(w->receiver_preferences_.get_preferences().empty());
+        }
+        for (auto s = loaded.storehouse_cbegin(); s != loaded.storehouse_cend(); ++s) {
+            EXPECT_FALSE(s->get_senders().empty()) << to_string(shape) << " store " << s->get_id();
+        }
+        EXPECT_EQ(workers, spec.workers);
+        EXPECT_TRUE(loaded.is_consistent()) << to_string(shape);
+        EXPECT_TRUE(loaded.check_consistency().is_consistent()) << to_string(shape);
+
+        // Zapis strumieniowy i budowanie w pamięci dają tę samą sieć.
+        EXPECT_EQ(structure_of(generate_topology(spec)), structure_of(loaded)) << to_string(shape);
+
+        Condensation condensation(loaded);
+        const bool acyclic = shape == TopologyShape::LAYERED || shape == TopologyShape::FAN_IN;
+        EXPECT_EQ(condensation.cycles().empty(), acyclic) << to_string(shape);
+        if (shape == TopologyShape::LAYERED) {
+            EXPECT_EQ(condensation.level_count(), spec.layers + 2);
+        }
+    }
+}
+
+TEST(TopologyTest, FanInConcentratesOnStorehouses) {
+    TopologySpec spec = make_spec(TopologyShape::FAN_IN);
+    spec.workers = 20000;
+    spec.storehouses = 2;
+    spec.fan_out = 1;
+    Factory factory = generate_topology(spec);
+    std::size_t senders = 0;
+    for (auto s = factory.storehouse_cbegin(); s != factory.storehouse_cend(); ++s) senders += s->get_senders().size();
+    // Każdy robotnik dostarcza do jednego magazynu (plus ewentualne połączenia zapewniające dostawcę magazynom).
+    EXPECT_GE(senders, spec.workers);
+    EXPECT_LE(senders, spec.workers + spec.storehouses);
+    EXPECT_TRUE(factory.is_consistent());
+}
+
+TEST(TopologyTest, OutputDependsOnlyOnSpec) {
+    TopologySpec spec = make_spec(TopologyShape::RANDOM);
+    const std::string text = generated_text(spec);
+    EXPECT_EQ(generated_text(spec), text);
+    spec.seed = 18;
+    EXPECT_NE(generated_text(spec), text);
+}
+
+TEST(TopologyTest, RejectsInvalidSpecs) {
+    TopologySpec spec;
+    spec.storehouses = 0;
+    EXPECT_THROW(generated_text(spec), std::invalid_argument);
+    spec = TopologySpec();
+    spec.layers = spec.workers + 1;
+    EXPECT_THROW(generate_topology(spec), std::invalid_argument);
+    spec = TopologySpec();
+    spec.back_edge_probability = 1.5;
+    EXPECT_THROW(generated_text(spec), std::invalid_argument);
+
+    EXPECT_EQ(topology_shape_from_string("fan-in"), TopologyShape::FAN_IN);
+    EXPECT_FALSE(topology_shape_from_string("mesh").has_value());
+}
@@ -0,0 +1,403 @@
+#include "checkpoint.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+    constexpr char MAGIC[8] = {'N', 'E', 'T', 'S', 'I', 'M', 'C', 'K'};
+    constexpr std::uint64_t VERSION = 1;
+
+    class Writer {
+    public:
+        void varint(std::uint64_t value) {
+            while (value >= 0x80) {
+                data_.push_back(static_cast<char>(value | 0x80));
+                value >>= 7;
+            }
+            data_.push_back(static_cast<char>(value));
+        }
+
+        void bytes(const char* data, std::size_t size) { data_.append(data, size); }
+
+        void string(const std::string& value) {
+            varint(value.size());
+            bytes(value.data(), value.size());
+        }
+
+        // Rosnący ciąg numerów zapisany różnicowo.
+        template<typename Ids>
+        void sorted_ids(const Ids& ids) {
+            varint(ids.size());
+            ElementID previous = 0;
+            for (ElementID id: ids) {
+                varint(id - previous);
+                previous = id;
+            }
+        }
+
+        const std::string& data() const { return data_; }
+
+    private:
+        std::string data_;
+    };
+
+    class Reader {
+    public:
+        explicit Reader(std::string data) : data_(std::move(data)) {}
+
+        std::uint64_t varint() {
+            std::uint64_t value = 0;
+            for (unsigned shift = 0; shift < 64; shift += 7) {
+                const auto byte = static_cast<unsigned char>(take(1)[0]);
+                // Dziesiąty bajt niesie już tylko najstarszy bit wartości.
+                if (shift == 63 && byte > 1) throw std::invalid_argument("Corrupted checkpoint: number too long!");
+                value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) return value;
+            }
+            throw std::invalid_argument("Corrupted checkpoint: invalid number!");
+        }
+
+        template<typename T>
+        T number() {
+            const std::uint64_t value = varint();
+            if (value > std::numeric_limits<T>::max()) throw std::invalid_argument("Corrupted checkpoint: number out of range!");
+            return static_cast<T>(value);
+        }
+
+        bool flag() { return number<std::uint8_t>() != 0; }
+
+        // Liczba elementów, z których każdy zajmuje co najmniej jeden bajt - ograniczona przez
+        // resztę danych, by uszkodzony licznik nie wymusił ogromnej alokacji.
+        template<typename T = std::size_t>
+        T count() {
+            const auto value = number<T>();
+            if (value > data_.size() - position_) throw std::invalid_argument("Corrupted checkpoint: count out of range!");
+            return value;
+        }
+
+        const char* take(std::size_t size) {
+            if (data_.size() - position_ < size) throw std::invalid_argument("Corrupted checkpoint: unexpected end!");
+            const char* data = data_.data() + position_;
+            position_ += size;
+            return data;
+        }
+
+        std::string string() {
+            const auto size = number<std::size_t>();
+            return std::string(take(size), size);
+        }
+
+        std::vector<ElementID> sorted_ids() {
+            std::vector<ElementID> ids(count());
+            ElementID previous = 0;
+            for (auto& id: ids) {
+                id = previous + number<ElementID>();
+                if (&id != ids.data() && id <= previous) throw std::invalid_argument("Corrupted checkpoint: unsorted IDs!");
+                previous = id;
+            }
+            return ids;
+        }
+
+        bool at_end() const { return position_ == data_.size(); }
+
+    private:
+        std::string data_;
+        std::size_t position_ = 0;
+    };
+
+    // Odtwarzane półprodukty: numer musi być przydzielony i może wystąpić tylko raz.
+    class PackageClaims {
+    public:
+        explicit PackageClaims(PackageRegistry& registry) : registry_(registry) {}
+
+        Package claim(ElementID id) {
+            if (!registry_.is_assigned(id)) throw std::invalid_argument("Corrupted checkpoint: unregistered package!");
+            if (!claimed_.insert(id).second) throw std::invalid_argument("Corrupted checkpoint: duplicated package!");
+            return Package(id, registry_);
+        }
+
+    private:
+        PackageRegistry& registry_;
+        std::unordered_set<ElementID> claimed_;
+    };
+}
+
+class CheckpointIO {
+public:
+    static void save(const Factory& factory, std::ostream& os);
+
+    static Factory load(std::istream& is);
+
+private:
+    enum class ReceiverTag : std::uint8_t {
+        WORKER, STOREHOUSE
+    };
+
+    template<typename Node>
+    static void save_layout(Writer& out, const NodeCollection<Node>& nodes);
+
+    template<typename Node>
+    static void load_layout(Reader& in, NodeCollection<Node>& nodes);
+
+    static void save_stream(Writer& out, const RandomStream& stream);
+
+    static RandomStream load_stream(Reader& in);
+
+    static void save_routing(Writer& out, const ReceiverPreferences& preferences);
+
+    static void load_routing(Reader& in, ReceiverPreferences& preferences);
+
+    static void save_package(Writer& out, const std::optional<Package>& package);
+
+    static std::optional<Package> load_package(Reader& in, PackageClaims& packages);
+
+    static void save_packages(Writer& out, const IPackageStockpile& packages);
+
+    template<typename Stockpile>
+    static void load_packages(Reader& in, Stockpile& stockpile, PackageClaims& packages);
+
+    template<typename Node>
+    static Node& expect_node(Reader& in, typename NodeCollection<Node>::iterator& it,
+                             const NodeCollection<Node>& nodes);
+};
+
+template<typename Node>
+void CheckpointIO::save_layout(Writer& out, const NodeCollection<Node>& nodes) {
+    const auto layout = nodes.layout();
+    out.varint(layout.slots.size());
+    for (const auto& id: layout.slots) out.varint(id ? static_cast<std::uint64_t>(*id) + 1 : 0);
+    out.varint(layout.free_slots.size());
+    for (std::uint32_t slot: layout.free_slots) out.varint(slot);
+}
+
+template<typename Node>
+void CheckpointIO::load_layout(Reader& in, NodeCollection<Node>& nodes) {
+    typename NodeCollection<Node>::Layout layout;
+    layout.slots.resize(in.count<std::uint32_t>());
+    for (auto& id: layout.slots) {
+        const auto value = in.number<std::uint64_t>();
+        if (value > static_cast<std::uint64_t>(std::numeric_limits<ElementID>::max()) + 1) {
+            throw std::invalid_argument("Corrupted checkpoint: node ID out of range!");
+        }
+        if (value) id = static_cast<ElementID>(value - 1);
+    }
+    layout.free_slots.resize(in.count<std::uint32_t>());
+    for (auto& slot: layout.free_slots) slot = in.number<std::uint32_t>();
+    nodes.arrange(layout);
+}
+
+void CheckpointIO::save_stream(Writer& out, const RandomStream& stream) {
+    out.varint(stream.key0());
+    out.varint(stream.key1());
+    out.varint(stream.position());
+}
+
+RandomStream CheckpointIO::load_stream(Reader& in) {
+    const auto key0 = in.number<std::uint32_t>();
+    const auto key1 = in.number<std::uint32_t>();
+    return RandomStream::from_key(key0, key1, in.number<std::uint64_t>());
+}
+
+void CheckpointIO::save_routing(Writer& out, const ReceiverPreferences& preferences) {
+    const ProbabilityGenerator& generator = preferences.probability_gen_;
+    if (!generator.is_default()) throw std::logic_error("Cannot checkpoint a custom probability generator!");
+    out.varint(generator.get_stream() != nullptr);
+    if (generator.get_stream()) save_stream(out, *generator.get_stream());
+    out.varint(preferences.table_.cursor);
+}
+
+void CheckpointIO::load_routing(Reader& in, ReceiverPreferences& preferences) {
+    if (in.flag()) preferences.attach_stream(load_stream(in));
+    preferences.table_.cursor = in.number<std::size_t>();
+}
+
+void CheckpointIO::save_package(Writer& out, const std::optional<Package>& package) {
+    out.varint(package ? static_cast<std::uint64_t>(package->get_id()) + 1 : 0);
+}
+
+std::optional<Package> CheckpointIO::load_package(Reader& in, PackageClaims& packages) {
+    const auto value = in.number<std::uint64_t>();
+    if (!value) return std::nullopt;
+    if (value > static_cast<std::uint64_t>(std::numeric_limits<ElementID>::max()) + 1) {
+        throw std::invalid_argument("Corrupted checkpoint: package ID out of range!");
+    }
+    return packages.claim(static_cast<ElementID>(value - 1));
+}
+
+void CheckpointIO::save_packages(Writer& out, const IPackageStockpile& packages) {
+    out.varint(packages.size());
+    for (const auto& package: packages) out.varint(package.get_id());
+}
+
+template<typename Stockpile>
+void CheckpointIO::load_packages(Reader& in, Stockpile& stockpile, PackageClaims& packages) {
+    const auto count = in.count();
+    for (std::size_t i = 0; i < count; ++i) stockpile.push(packages.claim(in.number<ElementID>()));
+}
+
+template<typename Node>
+Node& CheckpointIO::expect_node(Reader& in, typename NodeCollection<Node>::iterator& it,
+                                const NodeCollection<Node>& nodes) {
+    if (it == nodes.end() || it->get_id() != in.number<ElementID>()) {
+        throw std::invalid_argument("Corrupted checkpoint: node state does not match the structure!");
+    }
+    return *it++;
+}
+
+void CheckpointIO::save(const Factory& factory, std::ostream& os) {
+    Writer out;
+    out.bytes(MAGIC, sizeof(MAGIC));
+    out.varint(VERSION);
+
+    std::ostringstream structure;
+    save_factory_structure(factory, structure);
+    out.string(structure.str());
+
+    save_layout(out, factory.ramps_);
+    save_layout(out, factory.workers_);
+    save_layout(out, factory.storehouses_);
+
+    // Kolejność utworzenia odbiorców wyznacza kolejność w preferencjach nadawców.
+    std::vector<const IPackageReceiver*> receivers;
+    for (const auto& worker: factory.workers_) receivers.push_back(&worker);
+    for (const auto& storehouse: factory.storehouses_) receivers.push_back(&storehouse);
+    std::sort(receivers.begin(), receivers.end(), ReceiverOrder());
+    out.varint(receivers.size());
+    for (const IPackageReceiver* receiver: receivers) {
+        const bool worker = receiver->get_kind() == ReceiverKind::WORKER;
+        out.varint(static_cast<std::uint8_t>(worker ? ReceiverTag::WORKER : ReceiverTag::STOREHOUSE));
+        out.varint(receiver->get_id());
+    }
+
+    out.varint(factory.time_);
+    out.sorted_ids(factory.packages_->assigned_ids());
+    out.sorted_ids(factory.packages_->freed_ids());
+
+    for (const auto& ramp: factory.ramps_) {
+        out.varint(ramp.get_id());
+        out.varint(ramp.next_delivery_);
+        save_stream(out, ramp.delivery_rng_.stream());
+        out.varint(ramp.trace_.has_value());
+        if (ramp.trace_) out.varint(ramp.trace_->offset());
+        save_routing(out, ramp.receiver_preferences_);
+        save_package(out, ramp.sending_buffer);
+    }
+    for (const auto& worker: factory.workers_) {
+        out.varint(worker.get_id());
+        save_stream(out, worker.processing_rng_.stream());
+        save_routing(out, worker.receiver_preferences_);
+        save_packages(out, *worker.queue_);
+        for (const auto& slot: worker.slots_) {
+            save_package(out, slot.package);
+            out.varint(slot.start_time);
+            out.varint(slot.duration);
+            out.varint(slot.finished);
+        }
+        save_package(out, worker.sending_buffer);
+    }
+    for (const auto& storehouse: factory.storehouses_) {
+        out.varint(storehouse.get_id());
+        save_packages(out, *storehouse.d_);
+    }
+
+    os.write(out.data().data(), static_cast<std::streamsize>(out.data().size()));
+    if (!os) throw std::runtime_error("Cannot write the checkpoint!");
+}
+
+Factory CheckpointIO::load(std::istream& is) {
+    Reader in{std::string(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>())};
+    if (std::memcmp(in.take(sizeof(MAGIC)), MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::invalid_argument("Not a checkpoint file!");
+    }
+    if (in.varint() != VERSION) throw std::invalid_argument("Unsupported checkpoint version!");
+
+    std::istringstream structure(in.string());
+    Factory factory = load_factory_structure(structure);
+
+    // Węzły są przenoszone, więc śledzenie spójności wyłączane jest do końca odtwarzania.
+    factory.consistency_.reset();
+    load_layout(in, factory.ramps_);
+    load_layout(in, factory.workers_);
+    load_layout(in, factory.storehouses_);
+
+    const auto receivers = in.count();
+    if (receivers != factory.workers_.size() + factory.storehouses_.size()) {
+        throw std::invalid_argument("Corrupted checkpoint: receivers do not match the structure!");
+    }
+    std::vector<IPackageReceiver*> order;
+    for (std::size_t i = 0; i < receivers; ++i) {
+        const auto tag = in.number<std::uint8_t>();
+        const auto id = in.number<ElementID>();
+        IPackageReceiver* receiver = nullptr;
+        if (tag == static_cast<std::uint8_t>(ReceiverTag::WORKER)) {
+            auto it = factory.workers_.find_by_id(id);
+            if (it != factory.workers_.end()) receiver = &*it;
+        } else if (tag == static_cast<std::uint8_t>(ReceiverTag::STOREHOUSE)) {
+            auto it = factory.storehouses_.find_by_id(id);
+            if (it != factory.storehouses_.end()) receiver = &*it;
+        }
+        if (!receiver) throw std::invalid_argument("Corrupted checkpoint: unknown receiver!");
+        order.push_back(receiver);
+    }
+    for (IPackageReceiver* receiver: order) receiver->sequence_ = IPackageReceiver::next_sequence();
+    for (auto& ramp: factory.ramps_) ramp.receiver_preferences_.resort_receivers();
+    for (auto& worker: factory.workers_) worker.receiver_preferences_.resort_receivers();
+
+    factory.time_ = in.number<Time>();
+    const auto assigned = in.sorted_ids();
+    const auto freed = in.sorted_ids();
+    factory.packages_->restore(assigned, freed);
+    PackageClaims packages(*factory.packages_);
+
+    auto ramp_it = factory.ramps_.begin();
+    for (std::size_t i = 0; i < factory.ramps_.size(); ++i) {
+        Ramp& ramp = expect_node(in, ramp_it, factory.ramps_);
+        ramp.next_delivery_ = in.number<Time>();
+        ramp.delivery_rng_ = UniformBuffer(load_stream(in));
+        if (in.flag() != ramp.trace_.has_value()) {
+            throw std::invalid_argument("Corrupted checkpoint: ramp trace does not match the structure!");
+        }
+        if (ramp.trace_) ramp.trace_->seek(in.number<std::size_t>());
+        load_routing(in, ramp.receiver_preferences_);
+        ramp.sending_buffer = load_package(in, packages);
+    }
+    auto worker_it = factory.workers_.begin();
+    for (std::size_t i = 0; i < factory.workers_.size(); ++i) {
+        Worker& worker = expect_node(in, worker_it, factory.workers_);
+        worker.processing_rng_ = UniformBuffer(load_stream(in));
+        load_routing(in, worker.receiver_preferences_);
+        load_packages(in, worker, packages);
+        for (auto& slot: worker.slots_) {
+            slot.package = load_package(in, packages);
+            slot.start_time = in.number<Time>();
+            slot.duration = in.number<TimeOffset>();
+            if (slot.package && slot.duration < 1) {
+                throw std::invalid_argument("Corrupted checkpoint: processing time must be positive!");
+            }
+            slot.finished = in.flag();
+        }
+        worker.sending_buffer = load_package(in, packages);
+    }
+    auto storehouse_it = factory.storehouses_.begin();
+    for (std::size_t i = 0; i < factory.storehouses_.size(); ++i) {
+        Storehouse& storehouse = expect_node(in, storehouse_it, factory.storehouses_);
+        load_packages(in, *storehouse.d_, packages);
+    }
+    if (!in.at_end()) throw std::invalid_argument("Corrupted checkpoint: trailing data!");
+
+    factory.rebuild_consistency();
+    return factory;
+}
+
+void save_checkpoint(const Factory& factory, std::ostream& os) { CheckpointIO::save(factory, os); }
+
+Factory load_checkpoint(std::istream& is) { return CheckpointIO::load(is); }
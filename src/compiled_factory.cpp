@@ -0,0 +1,301 @@
+#include "compiled_factory.hpp"
+
+#include <stdexcept>
+
+CompiledFactory::CompiledFactory(Factory& factory, Time first_turn) : factory_(&factory), time_(first_turn) {
+    if (!factory.is_consistent()) throw std::logic_error("IS CONSISTANT ERROR!");
+
+    // Cel według rodzaju i gęstego indeksu odbiorcy.
+    std::vector<std::uint32_t> worker_target(factory.worker_index_bound(), NONE);
+    std::vector<std::uint32_t> storehouse_target(factory.storehouse_index_bound(), NONE);
+
+    for (auto it = factory.storehouse_begin(); it != factory.storehouse_end(); ++it) {
+        storehouse_target[it->get_index()] = STOREHOUSE_TARGET | static_cast<std::uint32_t>(storehouses_.size());
+        storehouses_.push_back(&*it);
+        storehouse_load_.push_back(it->get_load());
+    }
+    stock_.resize(storehouses_.size());
+
+    // Najpierw kopiowany jest stan bez półproduktów i sprawdzana struktura, by wyjątek
+    // z konstruktora nie zostawił fabryki bez przeniesionych już półproduktów.
+    std::size_t package_count = 0;
+    for (auto it = factory.worker_begin(); it != factory.worker_end(); ++it) {
+        Worker& worker = *it;
+        worker_target[worker.get_index()] = static_cast<std::uint32_t>(workers_.size());
+        workers_.push_back(&worker);
+        config_.push_back(worker.config_);
+        processing_rng_.push_back(worker.processing_rng_);
+        lifo_.push_back(worker.get_queue_type() == PackageQueueType::LIFO);
+        queue_.emplace_back();
+        queue_size_.push_back(0);
+        package_count += worker.size();
+
+        slot_offset_.push_back(static_cast<std::uint32_t>(slot_package_.size()));
+        for (const auto& slot: worker.slots_) {
+            slot_package_.push_back(NONE);
+            slot_start_.push_back(slot.start_time);
+            slot_duration_.push_back(slot.duration);
+            slot_finished_.push_back(slot.finished);
+            if (slot.package) ++package_count;
+        }
+
+        worker_buffer_.push_back(NONE);
+        if (static_cast<const PackageSender&>(worker).sending_buffer) ++package_count;
+    }
+    slot_offset_.push_back(static_cast<std::uint32_t>(slot_package_.size()));
+
+    for (auto it = factory.ramp_begin(); it != factory.ramp_end(); ++it) {
+        Ramp& ramp = *it;
+        ramps_.push_back(&ramp);
+        next_delivery_.push_back(ramp.next_delivery_);
+        delivery_di_.push_back(ramp.di_);
+        delivery_interval_.push_back(ramp.delivery_interval_);
+        delivery_rng_.push_back(ramp.delivery_rng_);
+        trace_.push_back(ramp.trace_);
+        ramp_buffer_.push_back(NONE);
+        if (static_cast<const PackageSender&>(ramp).sending_buffer) ++package_count;
+    }
+
+    sender_offset_.push_back(0);
+    auto compile_sender = [&](const PackageSender& sender) {
+        const ReceiverPreferences& preferences = sender.receiver_preferences_;
+        // Tablica trasowania ma odbiorców w kolejności preferencji (uchwyty mogą czekać na przeliczenie).
+        std::size_t i = 0;
+        for (const auto& elem: preferences.get_preferences()) {
+            const IPackageReceiver* receiver = elem.first;
+            if (!factory.owns(receiver)) throw std::logic_error("A receiver does not belong to the factory!");
+            const std::uint32_t target = (receiver->get_kind() == ReceiverKind::WORKER)
+                                         ? worker_target[receiver->get_index()]
+                                         : storehouse_target[receiver->get_index()];
+            targets_.push_back(target);
+            cumulative_.push_back(preferences.table_.cumulative[i++]);
+        }
+        sender_offset_.push_back(static_cast<std::uint32_t>(targets_.size()));
+        policy_.push_back(preferences.policy_);
+        cursor_.push_back(preferences.table_.cursor);
+        generator_.push_back(preferences.probability_gen_);
+    };
+    for (const Ramp* ramp: ramps_) compile_sender(*ramp);
+    for (const Worker* worker: workers_) compile_sender(*worker);
+
+    packages_.reserve(package_count);
+    next_.reserve(package_count);
+    worker_due_.reserve(workers_.size());
+
+    // Pula ma już zarezerwowane miejsce, więc przenoszenie półproduktów nie zgłasza wyjątków.
+    for (std::size_t w = 0; w < workers_.size(); ++w) {
+        Worker& worker = *workers_[w];
+        // `pop()` zwraca elementy od końca kolejki LIFO, czyli w kolejności jej reprezentacji.
+        while (!worker.empty()) {
+            append(queue_[w], store(worker.pop()));
+            ++queue_size_[w];
+        }
+
+        for (std::size_t i = 0; i < worker.slots_.size(); ++i) {
+            auto& slot = worker.slots_[i];
+            if (!slot.package) continue;
+            slot_package_[slot_offset_[w] + i] = store(std::move(*slot.package));
+            slot.package.reset();
+        }
+
+        PackageSender& sender = worker;
+        if (sender.sending_buffer) worker_buffer_[w] = store(std::move(*sender.sending_buffer));
+        sender.sending_buffer.reset();
+    }
+
+    for (std::size_t r = 0; r < ramps_.size(); ++r) {
+        PackageSender& sender = *ramps_[r];
+        if (sender.sending_buffer) ramp_buffer_[r] = store(std::move(*sender.sending_buffer));
+        sender.sending_buffer.reset();
+    }
+
+    for (std::size_t w = 0; w < workers_.size(); ++w) worker_due_.push_back(next_event(w, time_));
+}
+
+std::uint32_t CompiledFactory::store(Package&& package) {
+    packages_.push_back(std::move(package));
+    next_.push_back(NONE);
+    return static_cast<std::uint32_t>(packages_.size() - 1);
+}
+
+void CompiledFactory::append(PackageList& list, std::uint32_t package) {
+    next_[package] = NONE;
+    if (list.tail == NONE) list.head = package;
+    else next_[list.tail] = package;
+    list.tail = package;
+}
+
+void CompiledFactory::push_front(PackageList& list, std::uint32_t package) {
+    next_[package] = list.head;
+    list.head = package;
+    if (list.tail == NONE) list.tail = package;
+}
+
+std::uint32_t CompiledFactory::pop_front(PackageList& list) {
+    std::uint32_t package = list.head;
+    list.head = next_[package];
+    if (list.head == NONE) list.tail = NONE;
+    return package;
+}
+
+void CompiledFactory::send(std::size_t sender, std::uint32_t& buffer) {
+    if (buffer == NONE) return;
+
+    const std::uint32_t first = sender_offset_[sender];
+    const std::size_t count = sender_offset_[sender + 1] - first;
+    if (count == 0) throw std::logic_error("The sender has no recipients!");
+
+    RoutingView view{{this, targets_.data() + first, count}, cumulative_.data() + first, cursor_[sender]};
+    std::size_t chosen = 0;
+    switch (policy_[sender]) {
+        case RoutingPolicyType::WEIGHTED_RANDOM:
+            chosen = WeightedRandomPolicy::choose(view, generator_[sender]);
+            break;
+        case RoutingPolicyType::ROUND_ROBIN:
+            chosen = RoundRobinPolicy::choose(view, generator_[sender]);
+            break;
+        case RoutingPolicyType::JOIN_SHORTEST_QUEUE:
+            chosen = JoinShortestQueuePolicy::choose(view, generator_[sender]);
+            break;
+        case RoutingPolicyType::POWER_OF_TWO_CHOICES:
+            chosen = PowerOfTwoChoicesPolicy::choose(view, generator_[sender]);
+            break;
+    }
+    cursor_[sender] = view.cursor;
+
+    const std::uint32_t target = targets_[first + chosen];
+    if (target & STOREHOUSE_TARGET) {
+        append(stock_[target & ~STOREHOUSE_TARGET], buffer);
+    } else {
+        if (lifo_[target]) push_front(queue_[target], buffer);
+        else append(queue_[target], buffer);
+        ++queue_size_[target];
+        // Robotnik dalej w kolejności obsłuży półprodukt jeszcze w tej turze.
+        worker_due_[target] = std::min(worker_due_[target], (ramps_.size() + target > sender) ? time_ : time_ + 1);
+    }
+    buffer = NONE;
+}
+
+bool CompiledFactory::release_finished(std::size_t worker) {
+    if (worker_buffer_[worker] != NONE) return false;
+    for (std::uint32_t slot = slot_offset_[worker]; slot != slot_offset_[worker + 1]; ++slot) {
+        if (slot_finished_[slot]) {
+            worker_buffer_[worker] = slot_package_[slot];
+            slot_package_[slot] = NONE;
+            slot_finished_[slot] = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+Time CompiledFactory::next_event(std::size_t worker, Time now) const {
+    if (worker_buffer_[worker] != NONE) return now;
+
+    Time next = TIME_NEVER;
+    for (std::uint32_t slot = slot_offset_[worker]; slot != slot_offset_[worker + 1]; ++slot) {
+        if (slot_finished_[slot]) return now;
+        if (slot_package_[slot] == NONE) {
+            if (queue_size_[worker] != 0) return now;
+            continue;
+        }
+        next = std::min(next, std::max<Time>(slot_start_[slot] + slot_duration_[slot] - 1, now));
+    }
+    return next;
+}
+
+void CompiledFactory::process(std::size_t worker, Time t) {
+    for (std::uint32_t slot = slot_offset_[worker]; slot != slot_offset_[worker + 1]; ++slot) {
+        if (slot_package_[slot] == NONE && queue_size_[worker] != 0) {
+            slot_package_[slot] = pop_front(queue_[worker]);
+            --queue_size_[worker];
+            slot_start_[slot] = t;
+            slot_duration_[slot] = config_[worker]->processing_time.sample(processing_rng_[worker]);
+        }
+        if (slot_package_[slot] != NONE && t - slot_start_[slot] == slot_duration_[slot] - 1) {
+            slot_finished_[slot] = true;
+        }
+    }
+    release_finished(worker);
+}
+
+void CompiledFactory::run(TimeOffset turns) {
+    if (written_back_) throw std::logic_error("The compiled factory has already been written back!");
+
+    const std::size_t ramp_count = ramps_.size();
+    for (const Time end = time_ + turns; time_ != end; ++time_) {
+        for (std::size_t r = 0; r < ramp_count; ++r) {
+            if (time_ >= next_delivery_[r] && advance_delivery(time_, next_delivery_[r], delivery_di_[r],
+                                                               delivery_interval_[r], delivery_rng_[r], trace_[r])) {
+                ramp_buffer_[r] = store(Package(factory_->get_package_registry()));
+            }
+            send(r, ramp_buffer_[r]);
+        }
+        for (std::size_t w = 0; w < workers_.size(); ++w) {
+            if (worker_due_[w] > time_) continue;
+            send(ramp_count + w, worker_buffer_[w]);
+            while (release_finished(w)) send(ramp_count + w, worker_buffer_[w]);
+            process(w, time_);
+            worker_due_[w] = next_event(w, time_ + 1);
+        }
+    }
+}
+
+CompiledFactory::~CompiledFactory() {
+    // Destruktor nie może zgłosić wyjątku; półprodukty giną tylko przy braku pamięci.
+    try {
+        write_back();
+    } catch (...) {
+    }
+}
+
+void CompiledFactory::write_back() {
+    if (written_back_) return;
+    written_back_ = true;
+    factory_->set_time(time_);
+
+    auto take = [this](std::uint32_t package) { return std::move(packages_[package]); };
+    auto restore_routing = [this](PackageSender& sender, std::size_t index) {
+        sender.receiver_preferences_.table_.cursor = cursor_[index];
+        sender.receiver_preferences_.probability_gen_ = generator_[index];
+    };
+
+    for (std::size_t r = 0; r < ramps_.size(); ++r) {
+        Ramp& ramp = *ramps_[r];
+        ramp.next_delivery_ = next_delivery_[r];
+        ramp.delivery_rng_ = delivery_rng_[r];
+        ramp.trace_ = std::move(trace_[r]);
+        restore_routing(ramp, r);
+        if (ramp_buffer_[r] != NONE) static_cast<PackageSender&>(ramp).sending_buffer.emplace(take(ramp_buffer_[r]));
+    }
+
+    for (std::size_t w = 0; w < workers_.size(); ++w) {
+        Worker& worker = *workers_[w];
+        worker.processing_rng_ = processing_rng_[w];
+        restore_routing(worker, ramps_.size() + w);
+
+        std::vector<std::uint32_t> queued;
+        for (std::uint32_t package = queue_[w].head; package != NONE; package = next_[package]) queued.push_back(package);
+        if (lifo_[w]) std::reverse(queued.begin(), queued.end());
+        for (std::uint32_t package: queued) worker.push(take(package));
+
+        for (std::uint32_t slot = slot_offset_[w]; slot != slot_offset_[w + 1]; ++slot) {
+            ProcessingSlot& target = worker.slots_[slot - slot_offset_[w]];
+            if (slot_package_[slot] != NONE) target.package.emplace(take(slot_package_[slot]));
+            target.start_time = slot_start_[slot];
+            target.duration = slot_duration_[slot];
+            target.finished = slot_finished_[slot];
+        }
+
+        if (worker_buffer_[w] != NONE) static_cast<PackageSender&>(worker).sending_buffer.emplace(take(worker_buffer_[w]));
+    }
+
+    for (std::size_t s = 0; s < storehouses_.size(); ++s) {
+        for (std::uint32_t package = stock_[s].head; package != NONE; package = next_[package]) {
+            storehouses_[s]->receive_package(take(package));
+        }
+    }
+
+    packages_.clear();
+    next_.clear();
+}
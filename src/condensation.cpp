@@ -0,0 +1,145 @@
+#include "condensation.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+Condensation::Condensation(const Factory& factory) {
+    constexpr std::uint32_t NONE = std::numeric_limits<std::uint32_t>::max();
+
+    // Węzły i odwzorowanie gęstych indeksów odbiorców (osobno robotników i magazynów) na węzły.
+    std::vector<std::uint32_t> worker_node(factory.worker_index_bound(), NONE);
+    std::vector<std::uint32_t> storehouse_node(factory.storehouse_index_bound(), NONE);
+    std::vector<const ReceiverPreferences*> preferences;
+    auto add_node = [&](ElementType type, ElementID id, const ReceiverPreferences* prefs) {
+        const auto v = static_cast<std::uint32_t>(nodes_.size());
+        nodes_.push_back({type, id});
+        index_.emplace(std::make_pair(type, id), v);
+        preferences.push_back(prefs);
+        return v;
+    };
+    for (auto it = factory.ramp_cbegin(); it != factory.ramp_cend(); ++it) {
+        add_node(ElementType::LOADING_RAMP, it->get_id(), &it->receiver_preferences_);
+    }
+    for (auto it = factory.worker_cbegin(); it != factory.worker_cend(); ++it) {
+        worker_node[it->get_index()] = add_node(ElementType::WORKER, it->get_id(), &it->receiver_preferences_);
+    }
+    for (auto it = factory.storehouse_cbegin(); it != factory.storehouse_cend(); ++it) {
+        storehouse_node[it->get_index()] = add_node(ElementType::STOREHOUSE, it->get_id(), nullptr);
+    }
+    const auto n = static_cast<std::uint32_t>(nodes_.size());
+
+    // Sąsiedztwo (CSR); pętle własne zapamiętywane osobno.
+    std::vector<std::uint32_t> offset(n + 1, 0);
+    std::vector<std::uint32_t> target;
+    std::vector<std::uint8_t> self_loop(n, 0);
+    for (std::uint32_t v = 0; v < n; ++v) {
+        if (preferences[v]) {
+            for (const auto& elem: preferences[v]->get_preferences()) {
+                const IPackageReceiver* receiver = elem.first;
+                if (!factory.owns(receiver)) continue;
+                const std::uint32_t w = (receiver->get_kind() == ReceiverKind::WORKER)
+                                        ? worker_node[receiver->get_index()] : storehouse_node[receiver->get_index()];
+                if (w == v) self_loop[v] = 1;
+                target.push_back(w);
+            }
+        }
+        offset[v + 1] = static_cast<std::uint32_t>(target.size());
+    }
+
+    // Tarjan bez rekurencji: jawny stos wywołań (węzeł, następna krawędź).
+    std::vector<std::uint32_t> order(n, NONE);
+    std::vector<std::uint32_t> low(n, 0);
+    std::vector<std::uint8_t> on_stack(n, 0);
+    std::vector<std::uint32_t> stack;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> calls;
+    std::vector<std::uint32_t> finished;
+    std::vector<std::uint32_t> finished_offset{0};
+    std::uint32_t next_order = 0;
+    for (std::uint32_t root = 0; root < n; ++root) {
+        if (order[root] != NONE) continue;
+        calls.emplace_back(root, offset[root]);
+        order[root] = low[root] = next_order++;
+        stack.push_back(root);
+        on_stack[root] = 1;
+        while (!calls.empty()) {
+            const std::uint32_t v = calls.back().first;
+            std::uint32_t& e = calls.back().second;
+            if (e != offset[v + 1]) {
+                const std::uint32_t w = target[e++];
+                if (order[w] == NONE) {
+                    calls.emplace_back(w, offset[w]);
+                    order[w] = low[w] = next_order++;
+                    stack.push_back(w);
+                    on_stack[w] = 1;
+                } else if (on_stack[w]) {
+                    low[v] = std::min(low[v], order[w]);
+                }
+                continue;
+            }
+            calls.pop_back();
+            if (!calls.empty()) low[calls.back().first] = std::min(low[calls.back().first], low[v]);
+            if (low[v] != order[v]) continue;
+            std::uint32_t w;
+            do {
+                w = stack.back();
+                stack.pop_back();
+                on_stack[w] = 0;
+                finished.push_back(w);
+            } while (w != v);
+            finished_offset.push_back(static_cast<std::uint32_t>(finished.size()));
+        }
+    }
+
+    // Tarjan zamyka składowe w odwrotnym porządku topologicznym - numeracja od końca.
+    const auto components = static_cast<std::uint32_t>(finished_offset.size() - 1);
+    component_.assign(n, 0);
+    member_offset_.assign(components + 1, 0);
+    members_.reserve(n);
+    cycle_.assign(components, 0);
+    for (std::uint32_t c = 0; c < components; ++c) {
+        const std::uint32_t closed = components - 1 - c;
+        for (std::uint32_t k = finished_offset[closed]; k != finished_offset[closed + 1]; ++k) {
+            component_[finished[k]] = c;
+            members_.push_back(finished[k]);
+            if (self_loop[finished[k]]) cycle_[c] = 1;
+        }
+        std::sort(members_.begin() + member_offset_[c], members_.end());
+        member_offset_[c + 1] = static_cast<std::uint32_t>(members_.size());
+        if (member_offset_[c + 1] - member_offset_[c] > 1) cycle_[c] = 1;
+    }
+
+    // Krawędzie kondensacji bez powtórzeń oraz poziomy (najdłuższa ścieżka od źródeł).
+    successor_offset_.assign(components + 1, 0);
+    level_.assign(components, 0);
+    std::vector<std::uint32_t> seen(components, NONE);
+    for (std::uint32_t c = 0; c < components; ++c) {
+        const auto first = successors_.size();
+        for (std::uint32_t v: members(c)) {
+            for (std::uint32_t e = offset[v]; e != offset[v + 1]; ++e) {
+                const std::uint32_t d = component_[target[e]];
+                if (d == c || seen[d] == c) continue;
+                seen[d] = c;
+                successors_.push_back(d);
+            }
+        }
+        std::sort(successors_.begin() + first, successors_.end());
+        successor_offset_[c + 1] = static_cast<std::uint32_t>(successors_.size());
+        for (std::uint32_t d: successors(c)) level_[d] = std::max(level_[d], level_[c] + 1);
+        level_count_ = std::max(level_count_, level_[c] + 1);
+    }
+}
+
+std::uint32_t Condensation::component_of(ElementType element_type, ElementID id) const {
+    auto it = index_.find(std::make_pair(element_type, id));
+    if (it == index_.end()) throw std::invalid_argument("The factory has no such node!");
+    return component_[it->second];
+}
+
+std::vector<std::uint32_t> Condensation::cycles() const {
+    std::vector<std::uint32_t> result;
+    for (std::uint32_t c = 0; c < cycle_.size(); ++c) {
+        if (cycle_[c]) result.push_back(c);
+    }
+    return result;
+}
@@ -0,0 +1,311 @@
+#include "consistency.hpp"
+
+ConsistencyTracker::~ConsistencyTracker() {
+    for (ReceiverPreferences* preferences: preferences_) {
+        if (preferences) preferences->set_link_observer(nullptr);
+    }
+}
+
+void ConsistencyTracker::add_node(Ramp& ramp) { add(NodeKind::RAMP, &ramp.receiver_preferences_, nullptr); }
+
+void ConsistencyTracker::add_node(Worker& worker) { add(NodeKind::WORKER, &worker.receiver_preferences_, &worker); }
+
+void ConsistencyTracker::add_node(Storehouse& storehouse) { add(NodeKind::STOREHOUSE, nullptr, &storehouse); }
+
+void ConsistencyTracker::remove_node(Ramp& ramp) {
+    remove_outgoing(ramp.receiver_preferences_);
+    remove(index_of(&ramp.receiver_preferences_));
+}
+
+void ConsistencyTracker::remove_node(Worker& worker) {
+    remove_outgoing(worker.receiver_preferences_);
+    remove(index_of(&worker.receiver_preferences_));
+}
+
+void ConsistencyTracker::remove_node(Storehouse& storehouse) { remove(index_of(&storehouse)); }
+
+std::uint32_t ConsistencyTracker::add(NodeKind kind, ReceiverPreferences* preferences, IPackageReceiver* receiver) {
+    std::uint32_t node;
+    if (free_.empty()) {
+        node = static_cast<std::uint32_t>(kind_.size());
+        kind_.push_back(kind);
+        preferences_.push_back(preferences);
+        receiver_.push_back(receiver);
+        storehouse_links_.push_back(0);
+        good_links_.push_back(0);
+        reachable_links_.push_back(0);
+        good_.push_back(0);
+        reachable_.push_back(0);
+        violating_.push_back(0);
+    } else {
+        node = free_.back();
+        free_.pop_back();
+        kind_[node] = kind;
+        preferences_[node] = preferences;
+        receiver_[node] = receiver;
+    }
+    if (preferences) {
+        sender_index_.emplace(preferences, node);
+        preferences->set_link_observer(this);
+    }
+    if (receiver) receiver_index_.emplace(receiver, node);
+    if (bulk_ || stale_) return node;
+
+    // Węzeł mógł zostać połączony, zanim trafił do fabryki.
+    if (preferences) {
+        for (const auto& elem: preferences->get_preferences()) on_link_added(*preferences, elem.first);
+    }
+    if (kind == NodeKind::STOREHOUSE) {
+        good_[node] = 1;
+        spread_good(node);
+    } else {
+        for_each_predecessor(node, [this, node](std::uint32_t predecessor) {
+            if (reachable_[predecessor]) ++reachable_links_[node];
+        });
+        if (kind == NodeKind::RAMP || reachable_links_[node]) {
+            reachable_[node] = 1;
+            spread_reachable(node);
+        }
+    }
+    update_violation(node);
+    return node;
+}
+
+void ConsistencyTracker::remove_outgoing(ReceiverPreferences& preferences) {
+    while (!preferences.get_preferences().empty()) {
+        preferences.remove_receiver(preferences.get_preferences().begin()->first);
+    }
+}
+
+void ConsistencyTracker::remove(std::uint32_t node) {
+    if (node == NONE) return;
+    if (violating_[node]) --violations_;
+    if (preferences_[node]) {
+        preferences_[node]->set_link_observer(nullptr);
+        sender_index_.erase(preferences_[node]);
+    }
+    if (receiver_[node]) receiver_index_.erase(receiver_[node]);
+    preferences_[node] = nullptr;
+    receiver_[node] = nullptr;
+    storehouse_links_[node] = good_links_[node] = reachable_links_[node] = 0;
+    good_[node] = reachable_[node] = violating_[node] = 0;
+    free_.push_back(node);
+}
+
+std::uint32_t ConsistencyTracker::index_of(const ReceiverPreferences* preferences) const {
+    auto it = sender_index_.find(preferences);
+    return (it == sender_index_.end()) ? NONE : it->second;
+}
+
+std::uint32_t ConsistencyTracker::index_of(const IPackageReceiver* receiver) const {
+    auto it = receiver_index_.find(receiver);
+    return (it == receiver_index_.end()) ? NONE : it->second;
+}
+
+template<typename Visit>
+void ConsistencyTracker::for_each_successor(std::uint32_t node, Visit&& visit) const {
+    if (!preferences_[node]) return;
+    for (const auto& elem: preferences_[node]->get_preferences()) {
+        std::uint32_t successor = index_of(elem.first);
+        if (successor != NONE) visit(successor);
+    }
+}
+
+template<typename Visit>
+void ConsistencyTracker::for_each_predecessor(std::uint32_t node, Visit&& visit) const {
+    if (!receiver_[node]) return;
+    for (const ReceiverPreferences* sender: receiver_[node]->get_senders()) {
+        std::uint32_t predecessor = index_of(sender);
+        if (predecessor != NONE) visit(predecessor);
+    }
+}
+
+void ConsistencyTracker::on_link_added(const ReceiverPreferences& sender, IPackageReceiver* receiver) {
+    const std::uint32_t from = index_of(&sender);
+    if (from == NONE || bulk_ || stale_) return;
+    if (receiver->get_kind() == ReceiverKind::STOREHOUSE) ++storehouse_links_[from];
+
+    const std::uint32_t to = index_of(receiver);
+    if (to != NONE && good_[to] && kind_[to] != NodeKind::STOREHOUSE) ++good_links_[from];
+    if ((storehouse_links_[from] || good_links_[from]) && !good_[from]) {
+        good_[from] = 1;
+        spread_good(from);
+    }
+    if (to != NONE && reachable_[from] && kind_[to] != NodeKind::STOREHOUSE) {
+        ++reachable_links_[to];
+        if (!reachable_[to]) {
+            reachable_[to] = 1;
+            spread_reachable(to);
+        }
+    }
+    update_violation(from);
+}
+
+void ConsistencyTracker::on_link_removed(const ReceiverPreferences& sender, IPackageReceiver* receiver) {
+    const std::uint32_t from = index_of(&sender);
+    if (from == NONE || bulk_ || stale_) return;
+    const bool to_storehouse = receiver->get_kind() == ReceiverKind::STOREHOUSE;
+    if (to_storehouse) --storehouse_links_[from];
+
+    const std::uint32_t to = index_of(receiver);
+    const bool to_good_worker = to != NONE && good_[to] && kind_[to] == NodeKind::WORKER;
+    if (to_good_worker) --good_links_[from];
+    if (good_[from] && (to_storehouse || to_good_worker)) retract_good(from);
+    if (to != NONE && reachable_[from] && kind_[to] == NodeKind::WORKER) {
+        --reachable_links_[to];
+        if (reachable_[to]) retract_reachable(to);
+    }
+    update_violation(from);
+}
+
+void ConsistencyTracker::on_links_replaced(const ReceiverPreferences&) noexcept {
+    stale_ = true;
+}
+
+std::size_t ConsistencyTracker::violations() {
+    if (stale_.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(refresh_mutex_);
+        if (stale_.load(std::memory_order_relaxed)) {
+            rebuild();
+            stale_.store(false, std::memory_order_release);
+        }
+    }
+    return violations_;
+}
+
+void ConsistencyTracker::begin_bulk(std::size_t nodes) {
+    bulk_ = true;
+    const std::size_t capacity = kind_.size() + nodes;
+    kind_.reserve(capacity);
+    preferences_.reserve(capacity);
+    receiver_.reserve(capacity);
+    storehouse_links_.reserve(capacity);
+    good_links_.reserve(capacity);
+    reachable_links_.reserve(capacity);
+    good_.reserve(capacity);
+    reachable_.reserve(capacity);
+    violating_.reserve(capacity);
+    sender_index_.reserve(sender_index_.size() + nodes);
+    receiver_index_.reserve(receiver_index_.size() + nodes);
+}
+
+void ConsistencyTracker::end_bulk() {
+    bulk_ = false;
+    stale_ = false;
+    rebuild();
+}
+
+// Każdy węzeł trafia na stos raz, zaraz po oznaczeniu - wtedy doliczana jest jego krawędź
+// do liczników sąsiadów.
+void ConsistencyTracker::spread_good(std::uint32_t from) {
+    work_.assign(1, from);
+    while (!work_.empty()) {
+        const std::uint32_t node = work_.back();
+        work_.pop_back();
+        update_violation(node);
+        const bool counted = kind_[node] != NodeKind::STOREHOUSE;
+        for_each_predecessor(node, [this, counted](std::uint32_t predecessor) {
+            if (counted) ++good_links_[predecessor];
+            if (!good_[predecessor]) {
+                good_[predecessor] = 1;
+                work_.push_back(predecessor);
+            }
+        });
+    }
+}
+
+void ConsistencyTracker::spread_reachable(std::uint32_t from) {
+    work_.assign(1, from);
+    while (!work_.empty()) {
+        const std::uint32_t node = work_.back();
+        work_.pop_back();
+        update_violation(node);
+        for_each_successor(node, [this](std::uint32_t successor) {
+            if (kind_[successor] == NodeKind::STOREHOUSE) return;
+            ++reachable_links_[successor];
+            if (!reachable_[successor]) {
+                reachable_[successor] = 1;
+                work_.push_back(successor);
+            }
+        });
+    }
+}
+
+void ConsistencyTracker::retract_good(std::uint32_t from) {
+    if (storehouse_links_[from]) return;
+
+    // Nadmiarowe usunięcie: wszystko powyżej `from`, co mogło zależeć od usuniętej krawędzi.
+    std::vector<std::uint32_t> region{from};
+    good_[from] = 0;
+    for (std::size_t head = 0; head < region.size(); ++head) {
+        for_each_predecessor(region[head], [this, &region](std::uint32_t predecessor) {
+            --good_links_[predecessor];
+            if (good_[predecessor] && !storehouse_links_[predecessor]) {
+                good_[predecessor] = 0;
+                region.push_back(predecessor);
+            }
+        });
+    }
+
+    // Ponowne wyprowadzenie od węzłów, które wciąż mają dobrego następnika spoza obszaru.
+    for (std::uint32_t node: region) {
+        if (!good_[node] && good_links_[node]) {
+            good_[node] = 1;
+            spread_good(node);
+        }
+    }
+    for (std::uint32_t node: region) update_violation(node);
+}
+
+void ConsistencyTracker::retract_reachable(std::uint32_t from) {
+    std::vector<std::uint32_t> region{from};
+    reachable_[from] = 0;
+    for (std::size_t head = 0; head < region.size(); ++head) {
+        for_each_successor(region[head], [this, &region](std::uint32_t successor) {
+            if (kind_[successor] == NodeKind::STOREHOUSE) return;
+            --reachable_links_[successor];
+            if (reachable_[successor] && kind_[successor] != NodeKind::RAMP) {
+                reachable_[successor] = 0;
+                region.push_back(successor);
+            }
+        });
+    }
+
+    for (std::uint32_t node: region) {
+        if (!reachable_[node] && reachable_links_[node]) {
+            reachable_[node] = 1;
+            spread_reachable(node);
+        }
+    }
+    for (std::uint32_t node: region) update_violation(node);
+}
+
+void ConsistencyTracker::update_violation(std::uint32_t node) {
+    const bool violating = kind_[node] != NodeKind::STOREHOUSE && reachable_[node] &&
+                           (preferences_[node]->get_preferences().empty() || !good_[node]);
+    if (violating == static_cast<bool>(violating_[node])) return;
+    violating_[node] = violating;
+    if (violating) ++violations_;
+    else --violations_;
+}
+
+void ConsistencyTracker::rebuild() {
+    std::vector<std::uint32_t> live;
+    for (std::uint32_t node = 0; node < kind_.size(); ++node) {
+        if (!preferences_[node] && !receiver_[node]) continue;
+        live.push_back(node);
+        storehouse_links_[node] = good_links_[node] = reachable_links_[node] = 0;
+        if (preferences_[node]) {
+            for (const auto& elem: preferences_[node]->get_preferences()) {
+                if (elem.first->get_kind() == ReceiverKind::STOREHOUSE) ++storehouse_links_[node];
+            }
+        }
+        good_[node] = kind_[node] == NodeKind::STOREHOUSE || storehouse_links_[node];
+        reachable_[node] = kind_[node] == NodeKind::RAMP;
+    }
+    for (std::uint32_t node: live) {
+        if (good_[node]) spread_good(node);
+        if (reachable_[node]) spread_reachable(node);
+    }
+    for (std::uint32_t node: live) update_violation(node);
+}
@@ -0,0 +1,239 @@
+#include "distributions.hpp"
+#include "text_parsing.hpp"
+
+#include <cmath>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    ZigguratTable make_ziggurat(double r, double tail_area, double (*f)(double), double (*f_inv)(double)) {
+        ZigguratTable t{};
+        const double v = r * f(r) + tail_area;
+        t.r = r;
+        t.x[0] = v / f(r);
+        t.x[1] = r;
+        for (unsigned i = 1; i < ZigguratTable::LAYERS; ++i) {
+            const double y = v / t.x[i] + f(t.x[i]);
+            t.x[i + 1] = (y >= 1) ? 0 : f_inv(y);
+        }
+        t.x[ZigguratTable::LAYERS] = 0;
+        for (unsigned i = 0; i <= ZigguratTable::LAYERS; ++i) t.f[i] = f(t.x[i]);
+        return t;
+    }
+
+    double normal_density(double x) { return std::exp(-0.5 * x * x); }
+
+    double normal_density_inv(double y) { return std::sqrt(-2 * std::log(y)); }
+
+    double exponential_density(double x) { return std::exp(-x); }
+
+    double exponential_density_inv(double y) { return -std::log(y); }
+
+    constexpr double NORMAL_R = 3.6541528853610088;
+    constexpr double EXPONENTIAL_R = 7.69711747013104972;
+
+    // Dzieli `spec` na co najwyżej `N` pól; zwraca ich liczbę (N + 1, gdy pól jest więcej).
+    template<std::size_t N>
+    std::size_t split(std::string_view spec, char delimiter, std::string_view (&parts)[N]) {
+        std::size_t count = 0;
+        while (!spec.empty() && count <= N) {
+            std::string_view field = next_field(spec, delimiter);
+            if (count < N) parts[count] = field;
+            ++count;
+        }
+        return count;
+    }
+
+    template<typename T>
+    T number(std::string_view text, std::string_view spec) {
+        std::optional<T> value = parse_number<T>(text);
+        if (!value) throw std::invalid_argument("Bad time distribution: " + std::string(spec));
+        return *value;
+    }
+
+    std::string format(double value) {
+        std::ostringstream os;
+        os.precision(17);
+        os << value;
+        return os.str();
+    }
+}
+
+const ZigguratTable normal_ziggurat = make_ziggurat(
+        NORMAL_R, std::sqrt(std::acos(-1.0) / 2) * std::erfc(NORMAL_R / std::sqrt(2.0)),
+        normal_density, normal_density_inv);
+
+const ZigguratTable exponential_ziggurat = make_ziggurat(
+        EXPONENTIAL_R, std::exp(-EXPONENTIAL_R), exponential_density, exponential_density_inv);
+
+
+AliasTable::AliasTable(const std::vector<double>& weights) : prob_(weights.size()), alias_(weights.size()) {
+    const std::size_t n = weights.size();
+    const double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+    if (n == 0 || !(total > 0)) throw std::invalid_argument("Alias table needs positive weights!");
+
+    std::vector<double> scaled(n);
+    std::vector<std::uint32_t> small, large;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (weights[i] < 0) throw std::invalid_argument("Alias table needs positive weights!");
+        scaled[i] = weights[i] * n / total;
+        (scaled[i] < 1 ? small : large).push_back(static_cast<std::uint32_t>(i));
+    }
+    while (!small.empty() && !large.empty()) {
+        std::uint32_t s = small.back(), l = large.back();
+        small.pop_back();
+        prob_[s] = scaled[s];
+        alias_[s] = l;
+        scaled[l] = (scaled[l] + scaled[s]) - 1;
+        if (scaled[l] < 1) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    for (auto i : large) {
+        prob_[i] = 1;
+        alias_[i] = i;
+    }
+    for (auto i : small) {
+        prob_[i] = 1;
+        alias_[i] = i;
+    }
+}
+
+
+TimeDistribution TimeDistribution::fixed(TimeOffset value) {
+    TimeDistribution d;
+    d.type_ = DistributionType::FIXED;
+    d.fixed_ = value;
+    return d;
+}
+
+TimeDistribution TimeDistribution::exponential(double mean) {
+    if (!(mean > 0) || !std::isfinite(mean)) {
+        throw std::invalid_argument("Exponential distribution needs a positive finite mean!");
+    }
+    TimeDistribution d;
+    d.type_ = DistributionType::EXPONENTIAL;
+    d.a_ = mean;
+    return d;
+}
+
+TimeDistribution TimeDistribution::erlang(unsigned k, double mean) {
+    if (k == 0 || k > MAX_ERLANG_K || !(mean > 0) || !std::isfinite(mean)) {
+        throw std::invalid_argument("Erlang distribution needs 1 <= k <= " + std::to_string(MAX_ERLANG_K) +
+                                    " and a positive finite mean!");
+    }
+    TimeDistribution d;
+    d.type_ = DistributionType::ERLANG;
+    d.k_ = k;
+    d.a_ = mean / k;
+    return d;
+}
+
+TimeDistribution TimeDistribution::lognormal(double mu, double sigma) {
+    if (!std::isfinite(mu) || !(sigma >= 0) || !std::isfinite(sigma)) {
+        throw std::invalid_argument("Lognormal distribution needs a finite mu and a non-negative finite sigma!");
+    }
+    TimeDistribution d;
+    d.type_ = DistributionType::LOGNORMAL;
+    d.a_ = mu;
+    d.b_ = sigma;
+    return d;
+}
+
+TimeDistribution TimeDistribution::empirical(const std::vector<TimeOffset>& values, const std::vector<double>& weights) {
+    if (values.size() != weights.size()) throw std::invalid_argument("Empirical distribution needs a weight per value!");
+    for (TimeOffset value: values) {
+        if (value < 1) throw std::invalid_argument("Time must be positive: " + std::to_string(value));
+    }
+    TimeDistribution d;
+    d.type_ = DistributionType::EMPIRICAL;
+    d.empirical_ = std::make_shared<const Empirical>(Empirical{values, weights, AliasTable(weights)});
+    return d;
+}
+
+TimeDistribution TimeDistribution::parse(std::string_view spec) {
+    std::string_view parts[3];
+    const std::size_t count = split(spec, ':', parts);
+    if (count == 0) throw std::invalid_argument("Empty time distribution!");
+
+    if (count == 1) {
+        const auto value = number<long long>(parts[0], spec);
+        if (value < 1) throw std::invalid_argument("Time must be positive: " + std::string(spec));
+        if (value > std::numeric_limits<TimeOffset>::max()) {
+            throw std::invalid_argument("Bad time distribution: " + std::string(spec));
+        }
+        return fixed(static_cast<TimeOffset>(value));
+    }
+    if (parts[0] == "exp" && count == 2) return exponential(number<double>(parts[1], spec));
+    if (parts[0] == "erlang" && count == 3) {
+        return erlang(number<unsigned>(parts[1], spec), number<double>(parts[2], spec));
+    }
+    if (parts[0] == "lognormal" && count == 3) {
+        return lognormal(number<double>(parts[1], spec), number<double>(parts[2], spec));
+    }
+    if (parts[0] == "empirical" && count == 2) {
+        std::vector<TimeOffset> values;
+        std::vector<double> weights;
+        std::string_view bins = parts[1];
+        while (!bins.empty()) {
+            std::string_view bin = next_field(bins, ',');
+            std::string_view pair[2];
+            if (split(bin, '@', pair) != 2) throw std::invalid_argument("Bad histogram bin: " + std::string(bin));
+            values.push_back(number<TimeOffset>(pair[0], spec));
+            weights.push_back(number<double>(pair[1], spec));
+        }
+        return empirical(values, weights);
+    }
+    throw std::invalid_argument("Bad time distribution: " + std::string(spec));
+}
+
+double TimeDistribution::mean() const {
+    switch (type_) {
+        case DistributionType::FIXED:
+            return fixed_;
+        case DistributionType::EXPONENTIAL:
+            return a_;
+        case DistributionType::ERLANG:
+            return a_ * k_;
+        case DistributionType::LOGNORMAL:
+            return std::exp(a_ + b_ * b_ / 2);
+        case DistributionType::EMPIRICAL: {
+            double sum = 0, total = 0;
+            for (std::size_t i = 0; i < empirical_->values.size(); ++i) {
+                sum += empirical_->values[i] * empirical_->weights[i];
+                total += empirical_->weights[i];
+            }
+            return sum / total;
+        }
+    }
+    return 0;
+}
+
+TimeOffset TimeDistribution::nominal() const {
+    return is_fixed() ? fixed_ : to_turns(mean());
+}
+
+std::string TimeDistribution::to_string() const {
+    switch (type_) {
+        case DistributionType::FIXED:
+            return std::to_string(fixed_);
+        case DistributionType::EXPONENTIAL:
+            return "exp:" + format(a_);
+        case DistributionType::ERLANG:
+            return "erlang:" + std::to_string(k_) + ":" + format(a_ * k_);
+        case DistributionType::LOGNORMAL:
+            return "lognormal:" + format(a_) + ":" + format(b_);
+        case DistributionType::EMPIRICAL: {
+            std::string spec = "empirical:";
+            for (std::size_t i = 0; i < empirical_->values.size(); ++i) {
+                if (i != 0) spec += ",";
+                spec += std::to_string(empirical_->values[i]) + "@" + format(empirical_->weights[i]);
+            }
+            return spec;
+        }
+    }
+    return "";
+}
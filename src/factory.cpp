@@ -1,70 +1,432 @@
 #include "factory.hpp"
+#include "factory_builder.hpp"
+#include "text_parsing.hpp"
+#include "thread_pool.hpp"
 #include <algorithm>
+#include <atomic>
+#include <iterator>
 #include <map>
+#include <unordered_map>
 #include <memory>
+#include <optional>
 #include <vector>
-#include <typeinfo>
+#include <cstdint>
+#include <limits>
 #include <string>
+#include <string_view>
 #include <sstream>
+#include <stdexcept>
+
+
+namespace {
+    constexpr std::uint32_t NO_SENDER = std::numeric_limits<std::uint32_t>::max();
+
+    // Nadawcy w gęstych tablicach: najpierw rampy, potem robotnicy.
+    template<typename Ramps, typename Workers>
+    void gather_senders(const Ramps& ramps, const Workers& workers, std::vector<const PackageSender*>& senders,
+                        std::vector<ConsistencyIssue>& identity, std::vector<std::uint32_t>& worker_index) {
+        worker_index.assign(workers.slot_count(), NO_SENDER);
+        senders.reserve(ramps.size() + workers.size());
+        identity.reserve(ramps.size() + workers.size());
+        for (const auto& ramp: ramps) {
+            senders.push_back(&ramp);
+            identity.push_back({ElementType::LOADING_RAMP, ramp.get_id(), ConsistencyProblem::NO_RECEIVERS});
+        }
+        for (const auto& worker: workers) {
+            worker_index[worker.get_index()] = static_cast<std::uint32_t>(senders.size());
+            senders.push_back(&worker);
+            identity.push_back({ElementType::WORKER, worker.get_id(), ConsistencyProblem::NO_RECEIVERS});
+        }
+    }
 
-
-bool has_reachable_storehouse(const PackageSender* sender, std::map<const PackageSender*, NodeColor>& node_color_map) {
-    if (node_color_map[sender] == NodeColor::VERIFIED) {
-        return true;
+    template<typename Flags>
+    ConsistencyReport collect_issues(const std::vector<const PackageSender*>& senders,
+                                     const std::vector<ConsistencyIssue>& identity, const Flags& reachable,
+                                     const Flags& reaches_storehouse) {
+        ConsistencyReport report;
+        for (std::size_t s = 0; s < senders.size(); ++s) {
+            if (!reachable[s]) continue;
+            if (senders[s]->receiver_preferences_.get_preferences().empty()) {
+                report.issues.push_back(identity[s]);
+            } else if (!reaches_storehouse[s]) {
+                report.issues.push_back(identity[s]);
+                report.issues.back().problem = ConsistencyProblem::NO_REACHABLE_STOREHOUSE;
+            }
+        }
+        return report;
     }
-    node_color_map[sender] = NodeColor::VISITED;
 
-    if (sender->receiver_preferences_.preferences.empty()) {
-        throw std::logic_error("The sender has no recipients!");
+    using Flags = std::vector<std::atomic<std::uint8_t>>;
+
+    // Przeszukiwanie wszerz poziomami: każdy wątek rozwija swój fragment frontu, a węzeł
+    // zajmuje ten, komu pierwszemu uda się ustawić jego znacznik. Małe fronty (np. długie
+    // łańcuchy) rozwijane są bez synchronizacji z pulą.
+    void parallel_bfs(ThreadPool& pool, std::vector<std::uint32_t> frontier, const std::vector<std::uint32_t>& offset,
+                      const std::vector<std::uint32_t>& edges, Flags& mark) {
+        constexpr std::size_t MIN_PARALLEL_FRONTIER = 4096;
+        std::vector<std::vector<std::uint32_t>> local(pool.size());
+        std::vector<std::uint32_t> next;
+        auto expand = [&](std::size_t begin, std::size_t end, std::vector<std::uint32_t>& out) {
+            for (std::size_t i = begin; i != end; ++i) {
+                const std::uint32_t s = frontier[i];
+                for (std::uint32_t e = offset[s]; e != offset[s + 1]; ++e) {
+                    auto& flag = mark[edges[e]];
+                    if (!flag.load(std::memory_order_relaxed) && !flag.exchange(1, std::memory_order_relaxed)) {
+                        out.push_back(edges[e]);
+                    }
+                }
+            }
+        };
+        while (!frontier.empty()) {
+            next.clear();
+            if (frontier.size() < MIN_PARALLEL_FRONTIER) {
+                expand(0, frontier.size(), next);
+            } else {
+                pool.parallel_for(frontier.size(), [&](std::size_t begin, std::size_t end, unsigned i) {
+                    local[i].clear();
+                    expand(begin, end, local[i]);
+                });
+                for (auto& part: local) {
+                    next.insert(next.end(), part.begin(), part.end());
+                    part.clear();
+                }
+            }
+            frontier.swap(next);
+        }
     }
-    bool reach_store = false;
-    for (const auto& receiver : sender->receiver_preferences_.preferences) {
-        if (receiver.first->get_receiver_type() == ReceiverType::STOREHOUSE) {
-            reach_store = true;
-        } else {
-            IPackageReceiver* receiver_ptr = receiver.first;
-            auto worker_ptr = dynamic_cast<Worker*>(receiver_ptr);
-            auto sendrecv_ptr = dynamic_cast<PackageSender*>(worker_ptr);
+}
 
-            if (sendrecv_ptr == sender) {
-                continue;
+ConsistencyReport Factory::check_consistency() const {
+    std::vector<const PackageSender*> senders;
+    std::vector<ConsistencyIssue> identity;
+    std::vector<std::uint32_t> worker_index;
+    gather_senders(ramps_, workers_, senders, identity, worker_index);
+    const std::size_t n = senders.size();
+
+    // Krawędzie do robotników (CSR); krawędź do magazynu od razu oznacza węzeł jako dobry.
+    std::vector<std::uint32_t> offset(n + 1, 0);
+    std::vector<std::uint32_t> target;
+    std::vector<std::uint8_t> reaches_storehouse(n, 0);
+    for (std::size_t s = 0; s < n; ++s) {
+        for (const auto& elem: senders[s]->receiver_preferences_.get_preferences()) {
+            const IPackageReceiver* receiver = elem.first;
+            switch (receiver->get_kind()) {
+                case ReceiverKind::WORKER:
+                    if (owns(receiver)) target.push_back(worker_index[receiver->get_index()]);
+                    break;
+                case ReceiverKind::STOREHOUSE:
+                    reaches_storehouse[s] = 1;
+                    break;
+                case ReceiverKind::OTHER:
+                    break;
             }
+        }
+        offset[s + 1] = static_cast<std::uint32_t>(target.size());
+    }
 
-            if (node_color_map[sendrecv_ptr] == NodeColor::UNVISITED) {
-                reach_store = has_reachable_storehouse(sendrecv_ptr, node_color_map);
+    // Krawędzie odwrotne (CSR) przez zliczanie.
+    std::vector<std::uint32_t> reverse_offset(n + 1, 0);
+    for (std::uint32_t t: target) ++reverse_offset[t + 1];
+    for (std::size_t s = 0; s < n; ++s) reverse_offset[s + 1] += reverse_offset[s];
+    std::vector<std::uint32_t> reverse(target.size());
+    {
+        std::vector<std::uint32_t> fill(reverse_offset.begin(), reverse_offset.end() - 1);
+        for (std::uint32_t s = 0; s < n; ++s) {
+            for (std::uint32_t e = offset[s]; e != offset[s + 1]; ++e) reverse[fill[target[e]]++] = s;
+        }
+    }
+
+    // Wsteczne przeszukiwanie od węzłów połączonych z magazynem.
+    std::vector<std::uint32_t> queue;
+    for (std::uint32_t s = 0; s < n; ++s) if (reaches_storehouse[s]) queue.push_back(s);
+    for (std::size_t head = 0; head < queue.size(); ++head) {
+        const std::uint32_t s = queue[head];
+        for (std::uint32_t e = reverse_offset[s]; e != reverse_offset[s + 1]; ++e) {
+            if (!reaches_storehouse[reverse[e]]) {
+                reaches_storehouse[reverse[e]] = 1;
+                queue.push_back(reverse[e]);
             }
         }
     }
-    node_color_map[sender] = NodeColor::VERIFIED;
 
-    if (reach_store) {
-        return true;
-    } else {
-        throw std::logic_error("ACCESS DENIED!");
+    // Węzły osiągalne z ramp.
+    std::vector<std::uint8_t> reachable(n, 0);
+    queue.clear();
+    for (std::uint32_t r = 0; r < ramps_.size(); ++r) {
+        reachable[r] = 1;
+        queue.push_back(r);
+    }
+    for (std::size_t head = 0; head < queue.size(); ++head) {
+        const std::uint32_t s = queue[head];
+        for (std::uint32_t e = offset[s]; e != offset[s + 1]; ++e) {
+            if (!reachable[target[e]]) {
+                reachable[target[e]] = 1;
+                queue.push_back(target[e]);
+            }
+        }
     }
 
+    return collect_issues(senders, identity, reachable, reaches_storehouse);
 }
 
-bool Factory::is_consistent() const {
-    std::map<const PackageSender*, NodeColor> map_col;
 
-    for (const auto& ramp : ramps_) {
-        map_col[&ramp] = NodeColor::UNVISITED;
+ConsistencyReport Factory::check_consistency(ThreadPool& pool) const {
+    std::vector<const PackageSender*> senders;
+    std::vector<ConsistencyIssue> identity;
+    std::vector<std::uint32_t> worker_index;
+    gather_senders(ramps_, workers_, senders, identity, worker_index);
+    const std::size_t n = senders.size();
+
+    // Krawędzie do robotników (CSR): każdy wątek czyta preferencje swojego przedziału nadawców
+    // jednokrotnie, do lokalnych tablic, które potem są sklejane w kolejności przedziałów.
+    const unsigned parts = pool.size();
+    std::vector<std::uint32_t> offset(n + 1, 0);
+    Flags reaches_storehouse(n);
+    std::vector<std::vector<std::uint32_t>> local_target(parts);
+    pool.parallel_for(n, [&](std::size_t begin, std::size_t end, unsigned i) {
+        for (std::size_t s = begin; s != end; ++s) {
+            for (const auto& elem: senders[s]->receiver_preferences_.get_preferences()) {
+                const IPackageReceiver* receiver = elem.first;
+                if (receiver->get_kind() == ReceiverKind::STOREHOUSE) {
+                    reaches_storehouse[s].store(1, std::memory_order_relaxed);
+                } else if (receiver->get_kind() == ReceiverKind::WORKER && owns(receiver)) {
+                    local_target[i].push_back(worker_index[receiver->get_index()]);
+                }
+            }
+            offset[s + 1] = static_cast<std::uint32_t>(local_target[i].size());
+        }
+    });
+    const std::size_t chunk = (n + parts - 1) / parts;
+    std::vector<std::uint32_t> part_base(parts + 1, 0);
+    for (unsigned i = 0; i < parts; ++i) part_base[i + 1] = part_base[i] + local_target[i].size();
+    std::vector<std::uint32_t> target(part_base[parts]);
+    pool.parallel_for(n, [&](std::size_t begin, std::size_t end, unsigned i) {
+        for (std::size_t s = begin; s != end; ++s) offset[s + 1] += part_base[i];
+        std::copy(local_target[i].begin(), local_target[i].end(), target.begin() + part_base[i]);
+        std::vector<std::uint32_t>().swap(local_target[i]);
+    });
+
+    // Krawędzie odwrotne bez operacji atomowych: wątki rozrzucają pary (cel, źródło) do kubełków
+    // według przedziału celu, a następnie każdy kubełek jest sortowany przez zliczanie osobno.
+    auto bucket_of = [chunk](std::uint32_t t) { return static_cast<unsigned>(t / chunk); };
+    std::vector<std::vector<std::uint32_t>> bucket_count(parts, std::vector<std::uint32_t>(parts + 1, 0));
+    pool.parallel_for(n, [&](std::size_t begin, std::size_t end, unsigned i) {
+        for (std::uint32_t e = offset[begin]; e != offset[end]; ++e) ++bucket_count[i][bucket_of(target[e]) + 1];
+    });
+    // Pozycja zapisu wątku i w kubełku b: kubełki kolejno, w kubełku wątki kolejno.
+    std::vector<std::uint32_t> bucket_base(parts + 1, 0);
+    std::vector<std::vector<std::uint32_t>> cursor(parts, std::vector<std::uint32_t>(parts, 0));
+    std::uint32_t position = 0;
+    for (unsigned bucket = 0; bucket < parts; ++bucket) {
+        bucket_base[bucket] = position;
+        for (unsigned i = 0; i < parts; ++i) {
+            cursor[i][bucket] = position;
+            position += bucket_count[i][bucket + 1];
+        }
     }
-    for (const auto& worker : workers_) {
-        map_col[&worker] = NodeColor::UNVISITED;
+    bucket_base[parts] = position;
+    std::vector<std::uint32_t> pair_target(target.size());
+    std::vector<std::uint32_t> pair_source(target.size());
+    pool.parallel_for(n, [&](std::size_t begin, std::size_t end, unsigned i) {
+        for (std::size_t s = begin; s != end; ++s) {
+            for (std::uint32_t e = offset[s]; e != offset[s + 1]; ++e) {
+                const std::uint32_t at = cursor[i][bucket_of(target[e])]++;
+                pair_target[at] = target[e];
+                pair_source[at] = static_cast<std::uint32_t>(s);
+            }
+        }
+    });
+    std::vector<std::uint32_t> reverse_offset(n + 1, 0);
+    std::vector<std::uint32_t> reverse(target.size());
+    reverse_offset[n] = static_cast<std::uint32_t>(target.size());
+    pool.parallel_for(n, [&](std::size_t begin, std::size_t end, unsigned bucket) {
+        std::vector<std::uint32_t> fill(end - begin, 0);
+        for (std::uint32_t k = bucket_base[bucket]; k != bucket_base[bucket + 1]; ++k) ++fill[pair_target[k] - begin];
+        std::uint32_t sum = bucket_base[bucket];
+        for (std::size_t t = begin; t != end; ++t) {
+            const std::uint32_t degree = fill[t - begin];
+            reverse_offset[t] = fill[t - begin] = sum;
+            sum += degree;
+        }
+        for (std::uint32_t k = bucket_base[bucket]; k != bucket_base[bucket + 1]; ++k) {
+            reverse[fill[pair_target[k] - begin]++] = pair_source[k];
+        }
+    });
+
+    // Wsteczne przeszukiwanie od węzłów połączonych z magazynem.
+    std::vector<std::uint32_t> frontier;
+    for (std::uint32_t s = 0; s < n; ++s) {
+        if (reaches_storehouse[s].load(std::memory_order_relaxed)) frontier.push_back(s);
     }
+    parallel_bfs(pool, std::move(frontier), reverse_offset, reverse, reaches_storehouse);
+
+    // Węzły osiągalne z ramp.
+    Flags reachable(n);
+    frontier.clear();
+    for (std::uint32_t r = 0; r < ramps_.size(); ++r) {
+        reachable[r].store(1, std::memory_order_relaxed);
+        frontier.push_back(r);
+    }
+    parallel_bfs(pool, std::move(frontier), offset, target, reachable);
+
+    return collect_issues(senders, identity, reachable, reaches_storehouse);
+}
+
+Factory& Factory::operator=(Factory&& other) noexcept {
+    if (this == &other) return *this;
+    // Dotychczasowa sieć niszczona jest w całości (przed swoim rejestrem półproduktów).
+    Factory old(std::move(*this));
+    packages_ = std::move(other.packages_);
+    directory_ = std::move(other.directory_);
+    time_ = other.time_;
+    ramps_ = std::move(other.ramps_);
+    workers_ = std::move(other.workers_);
+    storehouses_ = std::move(other.storehouses_);
+    worker_templates_ = std::move(other.worker_templates_);
+    consistency_ = std::move(other.consistency_);
+    return *this;
+}
 
-    try {
-        for (const auto& ramp : ramps_) {
-            has_reachable_storehouse(&ramp, map_col);
+Factory::~Factory() { disconnect(); }
+
+void Factory::rebuild_consistency() {
+    // Stary obiekt śledzący jest usuwany przed utworzeniem nowego, bo rozpoznaje węzły po adresach.
+    consistency_.reset();
+    consistency_ = std::make_unique<ConsistencyTracker>();
+    consistency_->begin_bulk(ramps_.size() + workers_.size() + storehouses_.size());
+    for (auto& ramp: ramps_) consistency_->add_node(ramp);
+    for (auto& worker: workers_) consistency_->add_node(worker);
+    for (auto& storehouse: storehouses_) consistency_->add_node(storehouse);
+    consistency_->end_bulk();
+}
+
+namespace {
+    template<typename Node>
+    typename NodeCollection<Node>::Layout ordered_layout(const NodeCollection<Node>& nodes,
+                                                         const std::vector<ElementID>& ids) {
+        typename NodeCollection<Node>::Layout layout;
+        layout.slots.reserve(nodes.size());
+        std::vector<std::uint8_t> placed(nodes.slot_count(), 0);
+        for (ElementID id: ids) {
+            auto handle = nodes.find_handle(id);
+            if (!handle) throw std::invalid_argument("The factory has no such node: " + std::to_string(id));
+            if (placed[handle->slot]) throw std::invalid_argument("Duplicate node in the order: " + std::to_string(id));
+            placed[handle->slot] = 1;
+            layout.slots.emplace_back(id);
+        }
+        for (const auto& node: nodes) {
+            if (!placed[nodes.find_handle(node.get_id())->slot]) layout.slots.emplace_back(node.get_id());
         }
-    } catch (std::logic_error&) {
-        return false;
+        return layout;
     }
-    return true;
 }
 
+void Factory::reorder(const std::vector<NodeRef>& order) {
+    std::vector<ElementID> ramps, workers, storehouses;
+    for (const NodeRef& node: order) {
+        switch (node.element_type) {
+            case ElementType::LOADING_RAMP:
+                ramps.push_back(node.id);
+                break;
+            case ElementType::WORKER:
+                workers.push_back(node.id);
+                break;
+            case ElementType::STOREHOUSE:
+                storehouses.push_back(node.id);
+                break;
+            case ElementType::WORKER_TEMPLATE:
+            case ElementType::LINK:
+                throw std::invalid_argument("Only ramps, workers and storehouses can be reordered!");
+        }
+    }
+    const auto ramp_layout = ordered_layout(ramps_, ramps);
+    const auto worker_layout = ordered_layout(workers_, workers);
+    const auto storehouse_layout = ordered_layout(storehouses_, storehouses);
+
+    consistency_.reset();
+    ramps_.arrange(ramp_layout);
+    workers_.arrange(worker_layout);
+    storehouses_.arrange(storehouse_layout);
+    rebuild_consistency();
+}
+
+void Factory::disconnect() {
+    consistency_.reset();
+    // Węzły spoza fabryki ją przeżyją, więc połączenia z nimi usuwane są zwykłą drogą.
+    // Przeglądanie od końca jest bezpieczne: na miejsce usuniętego nadawcy trafia ostatni, już sprawdzony.
+    auto drop_senders = [this](IPackageReceiver& receiver) {
+        for (std::size_t i = receiver.senders_.size(); i-- > 0;) {
+            ReceiverPreferences* sender = receiver.senders_[i];
+            if (sender->directory_ != directory_.get()) sender->remove_receiver(&receiver);
+        }
+        receiver.senders_.clear();
+    };
+    auto drop_receivers = [this](ReceiverPreferences& preferences) {
+        for (const auto& elem: preferences.preferences) {
+            if (!owns(elem.first)) preferences.unlink(elem.first);
+        }
+        preferences.drop_links();
+    };
+    for (auto& worker: workers_) drop_senders(worker);
+    for (auto& storehouse: storehouses_) drop_senders(storehouse);
+    for (auto& ramp: ramps_) drop_receivers(ramp.receiver_preferences_);
+    for (auto& worker: workers_) drop_receivers(worker.receiver_preferences_);
+}
+
+Factory Factory::clone() const {
+    Factory copy;
+    *copy.packages_ = *packages_;
+    copy.time_ = time_;
+    copy.worker_templates_ = worker_templates_;
+
+    // Odbiorcy tworzeni są w kolejności utworzenia oryginałów, bo od niej zależy kolejność preferencji.
+    std::vector<const IPackageReceiver*> receivers;
+    for (const auto& worker: workers_) receivers.push_back(&worker);
+    for (const auto& storehouse: storehouses_) receivers.push_back(&storehouse);
+    std::sort(receivers.begin(), receivers.end(), ReceiverOrder());
+    std::unordered_map<const IPackageReceiver*, std::optional<Worker>> worker_copies;
+    std::unordered_map<const IPackageReceiver*, std::optional<Storehouse>> storehouse_copies;
+    for (const IPackageReceiver* receiver: receivers) {
+        if (receiver->get_kind() == ReceiverKind::WORKER) {
+            worker_copies[receiver].emplace(static_cast<const Worker&>(*receiver), *copy.packages_);
+        } else {
+            storehouse_copies[receiver].emplace(static_cast<const Storehouse&>(*receiver), *copy.packages_);
+        }
+    }
+
+    // Ten sam układ gniazd - ta sama kolejność węzłów w symulacji.
+    PackageRegistry& registry = *copy.packages_;
+    ReceiverDirectory* directory = copy.directory_.get();
+    copy.ramps_ = ramps_.clone(directory, [&registry](const Ramp& ramp) { return Ramp(ramp, registry); });
+    copy.workers_ = workers_.clone(directory, [&worker_copies](const Worker& worker) {
+        return std::move(*worker_copies[&worker]);
+    });
+    copy.storehouses_ = storehouses_.clone(directory, [&storehouse_copies](const Storehouse& storehouse) {
+        return std::move(*storehouse_copies[&storehouse]);
+    });
+
+    std::unordered_map<const IPackageReceiver*, IPackageReceiver*> receiver_copy;
+    auto worker = copy.workers_.begin();
+    for (const auto& original: workers_) receiver_copy.emplace(&original, &*worker++);
+    auto storehouse = copy.storehouses_.begin();
+    for (const auto& original: storehouses_) receiver_copy.emplace(&original, &*storehouse++);
+    // Odbiorcy spoza fabryki pozostają wspólni.
+    auto remap = [&receiver_copy](IPackageReceiver* receiver) {
+        auto it = receiver_copy.find(receiver);
+        return (it == receiver_copy.end()) ? receiver : it->second;
+    };
+    auto ramp = copy.ramps_.begin();
+    for (const auto& original: ramps_) (ramp++)->receiver_preferences_.assign_remapped(original.receiver_preferences_, remap);
+    worker = copy.workers_.begin();
+    for (const auto& original: workers_) {
+        (worker++)->receiver_preferences_.assign_remapped(original.receiver_preferences_, remap);
+    }
+
+    for (auto& node: copy.ramps_) copy.consistency_->add_node(node);
+    for (auto& node: copy.workers_) copy.consistency_->add_node(node);
+    for (auto& node: copy.storehouses_) copy.consistency_->add_node(node);
+    return copy;
+}
 
 void Factory::do_work(Time t) {
     for (auto& worker: workers_) {
@@ -78,6 +440,41 @@ void Factory::do_deliveries(Time t) {
     }
 }
 
+void Factory::remove_ramp(ElementID id) {
+    auto ramp = ramps_.find_by_id(id);
+    if (ramp == ramps_.end()) return;
+    consistency_->remove_node(*ramp);
+    ramps_.remove_by_id(id);
+}
+
+void Factory::reseed(std::uint64_t seed) {
+    set_master_seed(seed);
+    for (auto& ramp: ramps_) {
+        ramp.reseed(seed);
+    }
+    for (auto& worker: workers_) {
+        worker.reseed(seed);
+    }
+}
+
+void Factory::reserve(std::size_t ramps, std::size_t workers, std::size_t storehouses) {
+    ramps_.reserve(ramps);
+    workers_.reserve(workers);
+    storehouses_.reserve(storehouses);
+}
+
+void Factory::add_worker_template(std::shared_ptr<const WorkerConfig> config) {
+    if (config->name.empty()) throw std::invalid_argument("A worker template needs a name!");
+    if (!worker_templates_.emplace(config->name, std::move(config)).second) {
+        throw std::invalid_argument("Duplicate worker template!");
+    }
+}
+
+std::shared_ptr<const WorkerConfig> Factory::find_worker_template(std::string_view name) const {
+    auto it = worker_templates_.find(name);
+    return (it == worker_templates_.end()) ? nullptr : it->second;
+}
+
 void Factory::do_package_passing() {
     for (auto& worker: workers_) {
         worker.send_package();
@@ -94,7 +491,217 @@ void tokenize(std::string& str, std::vector<std::string>& ct, char delimiter) {
 }
 
 
-void save_factory_structure(Factory& factory, std::ostream& os) {
+namespace {
+    void apply_routing_policy(PackageSender& sender, std::string_view name) {
+        auto policy = routing_policy_from_string(name);
+        if (!policy) throw std::invalid_argument("Unknown routing policy: " + std::string(name));
+        sender.receiver_preferences_.set_routing_policy(*policy);
+    }
+}
+
+void set_routing_policy(PackageSender& sender, const ParsedLineData& parsed_line) {
+    auto it = parsed_line.parameters.find("routing");
+    if (it != parsed_line.parameters.end()) apply_routing_policy(sender, it->second);
+}
+
+namespace {
+    PackageQueueType parse_queue_type(std::string_view name) {
+        if (name == "FIFO") return PackageQueueType::FIFO;
+        if (name == "LIFO") return PackageQueueType::LIFO;
+        throw std::invalid_argument("Unknown queue type: " + std::string(name));
+    }
+
+    std::string queue_type_name(PackageQueueType type) {
+        switch (type) {
+            case PackageQueueType::FIFO:
+                return "FIFO";
+            case PackageQueueType::LIFO:
+                return "LIFO";
+        }
+        return "";
+    }
+
+    ElementID parse_element_id(std::string_view text) {
+        auto id = parse_number<ElementID>(text);
+        if (!id) throw std::invalid_argument("Invalid element ID: " + std::string(text));
+        return *id;
+    }
+
+    // "ramp-1", "worker-2", "store-3".
+    NodeRef parse_link_end(std::string_view end) {
+        const std::size_t dash = end.find('-');
+        if (dash == std::string_view::npos) throw std::invalid_argument("Invalid link end: " + std::string(end));
+        const std::string_view kind = end.substr(0, dash);
+        ElementType type;
+        if (kind == "ramp") type = ElementType::LOADING_RAMP;
+        else if (kind == "worker") type = ElementType::WORKER;
+        else if (kind == "store") type = ElementType::STOREHOUSE;
+        else throw std::invalid_argument("Invalid link end: " + std::string(end));
+        return NodeRef{type, parse_element_id(end.substr(dash + 1))};
+    }
+
+    unsigned parse_servers(std::string_view text) {
+        auto servers = parse_number<int>(text);
+        if (!servers) throw std::invalid_argument("Invalid number of servers: " + std::string(text));
+        if (*servers < 1) throw std::invalid_argument("A worker needs at least one server!");
+        return static_cast<unsigned>(*servers);
+    }
+
+    std::optional<ElementType> element_type_from_keyword(std::string_view keyword) {
+        if (keyword == "LOADING_RAMP") return ElementType::LOADING_RAMP;
+        if (keyword == "WORKER") return ElementType::WORKER;
+        if (keyword == "WORKER_TEMPLATE") return ElementType::WORKER_TEMPLATE;
+        if (keyword == "STOREHOUSE") return ElementType::STOREHOUSE;
+        if (keyword == "LINK") return ElementType::LINK;
+        return std::nullopt;
+    }
+
+    bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    std::string_view next_token(std::string_view& line) {
+        std::size_t begin = 0;
+        while (begin < line.size() && is_blank(line[begin])) ++begin;
+        std::size_t end = begin;
+        while (end < line.size() && !is_blank(line[end])) ++end;
+        const std::string_view token = line.substr(begin, end - begin);
+        line.remove_prefix(end);
+        return token;
+    }
+
+    // Dzieli wiersz na słowo kluczowe i pary klucz=wartość przekazywane do `on_pair`
+    // jako widoki na wiersz - bez kopiowania i alokacji.
+    template<typename OnPair>
+    ElementType scan_line(std::string_view line, OnPair&& on_pair) {
+        const std::string_view keyword = next_token(line);
+        auto type = element_type_from_keyword(keyword);
+        if (!type) throw std::invalid_argument("Unknown element type: " + std::string(keyword));
+        for (std::string_view token = next_token(line); !token.empty(); token = next_token(line)) {
+            const std::size_t eq = token.find('=');
+            if (eq == std::string_view::npos) throw std::invalid_argument("Expected key=value: " + std::string(token));
+            on_pair(token.substr(0, eq), token.substr(eq + 1));
+        }
+        return *type;
+    }
+
+    // Parametry rozpoznawane przy wczytywaniu struktury; pozostałe są pomijane.
+    enum class LineKey {
+        ID, DELIVERY_INTERVAL, TRACE, NAME, PROCESSING_TIME, QUEUE_TYPE, SERVERS, TEMPLATE, ROUTING, SRC, DEST, COUNT
+    };
+
+    constexpr std::string_view LINE_KEY_NAMES[] = {
+            "id", "delivery-interval", "trace", "name", "processing-time", "queue-type", "servers", "template",
+            "routing", "src", "dest"
+    };
+
+    static_assert(std::size(LINE_KEY_NAMES) == static_cast<std::size_t>(LineKey::COUNT));
+
+    // Wartości parametrów wiersza w stałych polach (powtórzony klucz - wygrywa ostatni).
+    class LineFields {
+    public:
+        void set(std::string_view key, std::string_view value) {
+            for (std::size_t i = 0; i < std::size(LINE_KEY_NAMES); ++i) {
+                if (LINE_KEY_NAMES[i] == key) {
+                    values_[i] = value;
+                    present_ |= 1U << i;
+                    return;
+                }
+            }
+        }
+
+        bool has(LineKey key) const { return present_ & (1U << static_cast<unsigned>(key)); }
+
+        std::string_view operator[](LineKey key) const {
+            if (!has(key)) {
+                throw std::invalid_argument("Missing parameter: " +
+                                            std::string(LINE_KEY_NAMES[static_cast<std::size_t>(key)]));
+            }
+            return values_[static_cast<std::size_t>(key)];
+        }
+
+    private:
+        std::string_view values_[static_cast<std::size_t>(LineKey::COUNT)];
+        unsigned present_ = 0;
+    };
+
+    void reject_template_overrides(const LineFields& fields) {
+        for (LineKey key: {LineKey::PROCESSING_TIME, LineKey::QUEUE_TYPE, LineKey::SERVERS}) {
+            if (fields.has(key)) {
+                throw std::invalid_argument("A templated worker cannot override " +
+                                            std::string(LINE_KEY_NAMES[static_cast<std::size_t>(key)]));
+            }
+        }
+    }
+
+    std::shared_ptr<const WorkerConfig> make_worker_config(std::string name, const LineFields& fields) {
+        return std::make_shared<const WorkerConfig>(
+                std::move(name), TimeDistribution::parse(fields[LineKey::PROCESSING_TIME]),
+                parse_queue_type(fields[LineKey::QUEUE_TYPE]),
+                fields.has(LineKey::SERVERS) ? parse_servers(fields[LineKey::SERVERS]) : 1);
+    }
+
+    void load_line(FactoryBuilder& factory, std::string_view line) {
+        std::size_t begin = 0;
+        while (begin < line.size() && is_blank(line[begin])) ++begin;
+        if (begin == line.size() || line[begin] == ';') return;
+
+        LineFields fields;
+        const ElementType type = scan_line(line.substr(begin), [&fields](std::string_view key, std::string_view value) {
+            fields.set(key, value);
+        });
+        switch (type) {
+            case ElementType::LOADING_RAMP: {
+                const ElementID id = parse_element_id(fields[LineKey::ID]);
+                Ramp ramp = fields.has(LineKey::TRACE)
+                            ? Ramp(id, ArrivalTrace(std::string(fields[LineKey::TRACE])))
+                            : Ramp(id, TimeDistribution::parse(fields[LineKey::DELIVERY_INTERVAL]));
+                if (fields.has(LineKey::ROUTING)) apply_routing_policy(ramp, fields[LineKey::ROUTING]);
+                factory.add_ramp(std::move(ramp));
+                break;
+            }
+            case ElementType::WORKER_TEMPLATE:
+                factory.add_worker_template(make_worker_config(std::string(fields[LineKey::NAME]), fields));
+                break;
+            case ElementType::WORKER: {
+                std::shared_ptr<const WorkerConfig> config;
+                if (fields.has(LineKey::TEMPLATE)) {
+                    reject_template_overrides(fields);
+                    config = factory.find_worker_template(fields[LineKey::TEMPLATE]);
+                    if (!config) {
+                        throw std::invalid_argument("Unknown worker template: " + std::string(fields[LineKey::TEMPLATE]));
+                    }
+                } else {
+                    config = make_worker_config("", fields);
+                }
+                Worker worker(parse_element_id(fields[LineKey::ID]), std::move(config));
+                if (fields.has(LineKey::ROUTING)) apply_routing_policy(worker, fields[LineKey::ROUTING]);
+                factory.add_worker(std::move(worker));
+                break;
+            }
+            case ElementType::STOREHOUSE:
+                factory.add_storehouse(Storehouse(parse_element_id(fields[LineKey::ID])));
+                break;
+            case ElementType::LINK:
+                factory.add_link(parse_link_end(fields[LineKey::SRC]), parse_link_end(fields[LineKey::DEST]));
+                break;
+        }
+    }
+
+    constexpr std::size_t LOAD_CHUNK = 1 << 20;
+
+    void save_worker_config(const WorkerConfig& config, std::ostream& os) {
+        os << " processing-time=" << config.processing_time.to_string() << " queue-type="
+           << queue_type_name(config.queue_type);
+        if (config.servers != 1) os << " servers=" << config.servers;
+    }
+}
+
+std::string routing_suffix(const PackageSender& sender) {
+    RoutingPolicyType policy = sender.receiver_preferences_.get_routing_policy();
+    return (policy == RoutingPolicyType::WEIGHTED_RANDOM) ? "" : " routing=" + to_string(policy);
+}
+
+
+void save_factory_structure(const Factory& factory, std::ostream& os) {
     std::vector<int> id_ramps;
     for (auto it = factory.ramp_cbegin(); it != factory.ramp_cend(); it++) {
         id_ramps.push_back(it->get_id());
@@ -104,8 +711,10 @@ void save_factory_structure(Factory& factory, std::ostream& os) {
     os << "; == LOADING RAMPS ==" << std::endl << std::endl;
     for (const auto ID : id_ramps) {
         auto iter = factory.find_ramp_by_id(ID);
-        os << "LOADING_RAMP id=" << iter->get_id() << " delivery-interval=" << iter->get_delivery_interval()
-           << std::endl;
+        os << "LOADING_RAMP id=" << iter->get_id();
+        if (iter->get_trace()) os << " trace=" << iter->get_trace()->path();
+        else os << " delivery-interval=" << iter->get_delivery_distribution().to_string();
+        os << routing_suffix(*iter) << std::endl;
         os << std::endl;
     }
 
@@ -115,20 +724,24 @@ void save_factory_structure(Factory& factory, std::ostream& os) {
     }
     std::sort(worker_vec.begin(), worker_vec.end());
 
+    if (!factory.get_worker_templates().empty()) {
+        os << "; == WORKER TEMPLATES ==" << std::endl << std::endl;
+        for (const auto& worker_template: factory.get_worker_templates()) {
+            os << "WORKER_TEMPLATE name=" << worker_template.first;
+            save_worker_config(*worker_template.second, os);
+            os << std::endl;
+        }
+        os << std::endl;
+    }
+
     os << "; == WORKERS ==" << std::endl << std::endl;
     for (const auto ID : worker_vec) {
         auto iter = factory.find_worker_by_id(ID);
-        os << "WORKER id=" << iter->get_id() << " processing-time=" << iter->get_processing_duration()
-           << " queue-type=";
-
-        switch (iter->get_queue_type()) {
-            case PackageQueueType::FIFO:
-                os << "FIFO" << std::endl;
-                break;
-            case PackageQueueType::LIFO:
-                os << "LIFO" << std::endl;
-                break;
-        }
+        const auto& config = iter->get_config();
+        os << "WORKER id=" << iter->get_id();
+        if (factory.find_worker_template(config->name) == config) os << " template=" << config->name;
+        else save_worker_config(*config, os);
+        os << routing_suffix(*iter) << std::endl;
     }
 
     std::vector<int> id_store;
@@ -191,113 +804,39 @@ void save_factory_structure(Factory& factory, std::ostream& os) {
 
 
 Factory load_factory_structure(std::istream& is) {
-    ParsedLineData parsed_line;
-    Factory factory;
-    std::string l;
-    std::string id = "id";
-
-    while (std::getline(is, l)) {
-        if (l.empty() or (l.front() == ';')) {
-            continue;
-        }
-        parsed_line = parse(l);
-        if (parsed_line.element_type == ElementType::LOADING_RAMP) {
-            Ramp ramp(std::stoi(parsed_line.parameters[id]), std::stoi(parsed_line.parameters["delivery-interval"]));
-            factory.add_ramp(std::move(ramp));
-        }
-        if (parsed_line.element_type == ElementType::WORKER) {
-            PackageQueueType type;
-            if (parsed_line.parameters["queue-type"] == "FIFO") type = PackageQueueType::FIFO;
-            if (parsed_line.parameters["queue-type"] == "LIFO") type = PackageQueueType::LIFO;
-            Worker worker(std::stoi(parsed_line.parameters[id]), std::stoi(parsed_line.parameters["processing-time"]),
-                          std::make_unique<PackageQueue>(type));
-            factory.add_worker(std::move(worker));
+    // Połączenia rozwiązywane są hurtowo na końcu - czas wczytywania liniowy względem rozmiaru pliku.
+    FactoryBuilder factory;
+    // Plik czytany jest blokami; wiersze przetwarzane są jako widoki na bufor,
+    // a niedokończony wiersz przenoszony jest na początek kolejnego bloku.
+    std::string buffer(LOAD_CHUNK, '\0');
+    std::size_t filled = 0;
+    for (;;) {
+        is.read(buffer.data() + filled, static_cast<std::streamsize>(buffer.size() - filled));
+        filled += static_cast<std::size_t>(is.gcount());
+        const bool done = !is;
+
+        const std::string_view data(buffer.data(), filled);
+        std::size_t consumed = 0;
+        for (std::size_t end = data.find('\n'); end != std::string_view::npos; end = data.find('\n', consumed)) {
+            load_line(factory, data.substr(consumed, end - consumed));
+            consumed = end + 1;
         }
-        if (parsed_line.element_type == ElementType::STOREHOUSE) {
-            Storehouse storehouse(std::stoi(parsed_line.parameters[id]));
-            factory.add_storehouse(std::move(storehouse));
-        }
-        if (parsed_line.element_type == ElementType::LINK) {
-
-       
-            std::vector<std::string> src;
-            std::vector<std::string> dest;
-            char delimeter = '-';
-
-            tokenize(parsed_line.parameters["src"], src, delimeter);
-            tokenize(parsed_line.parameters["dest"], dest, delimeter);
-
-            if (src[0] == "ramp") {
-                if (dest[0] == "worker") {
-                    auto const ramp_iter = factory.find_ramp_by_id(std::stoi(src[1]));
-                    auto const worker_iter = factory.find_worker_by_id(std::stoi(dest[1]));
-                    ramp_iter->receiver_preferences_.add_receiver(&*worker_iter);
-                }
-                if (dest[0] == "store") {
-                    auto const ramp_iter = factory.find_ramp_by_id(std::stoi(src[1]));
-                    auto const store_iter = factory.find_storehouse_by_id(std::stoi(dest[1]));
-                    ramp_iter->receiver_preferences_.add_receiver(&*store_iter);
-                }
-            }
-            if (src[0] == "worker") {
-                if (dest[0] == "worker") {
-                    auto const worker_src_iter = factory.find_worker_by_id(std::stoi(src[1]));
-                    auto const worker_dst_iter = factory.find_worker_by_id(std::stoi(dest[1]));
-                    worker_src_iter->receiver_preferences_.add_receiver(&*worker_dst_iter);
-                }
-                if (dest[0] == "store") {
-                    auto const worker_src_iter = factory.find_worker_by_id(std::stoi(src[1]));
-                    auto const store_iter = factory.find_storehouse_by_id(std::stoi(dest[1]));
-                    worker_src_iter->receiver_preferences_.add_receiver(&*store_iter);
-                }
-            }
+        if (done) {
+            if (consumed < filled) load_line(factory, data.substr(consumed));
+            break;
         }
+        buffer.erase(0, consumed);
+        filled -= consumed;
+        // Wiersz dłuższy niż bufor.
+        buffer.resize(std::max(LOAD_CHUNK, 2 * filled));
     }
-    return factory;
+    return factory.build();
 }
 
-
 ParsedLineData parse(const std::string& l) {
     ParsedLineData parsed_line;
-
-    int marker = 0;
-    std::vector<std::string> token_vec;
-    char delimiter = ' ';
-    std::stringstream ss(l);
-    std::string tok;
-
-    while (std::getline(ss, tok, delimiter)) {
-        if (marker == 0) {
-            if (tok == "LOADING_RAMP") {
-                parsed_line.element_type = ElementType::LOADING_RAMP;
-                marker += 1;
-                continue;
-            }
-            if (tok == "WORKER") {
-                parsed_line.element_type = ElementType::WORKER;
-                marker += 1;
-                continue;
-            }
-            if (tok == "STOREHOUSE") {
-                parsed_line.element_type = ElementType::STOREHOUSE;
-                marker += 1;
-                continue;
-            }
-            if (tok == "LINK") {
-                parsed_line.element_type = ElementType::LINK;
-                marker += 1;
-                continue;
-            }
-        }
-        token_vec.push_back(tok);
-    }
-
-
-    for (auto& elem : token_vec) {
-        delimiter = '=';
-        std::vector<std::string> pair;
-        tokenize(elem, pair, delimiter);
-        parsed_line.parameters[pair[0]] = pair[1];
-    }
+    parsed_line.element_type = scan_line(l, [&parsed_line](std::string_view key, std::string_view value) {
+        parsed_line.parameters[std::string(key)] = std::string(value);
+    });
     return parsed_line;
 }
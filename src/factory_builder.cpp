@@ -0,0 +1,135 @@
+#include "factory_builder.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace {
+    std::string describe(NodeRef node) {
+        switch (node.element_type) {
+            case ElementType::LOADING_RAMP:
+                return "ramp-" + std::to_string(node.id);
+            case ElementType::WORKER:
+                return "worker-" + std::to_string(node.id);
+            case ElementType::STOREHOUSE:
+                return "store-" + std::to_string(node.id);
+            case ElementType::WORKER_TEMPLATE:
+            case ElementType::LINK:
+                break;
+        }
+        return "element-" + std::to_string(node.id);
+    }
+}
+
+FactoryBuilder::FactoryBuilder() { factory_.consistency_.reset(); }
+
+void FactoryBuilder::reserve(std::size_t ramps, std::size_t workers, std::size_t storehouses, std::size_t links) {
+    factory_.reserve(ramps, workers, storehouses);
+    links_.reserve(links_.size() + links);
+}
+
+void FactoryBuilder::add_ramp(Ramp&& ramp) {
+    ramp.set_package_registry(*factory_.packages_);
+    factory_.ramps_.add(std::move(ramp));
+}
+
+void FactoryBuilder::add_worker(Worker&& worker) { factory_.workers_.add(std::move(worker)); }
+
+void FactoryBuilder::add_storehouse(Storehouse&& storehouse) { factory_.storehouses_.add(std::move(storehouse)); }
+
+void FactoryBuilder::add_worker_template(std::shared_ptr<const WorkerConfig> config) {
+    factory_.add_worker_template(std::move(config));
+}
+
+void FactoryBuilder::add_ramps(std::vector<Ramp>&& ramps) {
+    factory_.ramps_.reserve(ramps.size());
+    for (auto& ramp: ramps) add_ramp(std::move(ramp));
+    ramps.clear();
+}
+
+void FactoryBuilder::add_workers(std::vector<Worker>&& workers) {
+    factory_.workers_.reserve(workers.size());
+    for (auto& worker: workers) add_worker(std::move(worker));
+    workers.clear();
+}
+
+void FactoryBuilder::add_storehouses(std::vector<Storehouse>&& storehouses) {
+    factory_.storehouses_.reserve(storehouses.size());
+    for (auto& storehouse: storehouses) add_storehouse(std::move(storehouse));
+    storehouses.clear();
+}
+
+void FactoryBuilder::add_links(const std::vector<LinkSpec>& links) {
+    links_.insert(links_.end(), links.begin(), links.end());
+}
+
+// Nadawcy numerowani są gniazdami kolekcji: najpierw rampy, po nich robotnicy.
+ReceiverPreferences* FactoryBuilder::find_sender(NodeRef sender, std::size_t& index) {
+    if (sender.element_type == ElementType::LOADING_RAMP) {
+        if (auto handle = factory_.ramps_.find_handle(sender.id)) {
+            index = handle->slot;
+            return &factory_.ramps_.get(*handle)->receiver_preferences_;
+        }
+    } else if (sender.element_type == ElementType::WORKER) {
+        if (auto handle = factory_.workers_.find_handle(sender.id)) {
+            index = factory_.ramps_.slot_count() + handle->slot;
+            return &factory_.workers_.get(*handle)->receiver_preferences_;
+        }
+    }
+    return nullptr;
+}
+
+IPackageReceiver* FactoryBuilder::find_receiver(NodeRef receiver) {
+    if (receiver.element_type == ElementType::WORKER) {
+        auto it = factory_.workers_.find_by_id(receiver.id);
+        if (it != factory_.workers_.end()) return &*it;
+    } else if (receiver.element_type == ElementType::STOREHOUSE) {
+        auto it = factory_.storehouses_.find_by_id(receiver.id);
+        if (it != factory_.storehouses_.end()) return &*it;
+    }
+    return nullptr;
+}
+
+Factory FactoryBuilder::build() {
+    struct Resolved {
+        std::size_t sender;
+        ReceiverPreferences* preferences;
+        IPackageReceiver* receiver;
+    };
+
+    // Rozwiązanie identyfikatorów i sortowanie przez zliczanie względem nadawcy - O(V + E).
+    const std::size_t senders = factory_.ramps_.slot_count() + factory_.workers_.slot_count();
+    std::vector<Resolved> resolved;
+    resolved.reserve(links_.size());
+    std::vector<std::size_t> offset(senders + 1, 0);
+    for (const LinkSpec& link: links_) {
+        Resolved r{};
+        r.preferences = find_sender(link.sender, r.sender);
+        if (!r.preferences) throw std::invalid_argument("Unknown link sender: " + describe(link.sender));
+        r.receiver = find_receiver(link.receiver);
+        if (!r.receiver) throw std::invalid_argument("Unknown link receiver: " + describe(link.receiver));
+        ++offset[r.sender + 1];
+        resolved.push_back(r);
+    }
+    for (std::size_t i = 0; i < senders; ++i) offset[i + 1] += offset[i];
+
+    std::vector<const Resolved*> grouped(resolved.size());
+    std::vector<std::size_t> fill(offset.begin(), offset.end() - 1);
+    for (const Resolved& r: resolved) grouped[fill[r.sender]++] = &r;
+
+    std::vector<IPackageReceiver*> receivers;
+    for (std::size_t sender = 0; sender < senders; ++sender) {
+        if (offset[sender] == offset[sender + 1]) continue;
+        // Odbiorcy ustawieni przed dodaniem węzła do buildera zachowują swoje (przeskalowane) wagi.
+        receivers.clear();
+        for (std::size_t i = offset[sender]; i < offset[sender + 1]; ++i) receivers.push_back(grouped[i]->receiver);
+        grouped[offset[sender]]->preferences->add_receivers(receivers);
+    }
+
+    Factory factory = std::move(factory_);
+    factory.rebuild_consistency();
+    factory_ = Factory();
+    factory_.consistency_.reset();
+    links_.clear();
+    return factory;
+}
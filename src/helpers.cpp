@@ -3,15 +3,30 @@
 #include <cstdlib>
 #include <random>
 
-// Do generowania wysokiej jakości ciągów liczb pseudolosowych warto użyć
-// zaawansowanych generatorów, np. algorytmu Mersenne Twister.
-// zob. https://en.cppreference.com/w/cpp/numeric/random
+// Xoshiro256++ ma 32 bajty stanu i jest znacznie szybszy od Mersenne Twistera,
+// a przy tym przechodzi standardowe testy statystyczne (BigCrush, PractRand).
+// zob. https://prng.di.unimi.it/
 std::random_device rd;
-std::mt19937 rng(rd());
+Xoshiro256pp rng((static_cast<std::uint64_t>(rd()) << 32) | rd());
 
 double default_probability_generator() {
-    // Generuj liczby pseudolosowe z przedziału [0, 1); 10 bitów losowości.
-    return std::generate_canonical<double, 10>(rng);
+    // Generuj liczby pseudolosowe z przedziału [0, 1); 53 bity losowości.
+    return rng.canonical();
 }
 
-std::function<double()> probability_generator = default_probability_generator;
+ProbabilityGenerator probability_generator;
+
+namespace {
+    std::uint64_t master_seed = (static_cast<std::uint64_t>(rd()) << 32) | rd();
+}
+
+void set_master_seed(std::uint64_t seed) {
+    master_seed = seed;
+    rng.seed(seed);
+}
+
+std::uint64_t get_master_seed() { return master_seed; }
+
+RandomStream node_stream(StreamKind kind, ElementID id, std::uint64_t seed) {
+    return RandomStream(seed, (static_cast<std::uint64_t>(kind) << 32) | id);
+}
@@ -1,6 +1,127 @@
 #include "nodes.hpp"
 
+#include <typeinfo>
+
+IPackageReceiver::IPackageReceiver(IPackageReceiver&& other) noexcept
+        : load_(other.load_), kind_(other.kind_), index_(std::exchange(other.index_, NO_INDEX)),
+          directory_(std::exchange(other.directory_, nullptr)), senders_(std::move(other.senders_)),
+          sequence_(other.sequence_) {
+    other.senders_.clear();
+    for (ReceiverPreferences* sender: senders_) sender->rekey_receiver(&other, this);
+}
+
+IPackageReceiver::~IPackageReceiver() {
+    while (!senders_.empty()) senders_.back()->remove_receiver(this);
+    if (directory_) directory_->release(kind_, index_, this);
+}
+
+void IPackageReceiver::attach(ReceiverDirectory* directory, std::uint32_t index) {
+    index_ = index;
+    directory_ = directory;
+    if (directory_) directory_->set(kind_, index_, this);
+    for (ReceiverPreferences* sender: senders_) sender->stale_ = true;
+}
+
+ReceiverPreferences::ReceiverPreferences(const ReceiverPreferences& other)
+        : preferences(other.preferences), probability_gen_(other.probability_gen_), policy_(other.policy_) {
+    link_receivers();
+    rebuild_table();
+    table_.cursor = other.table_.cursor;
+}
+
+ReceiverPreferences::ReceiverPreferences(ReceiverPreferences&& other) noexcept
+        : preferences(std::move(other.preferences)), probability_gen_(std::move(other.probability_gen_)),
+          policy_(other.policy_), table_(std::move(other.table_)), external_(std::move(other.external_)),
+          directory_(other.directory_), stale_(other.stale_) {
+    adopt_links(other);
+    if (other.observer_) other.observer_->on_links_replaced(other);
+}
+
+ReceiverPreferences& ReceiverPreferences::operator=(const ReceiverPreferences& other) {
+    if (this == &other) return *this;
+    unlink_receivers();
+    preferences = other.preferences;
+    probability_gen_ = other.probability_gen_;
+    policy_ = other.policy_;
+    link_receivers();
+    rebuild_table();
+    table_.cursor = other.table_.cursor;
+    if (observer_) observer_->on_links_replaced(*this);
+    return *this;
+}
+
+ReceiverPreferences& ReceiverPreferences::operator=(ReceiverPreferences&& other) noexcept {
+    if (this == &other) return *this;
+    unlink_receivers();
+    preferences = std::move(other.preferences);
+    probability_gen_ = std::move(other.probability_gen_);
+    policy_ = other.policy_;
+    table_ = std::move(other.table_);
+    external_ = std::move(other.external_);
+    stale_ = other.stale_ || directory_ != other.directory_;
+    adopt_links(other);
+    if (observer_) observer_->on_links_replaced(*this);
+    if (other.observer_) other.observer_->on_links_replaced(other);
+    return *this;
+}
+
+ReceiverPreferences::~ReceiverPreferences() { unlink_receivers(); }
+
+void ReceiverPreferences::link_receivers() {
+    for (auto& elem: preferences) link(elem.first);
+}
+
+void ReceiverPreferences::unlink_receivers() {
+    for (auto& elem: preferences) unlink(elem.first);
+}
+
+void ReceiverPreferences::link(IPackageReceiver* r) {
+    sender_slot_[r] = r->senders_.size();
+    r->senders_.push_back(this);
+}
+
+void ReceiverPreferences::unlink(IPackageReceiver* r) {
+    auto it = sender_slot_.find(r);
+    const std::size_t slot = it->second;
+    sender_slot_.erase(it);
+
+    auto& senders = r->senders_;
+    ReceiverPreferences* last = senders.back();
+    senders.pop_back();
+    if (slot < senders.size()) {
+        senders[slot] = last;
+        last->sender_slot_[r] = slot;
+    }
+}
+
+void ReceiverPreferences::adopt_links(ReceiverPreferences& other) {
+    other.preferences.clear();
+    other.table_ = {};
+    other.external_.clear();
+    other.stale_ = false;
+    sender_slot_ = std::move(other.sender_slot_);
+    other.sender_slot_.clear();
+    for (const auto& elem: sender_slot_) elem.first->senders_[elem.second] = this;
+}
+
+void ReceiverPreferences::rekey_receiver(IPackageReceiver* from, IPackageReceiver* to) {
+    auto node = preferences.extract(from);
+    node.key() = to;
+    preferences.insert(std::move(node));
+    auto slot = sender_slot_.extract(from);
+    slot.key() = to;
+    sender_slot_.insert(std::move(slot));
+    stale_ = true;
+}
+
+void ReceiverPreferences::resort_receivers() {
+    preferences_t sorted(preferences.begin(), preferences.end());
+    preferences.swap(sorted);
+    rebuild_table();
+}
+
 void ReceiverPreferences::add_receiver(IPackageReceiver* r) {
+    if (preferences.count(r)) return;
     double size = preferences.size();
     double probability = size / (size + 1);
 
@@ -11,64 +132,210 @@ void ReceiverPreferences::add_receiver(IPackageReceiver* r) {
         }
         preferences.emplace(r, 1 / (size + 1));
     }
+    link(r);
+    rebuild_table();
+    if (observer_) observer_->on_link_added(*this, r);
+}
+
+void ReceiverPreferences::add_receivers(std::vector<IPackageReceiver*> receivers) {
+    std::sort(receivers.begin(), receivers.end(), ReceiverOrder());
+    receivers.erase(std::unique(receivers.begin(), receivers.end()), receivers.end());
+    receivers.erase(std::remove_if(receivers.begin(), receivers.end(),
+                                   [this](IPackageReceiver* r) { return preferences.count(r) != 0; }),
+                    receivers.end());
+    if (receivers.empty()) return;
+
+    const double size = preferences.size();
+    const double total = size + static_cast<double>(receivers.size());
+    for (auto& elem: preferences) elem.second *= size / total;
+    for (IPackageReceiver* r: receivers) {
+        preferences.emplace(r, 1 / total);
+        link(r);
+    }
+    rebuild_table();
+    if (observer_) {
+        for (IPackageReceiver* r: receivers) observer_->on_link_added(*this, r);
+    }
 }
 
 IPackageReceiver* ReceiverPreferences::choose_receiver() {
-    double probability = probability_gen_();
-    double sum = 0;
+    if (stale_) rebuild_table();
+    if (table_.receivers.empty()) return nullptr;
 
+    switch (policy_) {
+        case RoutingPolicyType::WEIGHTED_RANDOM:
+            return route<WeightedRandomPolicy>();
+        case RoutingPolicyType::ROUND_ROBIN:
+            return route<RoundRobinPolicy>();
+        case RoutingPolicyType::JOIN_SHORTEST_QUEUE:
+            return route<JoinShortestQueuePolicy>();
+        case RoutingPolicyType::POWER_OF_TWO_CHOICES:
+            return route<PowerOfTwoChoicesPolicy>();
+    }
+    return nullptr;
+}
+
+void ReceiverPreferences::rebuild_table() {
+    table_.receivers.clear();
+    table_.cumulative.clear();
+    external_.clear();
+    double sum = 0;
     for (const auto& elem: preferences) {
-        sum += elem.second;
-        if (sum >= probability) {
-            return elem.first;
+        IPackageReceiver* r = elem.first;
+        ReceiverHandle handle;
+        if (directory_ && r->directory_ == directory_ && r->index_ <= HANDLE_INDEX_MASK) {
+            handle = (static_cast<ReceiverHandle>(r->kind_) << HANDLE_KIND_SHIFT) | r->index_;
+        } else {
+            handle = (EXTERNAL_HANDLE << HANDLE_KIND_SHIFT) | static_cast<ReceiverHandle>(external_.size());
+            external_.push_back(r);
         }
+        sum += elem.second;
+        table_.receivers.push_back(handle);
+        table_.cumulative.push_back(sum);
     }
-    return nullptr;
+    stale_ = false;
 }
 
 void ReceiverPreferences::remove_receiver(IPackageReceiver* r) {
-    preferences.erase(r);
+    if (!preferences.erase(r)) return;
+    unlink(r);
     double size = preferences.size();
     double probability = (size + 1) / size;
 
     for (auto& elem: preferences) {
         elem.second *= probability;
     }
+    rebuild_table();
+    if (observer_) observer_->on_link_removed(*this, r);
 }
 
-void PackageSender::send_package() {
-    if (sending_buffer) receiver_preferences_.choose_receiver()->receive_package(std::move(sending_buffer.value()));
+IPackageReceiver* PackageSender::send_package() {
+    if (!sending_buffer) return nullptr;
+
+    IPackageReceiver* receiver = receiver_preferences_.choose_receiver();
+    deliver_package(receiver, std::move(sending_buffer.value()));
     sending_buffer = std::nullopt;
+    return receiver;
+}
+
+bool advance_delivery(Time t, Time& next_delivery, TimeOffset di, const TimeDistribution& delivery_interval,
+                      UniformBuffer& delivery_rng, std::optional<ArrivalTrace>& trace) {
+    if (t < next_delivery) return false;
+
+    if (trace) {
+        auto next = trace->next();
+        next_delivery = next ? std::max<Time>(*next, t + 1) : TIME_NEVER;
+    } else if (delivery_interval.is_fixed()) {
+        if (t != next_delivery) {
+            next_delivery += di * ((t - next_delivery + di - 1) / di);
+            if (t != next_delivery) return false;
+        }
+        next_delivery = t + di;
+    } else {
+        next_delivery = t + delivery_interval.sample(delivery_rng);
+    }
+    return true;
+}
+
+namespace {
+    std::optional<Package> clone_package(const std::optional<Package>& package, PackageRegistry& registry) {
+        if (!package) return std::nullopt;
+        return Package(*package, registry);
+    }
+
+    // Pusty magazyn tego samego rodzaju. Odtworzyć da się tylko `PackageQueue` - innego
+    // składowiska nie da się skopiować bez utraty jego zachowania.
+    std::unique_ptr<IPackageStockpile> empty_stockpile_like(const IPackageStockpile& stockpile) {
+        if (typeid(stockpile) != typeid(PackageQueue)) {
+            throw std::logic_error("Cannot clone a storehouse with a custom stockpile!");
+        }
+        return std::make_unique<PackageQueue>(static_cast<const PackageQueue&>(stockpile).get_queue_type());
+    }
+
+    template<typename Stockpile>
+    void clone_packages(const IPackageStockpile& from, Stockpile& to, PackageRegistry& registry) {
+        for (const auto& package: from) to.push(Package(package, registry));
+    }
+}
+
+Ramp::Ramp(const Ramp& other, PackageRegistry& registry)
+        : id_(other.id_), di_(other.di_), delivery_interval_(other.delivery_interval_),
+          delivery_rng_(other.delivery_rng_), trace_(other.trace_), next_delivery_(other.next_delivery_),
+          packages_(&registry) {
+    sending_buffer = clone_package(other.sending_buffer, registry);
 }
 
 void Ramp::deliver_goods(Time t) {
-    if (di_ == 1) {
-        Package package = Package();
-        push_package(std::move(package));
+    if (t >= next_delivery_ && advance_delivery(t, next_delivery_, di_, delivery_interval_, delivery_rng_, trace_)) {
+        push_package(Package(*packages_));
+    }
+}
+
+Worker::Worker(const Worker& other, PackageRegistry& registry)
+        : IPackageReceiver(ReceiverKind::WORKER), id_(other.id_), config_(other.config_),
+          processing_rng_(other.processing_rng_), queue_(std::make_unique<PackageQueue>(other.get_queue_type())),
+          slots_(other.slots_.size()) {
+    clone_packages(*other.queue_, *this, registry);
+    for (std::size_t i = 0; i < slots_.size(); ++i) {
+        slots_[i].package = clone_package(other.slots_[i].package, registry);
+        slots_[i].start_time = other.slots_[i].start_time;
+        slots_[i].duration = other.slots_[i].duration;
+        slots_[i].finished = other.slots_[i].finished;
     }
-    if (t % di_ == 1) {
-        Package package = Package();
-        push_package(std::move(package));
+    sending_buffer = clone_package(other.sending_buffer, registry);
+}
+
+void Worker::set_config(std::shared_ptr<const WorkerConfig> config) {
+    if (config->servers != slots_.size()) {
+        throw std::invalid_argument("The number of servers of a worker cannot change!");
     }
+    config_ = std::move(config);
+}
 
+Storehouse::Storehouse(const Storehouse& other, PackageRegistry& registry)
+        : IPackageReceiver(ReceiverKind::STOREHOUSE), id_(other.id_),
+          d_(empty_stockpile_like(*other.d_)) {
+    clone_packages(*other.d_, *d_, registry);
 }
 
 void Worker::do_work(Time t) {
-    if (pd_ == 1) {
-        if (!queue_->empty()) {
-            push_package(queue_->pop());
-            start_time_ = t;
+    for (auto& slot: slots_) {
+        if (!slot.package.has_value() and !queue_->empty()) {
+            slot.package.emplace(Worker::pop());
+            slot.start_time = t;
+            slot.duration = config_->processing_time.sample(processing_rng_);
         }
-    } else {
-        if (!worker_buffer_.has_value()) {
-            if (!queue_->empty()) {
-                worker_buffer_.emplace(queue_->pop());
-                start_time_ = t;
-            }
+        if (slot.package.has_value() and t - slot.start_time == slot.duration - 1) {
+            slot.finished = true;
         }
-        if (t - start_time_ == pd_ - 1) {
-            push_package(std::move(worker_buffer_.value()));
-            worker_buffer_ = std::nullopt;
+    }
+    release_finished();
+}
+
+Time Worker::get_next_event_time(Time now) const {
+    if (sending_buffer) return now;
+
+    Time next = TIME_NEVER;
+    for (const auto& slot: slots_) {
+        if (slot.finished) return now;
+        if (!slot.package.has_value()) {
+            if (!queue_->empty()) return now;
+            continue;
         }
+        next = std::min(next, std::max<Time>(slot.start_time + slot.duration - 1, now));
     }
-}
\ No newline at end of file
+    return next;
+}
+
+bool Worker::release_finished() {
+    if (sending_buffer) return false;
+    for (auto& slot: slots_) {
+        if (slot.finished) {
+            push_package(std::move(slot.package.value()));
+            slot.package = std::nullopt;
+            slot.finished = false;
+            return true;
+        }
+    }
+    return false;
+}
@@ -1,58 +1,88 @@
 #include "package.hpp"
 
+#include <stdexcept>
 
-std::set<ElementID> Package::assigned_IDs;
-std::set<ElementID> Package::freed_IDs;
 
+PackageRegistry& PackageRegistry::global() {
+    static PackageRegistry registry;
+    return registry;
+}
+
+PackageRegistry::State& PackageRegistry::mutable_state() {
+    if (state_.use_count() > 1) state_ = std::make_shared<State>(*state_);
+    return *state_;
+}
 
-Package::Package() {
-    if (freed_IDs.empty() and assigned_IDs.empty()) {
+ElementID PackageRegistry::acquire() {
+    State& state = mutable_state();
+    ElementID ID;
+    if (state.freed_IDs.empty() and state.assigned_IDs.empty()) {
         ID = 1;
-        assigned_IDs.emplace(ID);
-    } else if (freed_IDs.empty() and !assigned_IDs.empty()) {
-        ID = *assigned_IDs.rbegin() + 1;
-        assigned_IDs.emplace(ID);
+    } else if (state.freed_IDs.empty() and !state.assigned_IDs.empty()) {
+        ID = *state.assigned_IDs.rbegin() + 1;
     } else {
-        ID = *freed_IDs.begin();
-        freed_IDs.erase(ID);
-        assigned_IDs.emplace(ID);
+        ID = *state.freed_IDs.begin();
+        state.freed_IDs.erase(state.freed_IDs.begin());
     }
+    state.assigned_IDs.emplace(ID);
+    return ID;
+}
+
+ElementID PackageRegistry::acquire(ElementID preferred) {
+    if (is_assigned(preferred)) return acquire();
+    State& state = mutable_state();
+    state.freed_IDs.erase(preferred);
+    state.assigned_IDs.emplace(preferred);
+    return preferred;
+}
+
+void PackageRegistry::release(ElementID id) {
+    State& state = mutable_state();
+    state.assigned_IDs.erase(id);
+    state.freed_IDs.insert(id);
+}
+
+void PackageRegistry::restore(const std::vector<ElementID>& assigned, const std::vector<ElementID>& freed) {
+    auto state = std::make_shared<State>();
+    for (ElementID id: assigned) state->assigned_IDs.insert(state->assigned_IDs.end(), id);
+    for (ElementID id: freed) state->freed_IDs.insert(state->freed_IDs.end(), id);
+    state_ = std::move(state);
+}
+
+
+Package::Package() : Package(PackageRegistry::global()) {}
+
+Package::Package(ElementID elementId) : ID(PackageRegistry::global().acquire(elementId)),
+                                        registry_(&PackageRegistry::global()) {
     make_relevant();
 }
 
-Package::Package(ElementID elementId) {
-    if (assigned_IDs.find(elementId) != assigned_IDs.end()) {
-        Package();
-    } else {
-        ID = elementId;
-        freed_IDs.erase(ID);
-        assigned_IDs.emplace(ID);
-    }
+Package::Package(PackageRegistry& registry) : ID(registry.acquire()), registry_(&registry) {
+    make_relevant();
+}
+
+Package::Package(ElementID id, PackageRegistry& registry) : ID(id), registry_(&registry) {
+    if (!registry.is_assigned(ID)) throw std::logic_error("The package is not registered in the target registry!");
     make_relevant();
 }
 
 Package::~Package() {
-    if (relevance) {
-        ElementID ID_ = this->ID;
-        assigned_IDs.erase(ID_);
-        freed_IDs.insert(ID_);
-    }
+    if (relevance) registry_->release(ID);
 }
 
 Package::Package(Package&& aPackage) noexcept {
     ID = aPackage.ID;
+    registry_ = aPackage.registry_;
     aPackage.make_irrelevant();
     this->make_relevant();
 }
 
 Package& Package::operator=(Package&& aPackage) noexcept {
-    if (relevance) {
-        assigned_IDs.erase(ID);
-        if (ID < *assigned_IDs.rend())
-            freed_IDs.insert(ID);
-    }
+    if (this == &aPackage) return *this;
+    if (relevance) registry_->release(ID);
     ID = aPackage.ID;
+    registry_ = aPackage.registry_;
     aPackage.make_irrelevant();
     this->make_relevant();
     return *this;
-}
\ No newline at end of file
+}
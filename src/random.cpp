@@ -0,0 +1,108 @@
+#include "random.hpp"
+
+#include <algorithm>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define NETSIM_HAS_AVX2_KERNEL
+#include <immintrin.h>
+#endif
+
+namespace {
+    constexpr std::size_t LANES = 8;
+
+    void store_uniforms(const std::uint32_t words[4][LANES], double* out, std::size_t blocks) {
+        for (std::size_t b = 0; b < blocks; ++b) {
+            out[2 * b] = to_unit_double((static_cast<std::uint64_t>(words[1][b]) << 32) | words[0][b]);
+            out[2 * b + 1] = to_unit_double((static_cast<std::uint64_t>(words[3][b]) << 32) | words[2][b]);
+        }
+    }
+
+    void scalar_blocks(const RandomStream& stream, std::uint64_t block, double* out, std::size_t blocks) {
+        std::uint32_t words[4][LANES];
+        for (std::size_t b = 0; b < blocks; ++b) {
+            std::uint32_t ctr[4] = {static_cast<std::uint32_t>(block + b), static_cast<std::uint32_t>((block + b) >> 32),
+                                    0, 0};
+            philox4x32_10(ctr, stream.key0(), stream.key1());
+            for (std::size_t w = 0; w < 4; ++w) words[w][b] = ctr[w];
+        }
+        store_uniforms(words, out, blocks);
+    }
+
+#ifdef NETSIM_HAS_AVX2_KERNEL
+    __attribute__((target("avx2")))
+    inline void mulhilo_avx2(__m256i a, __m256i m, __m256i& hi, __m256i& lo) {
+        const __m256i even = _mm256_mul_epu32(a, m);
+        const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+        lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+        hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+    }
+
+    // Osiem bloków Philoxa naraz: słowa licznika w układzie SoA, po jednym bloku na linię.
+    __attribute__((target("avx2")))
+    void avx2_blocks(const RandomStream& stream, std::uint64_t block, double* out) {
+        alignas(32) std::uint32_t lo_words[LANES];
+        alignas(32) std::uint32_t hi_words[LANES];
+        for (std::size_t b = 0; b < LANES; ++b) {
+            lo_words[b] = static_cast<std::uint32_t>(block + b);
+            hi_words[b] = static_cast<std::uint32_t>((block + b) >> 32);
+        }
+        __m256i c0 = _mm256_load_si256(reinterpret_cast<const __m256i*>(lo_words));
+        __m256i c1 = _mm256_load_si256(reinterpret_cast<const __m256i*>(hi_words));
+        __m256i c2 = _mm256_setzero_si256();
+        __m256i c3 = _mm256_setzero_si256();
+
+        const __m256i m0 = _mm256_set1_epi32(static_cast<int>(0xD2511F53U));
+        const __m256i m1 = _mm256_set1_epi32(static_cast<int>(0xCD9E8D57U));
+        std::uint32_t k0 = stream.key0();
+        std::uint32_t k1 = stream.key1();
+        for (int round = 0; round < 10; ++round) {
+            __m256i hi0, lo0, hi1, lo1;
+            mulhilo_avx2(c0, m0, hi0, lo0);
+            mulhilo_avx2(c2, m1, hi1, lo1);
+            c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), _mm256_set1_epi32(static_cast<int>(k0)));
+            c1 = lo1;
+            c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), _mm256_set1_epi32(static_cast<int>(k1)));
+            c3 = lo0;
+            k0 += 0x9E3779B9U;
+            k1 += 0xBB67AE85U;
+        }
+
+        alignas(32) std::uint32_t words[4][LANES];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(words[0]), c0);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(words[1]), c1);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(words[2]), c2);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(words[3]), c3);
+        store_uniforms(words, out, LANES);
+    }
+
+    const bool has_avx2 = __builtin_cpu_supports("avx2");
+#else
+    const bool has_avx2 = false;
+#endif
+}
+
+void generate_uniform_batch_scalar(const RandomStream& stream, std::uint64_t first, double* out, std::size_t count) {
+    const std::uint64_t block = first / 2;
+    const std::size_t blocks = count / 2;
+    for (std::size_t b = 0; b < blocks; b += LANES) {
+        scalar_blocks(stream, block + b, out + 2 * b, std::min(LANES, blocks - b));
+    }
+}
+
+void generate_uniform_batch(const RandomStream& stream, std::uint64_t first, double* out, std::size_t count) {
+#ifdef NETSIM_HAS_AVX2_KERNEL
+    if (has_avx2) {
+        const std::uint64_t block = first / 2;
+        const std::size_t blocks = count / 2;
+        std::size_t b = 0;
+        for (; b + LANES <= blocks; b += LANES) {
+            avx2_blocks(stream, block + b, out + 2 * b);
+        }
+        if (b < blocks) scalar_blocks(stream, block + b, out + 2 * b, blocks - b);
+        return;
+    }
+#endif
+    generate_uniform_batch_scalar(stream, first, out, count);
+}
+
+bool uniform_batch_is_vectorized() { return has_avx2; }
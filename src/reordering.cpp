@@ -0,0 +1,154 @@
+#include "reordering.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+namespace {
+    // Graf fabryki w postaci CSR; węzły numerowane rosnąco według numerów: rampy, robotnicy, magazyny.
+    struct LinkGraph {
+        std::vector<NodeRef> nodes;
+        std::vector<std::uint32_t> offset;
+        std::vector<std::uint32_t> targets;
+        std::uint32_t ramps = 0;
+    };
+
+    template<typename Iterator>
+    std::vector<ElementID> sorted_ids(Iterator first, Iterator last) {
+        std::vector<ElementID> ids;
+        for (; first != last; ++first) ids.push_back(first->get_id());
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    }
+
+    LinkGraph build_graph(const Factory& factory, bool undirected) {
+        LinkGraph graph;
+        const auto ramps = sorted_ids(factory.ramp_cbegin(), factory.ramp_cend());
+        const auto workers = sorted_ids(factory.worker_cbegin(), factory.worker_cend());
+        const auto storehouses = sorted_ids(factory.storehouse_cbegin(), factory.storehouse_cend());
+        graph.ramps = static_cast<std::uint32_t>(ramps.size());
+        graph.nodes.reserve(ramps.size() + workers.size() + storehouses.size());
+        for (ElementID id: ramps) graph.nodes.push_back({ElementType::LOADING_RAMP, id});
+        for (ElementID id: workers) graph.nodes.push_back({ElementType::WORKER, id});
+        for (ElementID id: storehouses) graph.nodes.push_back({ElementType::STOREHOUSE, id});
+
+        std::unordered_map<const IPackageReceiver*, std::uint32_t> receiver_index;
+        receiver_index.reserve(workers.size() + storehouses.size());
+        std::vector<const ReceiverPreferences*> preferences(graph.nodes.size(), nullptr);
+        for (std::uint32_t v = 0; v < graph.nodes.size(); ++v) {
+            const NodeRef& node = graph.nodes[v];
+            if (node.element_type == ElementType::LOADING_RAMP) {
+                preferences[v] = &factory.find_ramp_by_id(node.id)->receiver_preferences_;
+            } else if (node.element_type == ElementType::WORKER) {
+                auto worker = factory.find_worker_by_id(node.id);
+                preferences[v] = &worker->receiver_preferences_;
+                receiver_index.emplace(&*worker, v);
+            } else {
+                receiver_index.emplace(&*factory.find_storehouse_by_id(node.id), v);
+            }
+        }
+
+        // Krawędzie (v, u) zliczane i rozkładane do CSR; dla grafu nieskierowanego także (u, v).
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> edges;
+        for (std::uint32_t v = 0; v < graph.nodes.size(); ++v) {
+            if (!preferences[v]) continue;
+            for (const auto& elem: preferences[v]->get_preferences()) {
+                auto it = receiver_index.find(elem.first);
+                if (it == receiver_index.end()) continue;
+                edges.emplace_back(v, it->second);
+                if (undirected && it->second != v) edges.emplace_back(it->second, v);
+            }
+        }
+        graph.offset.assign(graph.nodes.size() + 1, 0);
+        for (const auto& edge: edges) ++graph.offset[edge.first + 1];
+        for (std::size_t v = 0; v < graph.nodes.size(); ++v) graph.offset[v + 1] += graph.offset[v];
+        graph.targets.resize(edges.size());
+        std::vector<std::uint32_t> fill(graph.offset.begin(), graph.offset.end() - 1);
+        for (const auto& edge: edges) graph.targets[fill[edge.first]++] = edge.second;
+        return graph;
+    }
+
+    // Przeszukiwanie wszerz od węzłów `order[head..]`; odwiedzeni sąsiedzi dopisywani są na koniec.
+    void expand(const LinkGraph& graph, std::vector<std::uint32_t>& order, std::vector<std::uint8_t>& visited,
+                std::size_t head) {
+        for (; head < order.size(); ++head) {
+            const std::uint32_t v = order[head];
+            for (std::uint32_t e = graph.offset[v]; e < graph.offset[v + 1]; ++e) {
+                const std::uint32_t u = graph.targets[e];
+                if (!visited[u]) {
+                    visited[u] = 1;
+                    order.push_back(u);
+                }
+            }
+        }
+    }
+
+    // Kolejne składowe zaczynane od `roots` (pomijając już odwiedzone).
+    std::vector<std::uint32_t> traverse(const LinkGraph& graph, const std::vector<std::uint32_t>& roots) {
+        std::vector<std::uint32_t> order;
+        order.reserve(graph.nodes.size());
+        std::vector<std::uint8_t> visited(graph.nodes.size(), 0);
+        for (std::uint32_t root: roots) {
+            if (visited[root]) continue;
+            visited[root] = 1;
+            const std::size_t head = order.size();
+            order.push_back(root);
+            expand(graph, order, visited, head);
+        }
+        return order;
+    }
+
+    std::vector<std::uint32_t> breadth_first(const LinkGraph& graph) {
+        const auto n = static_cast<std::uint32_t>(graph.nodes.size());
+        // Najpierw wszystkie rampy naraz (ruch zaczyna się od nich), potem węzły nieosiągalne.
+        std::vector<std::uint32_t> order;
+        order.reserve(n);
+        std::vector<std::uint8_t> visited(n, 0);
+        for (std::uint32_t v = 0; v < graph.ramps; ++v) {
+            visited[v] = 1;
+            order.push_back(v);
+        }
+        expand(graph, order, visited, 0);
+        for (std::uint32_t v = 0; v < n; ++v) {
+            if (visited[v]) continue;
+            visited[v] = 1;
+            const std::size_t head = order.size();
+            order.push_back(v);
+            expand(graph, order, visited, head);
+        }
+        return order;
+    }
+
+    std::vector<std::uint32_t> reverse_cuthill_mckee(LinkGraph& graph) {
+        const auto n = static_cast<std::uint32_t>(graph.nodes.size());
+        auto degree = [&graph](std::uint32_t v) { return graph.offset[v + 1] - graph.offset[v]; };
+        auto by_degree = [&degree](std::uint32_t a, std::uint32_t b) { return degree(a) < degree(b); };
+        for (std::uint32_t v = 0; v < n; ++v) {
+            std::stable_sort(graph.targets.begin() + graph.offset[v], graph.targets.begin() + graph.offset[v + 1],
+                             by_degree);
+        }
+        // Składowe zaczynane od węzła o najmniejszym stopniu (węzeł peryferyjny).
+        std::vector<std::uint32_t> roots(n);
+        for (std::uint32_t v = 0; v < n; ++v) roots[v] = v;
+        std::stable_sort(roots.begin(), roots.end(), by_degree);
+
+        std::vector<std::uint32_t> order = traverse(graph, roots);
+        std::reverse(order.begin(), order.end());
+        return order;
+    }
+}
+
+std::vector<NodeRef> locality_order(const Factory& factory, NodeOrdering ordering) {
+    const bool undirected = ordering == NodeOrdering::REVERSE_CUTHILL_MCKEE;
+    LinkGraph graph = build_graph(factory, undirected);
+    const std::vector<std::uint32_t> order = undirected ? reverse_cuthill_mckee(graph) : breadth_first(graph);
+
+    std::vector<NodeRef> result;
+    result.reserve(order.size());
+    for (std::uint32_t v: order) result.push_back(graph.nodes[v]);
+    return result;
+}
+
+void reorder_for_locality(Factory& factory, NodeOrdering ordering) {
+    factory.reorder(locality_order(factory, ordering));
+}
@@ -37,11 +37,16 @@ void generate_simulation_turn_report(const Factory& factory, std::ostream& ostre
     ostream << "\n== WORKERS ==\n\n";
     for (auto it:workers) {
         ostream << "WORKER #" << it.first << "\n";
-        auto& proc = it.second->get_processing_buffer();
         ostream << "  PBuffer: ";
-        if (proc.has_value())
-            ostream << "#" << proc->get_id() << " (pt = " << it.second->get_package_processing_start_time() << ")\n";
-        else ostream << "(empty)\n";
+        bool first_slot = true;
+        for (const auto& slot : it.second->get_processing_slots()) {
+            if (!first_slot) ostream << ", ";
+            first_slot = false;
+            if (slot.package.has_value())
+                ostream << "#" << slot.package->get_id() << " (pt = " << slot.start_time << ")";
+            else ostream << "(empty)";
+        }
+        ostream << "\n";
         ostream << "  Queue:";
         if (it.second->empty()) ostream << " (empty)";
         size_t commas = it.second->size();
@@ -0,0 +1,264 @@
+#include "result_cache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+
+#include "random.hpp"
+#include "simulation.hpp"
+#include "trace.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define NETSIM_HAS_GETPID
+#include <unistd.h>
+#else
+#include <random>
+#endif
+
+namespace {
+    constexpr const char* RESULT_HEADER = "NETSIM-RESULT 1";
+    constexpr std::size_t TRACE_HASH_CHUNK = std::size_t(1) << 16;
+
+    class Hasher {
+    public:
+        void add(std::uint64_t value) {
+            std::uint64_t state = state_ ^ value;
+            state_ = splitmix64(state);
+        }
+
+        void add(double value) {
+            std::uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            add(bits);
+        }
+
+        void add(const char* data, std::size_t size) {
+            add(static_cast<std::uint64_t>(size));
+            add_bytes(data, size);
+        }
+
+        // Bez długości; kolejne fragmenty (poza ostatnim) muszą mieć długość podzielną przez 8.
+        void add_bytes(const char* data, std::size_t size) {
+            for (std::size_t i = 0; i < size; i += 8) {
+                std::uint64_t word = 0;
+                std::memcpy(&word, data + i, std::min<std::size_t>(8, size - i));
+                add(word);
+            }
+        }
+
+        void add(const std::string& text) { add(text.data(), text.size()); }
+
+        std::uint64_t value() const { return state_; }
+
+    private:
+        std::uint64_t state_ = 0x6E657473696D3031ULL;
+    };
+
+    template<typename Iterator>
+    std::vector<const typename std::iterator_traits<Iterator>::value_type*> sorted_by_id(Iterator first, Iterator last) {
+        std::vector<const typename std::iterator_traits<Iterator>::value_type*> nodes;
+        for (; first != last; ++first) nodes.push_back(&*first);
+        std::sort(nodes.begin(), nodes.end(), [](auto* lhs, auto* rhs) { return lhs->get_id() < rhs->get_id(); });
+        return nodes;
+    }
+
+    void hash_routing(Hasher& h, const ReceiverPreferences& preferences) {
+        if (!preferences.get_probability_generator().is_default()) {
+            throw std::logic_error("Cannot hash a custom probability generator!");
+        }
+        h.add(static_cast<std::uint64_t>(preferences.get_routing_policy()));
+        std::vector<std::tuple<ReceiverType, ElementID, double>> links;
+        for (const auto& elem: preferences.get_preferences()) {
+            links.emplace_back(elem.first->get_receiver_type(), elem.first->get_id(), elem.second);
+        }
+        std::sort(links.begin(), links.end());
+        h.add(static_cast<std::uint64_t>(links.size()));
+        for (const auto& link: links) {
+            h.add(static_cast<std::uint64_t>(std::get<0>(link)));
+            h.add(static_cast<std::uint64_t>(std::get<1>(link)));
+            h.add(std::get<2>(link));
+        }
+    }
+
+    void hash_preference_order(Hasher& h, const ReceiverPreferences& preferences) {
+        h.add(static_cast<std::uint64_t>(preferences.get_preferences().size()));
+        for (const auto& elem: preferences.get_preferences()) {
+            h.add(static_cast<std::uint64_t>(elem.first->get_receiver_type()));
+            h.add(static_cast<std::uint64_t>(elem.first->get_id()));
+        }
+    }
+
+    std::string to_hex(std::uint64_t value) {
+        std::ostringstream os;
+        os << std::hex;
+        os.width(16);
+        os.fill('0');
+        os << value;
+        return os.str();
+    }
+
+    // Nazwa pliku tymczasowego niepowtarzalna między procesami i wątkami zapisującymi ten sam wpis.
+    std::string temporary_path(const std::string& path) {
+#ifdef NETSIM_HAS_GETPID
+        static const auto process = static_cast<std::uint64_t>(::getpid());
+#else
+        static const std::uint64_t process = std::random_device{}();
+#endif
+        static std::atomic<std::uint64_t> counter{0};
+        return path + "." + std::to_string(process) + "-" + std::to_string(counter.fetch_add(1)) + ".tmp";
+    }
+}
+
+std::uint64_t structure_hash(const Factory& factory) {
+    Hasher h;
+    const auto ramps = sorted_by_id(factory.ramp_cbegin(), factory.ramp_cend());
+    h.add(static_cast<std::uint64_t>(ramps.size()));
+    for (const Ramp* ramp: ramps) {
+        h.add(static_cast<std::uint64_t>(ramp->get_id()));
+        if (ramp->get_trace()) {
+            // Liczy się zawartość pliku przybyć, nie jego nazwa.
+            MappedFile trace(ramp->get_trace()->path());
+            h.add(static_cast<std::uint64_t>(trace.size()));
+            std::vector<char> chunk(TRACE_HASH_CHUNK);
+            for (std::size_t offset = 0, n; (n = trace.read(offset, chunk.data(), chunk.size())) != 0; offset += n) {
+                h.add_bytes(chunk.data(), n);
+            }
+        } else {
+            h.add(ramp->get_delivery_distribution().to_string());
+        }
+        hash_routing(h, ramp->receiver_preferences_);
+    }
+
+    const auto workers = sorted_by_id(factory.worker_cbegin(), factory.worker_cend());
+    h.add(static_cast<std::uint64_t>(workers.size()));
+    for (const Worker* worker: workers) {
+        const WorkerConfig& config = *worker->get_config();
+        h.add(static_cast<std::uint64_t>(worker->get_id()));
+        h.add(config.processing_time.to_string());
+        h.add(static_cast<std::uint64_t>(config.queue_type));
+        h.add(static_cast<std::uint64_t>(config.servers));
+        hash_routing(h, worker->receiver_preferences_);
+    }
+
+    const auto storehouses = sorted_by_id(factory.storehouse_cbegin(), factory.storehouse_cend());
+    h.add(static_cast<std::uint64_t>(storehouses.size()));
+    for (const Storehouse* storehouse: storehouses) h.add(static_cast<std::uint64_t>(storehouse->get_id()));
+    return h.value();
+}
+
+std::uint64_t execution_order_hash(const Factory& factory) {
+    Hasher h;
+    for (auto it = factory.ramp_cbegin(); it != factory.ramp_cend(); ++it) {
+        h.add(static_cast<std::uint64_t>(it->get_id()));
+        hash_preference_order(h, it->receiver_preferences_);
+    }
+    for (auto it = factory.worker_cbegin(); it != factory.worker_cend(); ++it) {
+        h.add(static_cast<std::uint64_t>(it->get_id()));
+        hash_preference_order(h, it->receiver_preferences_);
+    }
+    for (auto it = factory.storehouse_cbegin(); it != factory.storehouse_cend(); ++it) {
+        h.add(static_cast<std::uint64_t>(it->get_id()));
+    }
+    return h.value();
+}
+
+ScenarioKey scenario_key(const Factory& factory, std::uint64_t seed, TimeOffset turns) {
+    if (factory.get_time() != 1 || factory.get_package_registry().size() != 0) {
+        throw std::logic_error("Only a factory before its first turn identifies a scenario!");
+    }
+    return ScenarioKey{structure_hash(factory), execution_order_hash(factory), seed, turns};
+}
+
+SimulationSummary summarize(const Factory& factory) {
+    SimulationSummary summary;
+    summary.packages = factory.get_package_registry().size();
+    for (const Storehouse* storehouse: sorted_by_id(factory.storehouse_cbegin(), factory.storehouse_cend())) {
+        summary.storehouse_stock.emplace_back(storehouse->get_id(), storehouse->size());
+    }
+    for (const Worker* worker: sorted_by_id(factory.worker_cbegin(), factory.worker_cend())) {
+        summary.worker_queues.emplace_back(worker->get_id(), worker->size());
+    }
+    return summary;
+}
+
+ResultCache::ResultCache(std::string directory) : directory_(std::move(directory)) {
+    std::filesystem::create_directories(directory_);
+}
+
+std::string ResultCache::path_of(const ScenarioKey& key) const {
+    return (std::filesystem::path(directory_) /
+            (to_hex(key.structure) + "-" + to_hex(key.execution_order) + "-" + to_hex(key.seed) + "-" +
+             std::to_string(key.turns) + ".result")).string();
+}
+
+std::optional<SimulationSummary> ResultCache::find(const ScenarioKey& key) const {
+    const std::string path = path_of(key);
+    std::ifstream file(path);
+    if (!file) return std::nullopt;
+    std::error_code error;
+    const auto size = std::filesystem::file_size(path, error);
+    if (error) return std::nullopt;
+
+    std::string header;
+    std::getline(file, header);
+    ScenarioKey stored;
+    std::string word;
+    file >> std::hex >> stored.structure >> stored.execution_order >> stored.seed >> std::dec >> stored.turns;
+    if (header != RESULT_HEADER || !file || stored != key) return std::nullopt;
+
+    SimulationSummary summary;
+    std::size_t storehouses = 0, workers = 0;
+    file >> summary.packages >> storehouses >> workers;
+    // Każdy wpis zajmuje w pliku kilka bajtów, więc większa liczba oznacza uszkodzony plik.
+    if (!file || storehouses > size || workers > size) return std::nullopt;
+    summary.storehouse_stock.resize(storehouses);
+    for (auto& stock: summary.storehouse_stock) file >> stock.first >> stock.second;
+    summary.worker_queues.resize(workers);
+    for (auto& queue: summary.worker_queues) file >> queue.first >> queue.second;
+    if (!file || !(file >> word) || word != "end") return std::nullopt;
+    return summary;
+}
+
+void ResultCache::store(const ScenarioKey& key, const SimulationSummary& summary) const {
+    std::ostringstream os;
+    os << RESULT_HEADER << "\n" << std::hex << key.structure << " " << key.execution_order << " " << key.seed
+       << std::dec << " " << key.turns << "\n";
+    os << summary.packages << " " << summary.storehouse_stock.size() << " " << summary.worker_queues.size() << "\n";
+    for (const auto& stock: summary.storehouse_stock) os << stock.first << " " << stock.second << "\n";
+    for (const auto& queue: summary.worker_queues) os << queue.first << " " << queue.second << "\n";
+    os << "end\n";
+
+    const std::string path = path_of(key);
+    const std::string temporary = temporary_path(path);
+    std::error_code error;
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file << os.str();
+        if (!file.flush()) {
+            file.close();
+            std::filesystem::remove(temporary, error);
+            throw std::runtime_error("Cannot write the result cache entry: " + temporary);
+        }
+    }
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        throw std::runtime_error("Cannot write the result cache entry: " + path);
+    }
+}
+
+SimulationSummary ResultCache::run(Factory& factory, std::uint64_t seed, TimeOffset turns) const {
+    const ScenarioKey key = scenario_key(factory, seed, turns);
+    if (auto cached = find(key)) return *cached;
+
+    factory.reseed(seed);
+    simulate(factory, turns);
+    SimulationSummary summary = summarize(factory);
+    store(key, summary);
+    return summary;
+}
@@ -0,0 +1,23 @@
+#include "routing.hpp"
+
+std::optional<RoutingPolicyType> routing_policy_from_string(std::string_view name) {
+    if (name == "weighted-random") return RoutingPolicyType::WEIGHTED_RANDOM;
+    if (name == "round-robin") return RoutingPolicyType::ROUND_ROBIN;
+    if (name == "jsq") return RoutingPolicyType::JOIN_SHORTEST_QUEUE;
+    if (name == "p2c") return RoutingPolicyType::POWER_OF_TWO_CHOICES;
+    return std::nullopt;
+}
+
+std::string to_string(RoutingPolicyType policy) {
+    switch (policy) {
+        case RoutingPolicyType::WEIGHTED_RANDOM:
+            return "weighted-random";
+        case RoutingPolicyType::ROUND_ROBIN:
+            return "round-robin";
+        case RoutingPolicyType::JOIN_SHORTEST_QUEUE:
+            return "jsq";
+        case RoutingPolicyType::POWER_OF_TWO_CHOICES:
+            return "p2c";
+    }
+    return "";
+}
@@ -1,20 +1,99 @@
 #include "simulation.hpp"
+#include "compiled_factory.hpp"
 #include "types.hpp"
 
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Kolejka zdarzeń: węzeł (rampy, a po nich robotnicy) odwiedzany jest tylko w turach,
+// w których ma coś do zrobienia. Wewnątrz tury kolejność odwiedzin jest taka sama jak
+// przy pełnym przeglądzie, więc wyniki nie zależą od pominiętych węzłów.
+class EventQueue {
+public:
+    explicit EventQueue(std::size_t nodes) : due_(nodes, TIME_NEVER) {}
+
+    void schedule(std::size_t node, Time t) {
+        if (t >= due_[node]) return;
+        due_[node] = t;
+        heap_.emplace(t, node);
+    }
+
+    // Kolejny węzeł do odwiedzenia w turze `t` (nieaktualne wpisy są pomijane).
+    bool pop(Time t, std::size_t& node) {
+        while (!heap_.empty() && heap_.top().first == t) {
+            auto entry = heap_.top();
+            heap_.pop();
+            if (due_[entry.second] != t) continue;
+            due_[entry.second] = TIME_NEVER;
+            node = entry.second;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    using Entry = std::pair<Time, std::size_t>;
+
+    std::vector<Time> due_;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<>> heap_;
+};
+
+}
 
 void simulate(Factory& factory, TimeOffset timeOffset, const std::function<void(Factory&, Time)>& rf) {
     if (factory.is_consistent()) {
-        for (Time time = 1; time != timeOffset + 1; time++) {
-            for (NodeCollection<Ramp>::iterator ramp = factory.ramp_begin(); ramp != factory.ramp_end(); ramp++) {
-                ramp->deliver_goods(time);
-                ramp->send_package();
-            }
-            for (NodeCollection<Worker>::iterator worker = factory.worker_begin();
-                worker != factory.worker_end(); worker++) {
-                worker->send_package();
-                worker->do_work(time);
+        std::vector<Ramp*> ramps;
+        for (auto ramp = factory.ramp_begin(); ramp != factory.ramp_end(); ramp++) ramps.push_back(&*ramp);
+        std::vector<Worker*> workers;
+        // Numer węzła robotnika według jego gęstego indeksu.
+        constexpr std::size_t NOT_A_WORKER = std::numeric_limits<std::size_t>::max();
+        std::vector<std::size_t> worker_index(factory.worker_index_bound(), NOT_A_WORKER);
+        for (auto worker = factory.worker_begin(); worker != factory.worker_end(); worker++) {
+            worker_index[worker->get_index()] = ramps.size() + workers.size();
+            workers.push_back(&*worker);
+        }
+
+        // Symulacja zaczyna się od pierwszej niesymulowanej tury fabryki.
+        const Time first = factory.get_time();
+        EventQueue events(ramps.size() + workers.size());
+        for (std::size_t i = 0; i < ramps.size(); ++i) events.schedule(i, ramps[i]->get_next_event_time(first));
+        for (std::size_t i = 0; i < workers.size(); ++i) {
+            events.schedule(ramps.size() + i, workers[i]->get_next_event_time(first));
+        }
+
+        for (Time time = first; time != first + timeOffset; time++) {
+            std::size_t node = 0;
+            // Odbiorca dalej w kolejności obsłuży półprodukt jeszcze w tej turze, wcześniejszy - w następnej.
+            auto wake = [&](IPackageReceiver* receiver) {
+                if (receiver->get_kind() != ReceiverKind::WORKER || !factory.owns(receiver)) return;
+                std::size_t target = worker_index[receiver->get_index()];
+                events.schedule(target, (target > node) ? time : time + 1);
+            };
+            while (events.pop(time, node)) {
+                if (node < ramps.size()) {
+                    Ramp* ramp = ramps[node];
+                    ramp->deliver_goods(time);
+                    if (IPackageReceiver* receiver = ramp->send_package()) wake(receiver);
+                    events.schedule(node, ramp->get_next_event_time(time + 1));
+                } else {
+                    Worker* worker = workers[node - ramps.size()];
+                    worker->send_package(wake);
+                    worker->do_work(time);
+                    events.schedule(node, worker->get_next_event_time(time + 1));
+                }
             }
+            factory.set_time(time + 1);
             rf(factory, timeOffset);
         }
     } else throw std::logic_error("IS CONSISTANT ERROR!");
-}
\ No newline at end of file
+}
+
+void simulate(Factory& factory, TimeOffset timeOffset) {
+    CompiledFactory compiled(factory);
+    compiled.run(timeOffset);
+    compiled.write_back();
+}
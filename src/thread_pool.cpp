@@ -0,0 +1,54 @@
+#include "thread_pool.hpp"
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) threads = std::max(1U, std::thread::hardware_concurrency());
+    threads_.reserve(threads - 1);
+    for (unsigned i = 1; i < threads; ++i) threads_.emplace_back(&ThreadPool::work, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_.notify_all();
+    for (auto& thread: threads_) thread.join();
+}
+
+void ThreadPool::run(const std::function<void(unsigned)>& task) {
+    if (threads_.empty()) {
+        task(0);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        pending_ = static_cast<unsigned>(threads_.size());
+        ++generation_;
+    }
+    start_.notify_all();
+    task(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return pending_ == 0; });
+    task_ = nullptr;
+}
+
+void ThreadPool::work(unsigned index) {
+    std::size_t seen = 0;
+    for (;;) {
+        const std::function<void(unsigned)>* task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_.wait(lock, [this, seen] { return stop_ || generation_ != seen; });
+            if (stop_) return;
+            seen = generation_;
+            task = task_;
+        }
+        (*task)(index);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--pending_ == 0) done_.notify_one();
+        }
+    }
+}
@@ -0,0 +1,263 @@
+#include "topology.hpp"
+
+#include <charconv>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+#include "factory_builder.hpp"
+#include "random.hpp"
+
+std::optional<TopologyShape> topology_shape_from_string(const std::string& name) {
+    if (name == "layered") return TopologyShape::LAYERED;
+    if (name == "random") return TopologyShape::RANDOM;
+    if (name == "recirculating") return TopologyShape::RECIRCULATING;
+    if (name == "fan-in") return TopologyShape::FAN_IN;
+    return std::nullopt;
+}
+
+std::string to_string(TopologyShape shape) {
+    switch (shape) {
+        case TopologyShape::LAYERED:
+            return "layered";
+        case TopologyShape::RANDOM:
+            return "random";
+        case TopologyShape::RECIRCULATING:
+            return "recirculating";
+        case TopologyShape::FAN_IN:
+            return "fan-in";
+    }
+    return "layered";
+}
+
+namespace {
+    const std::string TEMPLATE_NAME = "generated";
+
+    void validate(const TopologySpec& spec) {
+        if (!spec.ramps || !spec.workers || !spec.storehouses) {
+            throw std::invalid_argument("A topology needs ramps, workers and storehouses!");
+        }
+        const std::size_t max_id = std::numeric_limits<ElementID>::max();
+        if (spec.ramps > max_id || spec.workers > max_id || spec.storehouses > max_id) {
+            throw std::invalid_argument("Too many nodes for element IDs!");
+        }
+        if (!spec.fan_out) throw std::invalid_argument("Fan-out must be at least 1!");
+        if (!spec.layers || spec.layers > spec.workers) {
+            throw std::invalid_argument("The number of layers must be between 1 and the number of workers!");
+        }
+        for (double p: {spec.back_edge_probability, spec.exit_probability}) {
+            if (!(p >= 0 && p <= 1)) throw std::invalid_argument("Probabilities must be within [0, 1]!");
+        }
+    }
+
+    // Kolejne decyzje generatora; wspólne dla zapisu tekstowego i budowania w pamięci,
+    // więc oba dają tę samą sieć.
+    template<typename Sink>
+    class Generator {
+    public:
+        Generator(const TopologySpec& spec, Sink& sink) : spec_(spec), sink_(sink), rng_(spec.seed) {}
+
+        void run() {
+            const bool layered = spec_.shape == TopologyShape::LAYERED || spec_.shape == TopologyShape::RECIRCULATING;
+            layers_ = layered ? spec_.layers : 1;
+
+            for (std::size_t id = 1; id <= spec_.ramps; ++id) sink_.ramp(static_cast<ElementID>(id));
+            for (std::size_t id = 1; id <= spec_.workers; ++id) sink_.worker(static_cast<ElementID>(id));
+            for (std::size_t id = 1; id <= spec_.storehouses; ++id) sink_.storehouse(static_cast<ElementID>(id));
+
+            for (std::size_t ramp = 1; ramp <= spec_.ramps; ++ramp) {
+                for (std::size_t k = 0; k < spec_.fan_out; ++k) link_ramp(ramp, worker_in_layer(0));
+            }
+            if (spec_.shape == TopologyShape::RANDOM) random_links();
+            else layered_links();
+            // Każdy magazyn ma co najmniej jednego dostawcę.
+            for (std::size_t store = 1; store <= spec_.storehouses; ++store) {
+                sink_.link(worker_ref(worker_in_layer(layers_ - 1)), store_ref(store));
+            }
+        }
+
+    private:
+        std::size_t pick(std::size_t n) {
+            auto value = static_cast<std::size_t>(to_unit_double(rng_()) * static_cast<double>(n));
+            return (value < n) ? value : n - 1;
+        }
+
+        bool chance(double p) { return to_unit_double(rng_()) < p; }
+
+        // Robotnicy warstwy `layer` to numery [first(layer), first(layer + 1)).
+        std::size_t first(std::size_t layer) const { return 1 + layer * spec_.workers / layers_; }
+
+        std::size_t worker_in_layer(std::size_t layer) {
+            return first(layer) + pick(first(layer + 1) - first(layer));
+        }
+
+        std::size_t layer_of(std::size_t worker) const { return ((worker - 1) * layers_ + layers_ - 1) / spec_.workers; }
+
+        static NodeRef worker_ref(std::size_t id) { return {ElementType::WORKER, static_cast<ElementID>(id)}; }
+
+        static NodeRef store_ref(std::size_t id) { return {ElementType::STOREHOUSE, static_cast<ElementID>(id)}; }
+
+        void link_ramp(std::size_t ramp, std::size_t worker) {
+            sink_.link({ElementType::LOADING_RAMP, static_cast<ElementID>(ramp)}, worker_ref(worker));
+        }
+
+        void layered_links() {
+            for (std::size_t worker = 1; worker <= spec_.workers; ++worker) {
+                const std::size_t layer = layer_of(worker);
+                // Dostawca z poprzedniej warstwy (dla pierwszej - rampa), by każdy robotnik był osiągalny.
+                if (layer == 0) link_ramp(1 + pick(spec_.ramps), worker);
+                else sink_.link(worker_ref(worker_in_layer(layer - 1)), worker_ref(worker));
+
+                for (std::size_t k = 0; k < spec_.fan_out; ++k) {
+                    if (layer + 1 == layers_) sink_.link(worker_ref(worker), store_ref(1 + pick(spec_.storehouses)));
+                    else sink_.link(worker_ref(worker), worker_ref(worker_in_layer(layer + 1)));
+                }
+                if (spec_.shape == TopologyShape::RECIRCULATING && layer > 0 && chance(spec_.back_edge_probability)) {
+                    sink_.link(worker_ref(worker), worker_ref(1 + pick(first(layer) - 1)));
+                }
+            }
+        }
+
+        // Jedna krawędź "postępu" na robotnika (do magazynu lub robotnika o większym numerze)
+        // gwarantuje drogę do magazynu; pozostałe krawędzie prowadzą dokądkolwiek.
+        void random_links() {
+            const std::size_t n = spec_.workers;
+            for (std::size_t worker = 1; worker <= n; ++worker) {
+                if (worker == 1) link_ramp(1 + pick(spec_.ramps), worker);
+                else sink_.link(worker_ref(1 + pick(worker - 1)), worker_ref(worker));
+                if (worker == n || chance(spec_.exit_probability)) {
+                    sink_.link(worker_ref(worker), store_ref(1 + pick(spec_.storehouses)));
+                } else {
+                    sink_.link(worker_ref(worker), worker_ref(worker + 1 + pick(n - worker)));
+                }
+                for (std::size_t k = 1; k < spec_.fan_out; ++k) sink_.link(worker_ref(worker), worker_ref(1 + pick(n)));
+            }
+        }
+
+        const TopologySpec& spec_;
+        Sink& sink_;
+        Xoshiro256pp rng_;
+        std::size_t layers_ = 1;
+    };
+
+    // Zapis tekstowy przez własny bufor - bez formatowania strumieniowego dla każdej liczby.
+    class TextSink {
+    public:
+        TextSink(const TopologySpec& spec, std::ostream& os) : spec_(spec), os_(os) {
+            buffer_.reserve(FLUSH_SIZE + 256);
+            append("; generated topology: shape=").append(to_string(spec.shape)).append(" seed=");
+            append(spec.seed).append("\n\n; == LOADING RAMPS ==\n\n");
+        }
+
+        void ramp(ElementID id) {
+            append("LOADING_RAMP id=").append(id).append(" delivery-interval=").append(delivery_).append("\n");
+        }
+
+        void worker(ElementID id) {
+            if (section_ < 1) {
+                section_ = 1;
+                append("\n; == WORKER TEMPLATES ==\n\nWORKER_TEMPLATE name=").append(TEMPLATE_NAME);
+                append(" processing-time=").append(spec_.processing_time.to_string()).append(" queue-type=");
+                append(spec_.queue_type == PackageQueueType::FIFO ? "FIFO" : "LIFO").append("\n\n; == WORKERS ==\n\n");
+            }
+            append("WORKER id=").append(id).append(" template=").append(TEMPLATE_NAME).append("\n");
+        }
+
+        void storehouse(ElementID id) {
+            if (section_ < 2) {
+                section_ = 2;
+                append("\n; == STOREHOUSES ==\n\n");
+            }
+            append("STOREHOUSE id=").append(id).append("\n");
+        }
+
+        void link(NodeRef sender, NodeRef receiver) {
+            if (section_ < 3) {
+                section_ = 3;
+                append("\n; == LINKS ==\n\n");
+            }
+            append("LINK src=").append(sender.element_type == ElementType::LOADING_RAMP ? "ramp-" : "worker-");
+            append(sender.id).append(" dest=").append(receiver.element_type == ElementType::WORKER ? "worker-" : "store-");
+            append(receiver.id).append("\n");
+        }
+
+        void finish() {
+            flush();
+            if (!os_) throw std::runtime_error("Cannot write the topology!");
+        }
+
+    private:
+        static constexpr std::size_t FLUSH_SIZE = 1 << 20;
+
+        TextSink& append(const std::string& text) {
+            buffer_.append(text);
+            return *this;
+        }
+
+        TextSink& append(const char* text) {
+            buffer_.append(text);
+            return *this;
+        }
+
+        TextSink& append(std::uint64_t value) {
+            char digits[24];
+            auto result = std::to_chars(digits, digits + sizeof(digits), value);
+            buffer_.append(digits, result.ptr);
+            if (buffer_.size() >= FLUSH_SIZE) flush();
+            return *this;
+        }
+
+        void flush() {
+            os_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+            buffer_.clear();
+        }
+
+        const TopologySpec& spec_;
+        std::ostream& os_;
+        const std::string delivery_ = spec_.delivery_interval.to_string();
+        std::string buffer_;
+        int section_ = 0;
+    };
+
+    class BuilderSink {
+    public:
+        explicit BuilderSink(const TopologySpec& spec)
+                : spec_(spec), config_(std::make_shared<const WorkerConfig>(TEMPLATE_NAME, spec.processing_time,
+                                                                            spec.queue_type)) {
+            builder_.reserve(spec.ramps, spec.workers, spec.storehouses,
+                             (spec.ramps + spec.workers) * (spec.fan_out + 1) + spec.storehouses);
+            builder_.add_worker_template(config_);
+        }
+
+        void ramp(ElementID id) { builder_.add_ramp(Ramp(id, spec_.delivery_interval)); }
+
+        void worker(ElementID id) { builder_.add_worker(Worker(id, config_)); }
+
+        void storehouse(ElementID id) { builder_.add_storehouse(Storehouse(id)); }
+
+        void link(NodeRef sender, NodeRef receiver) { builder_.add_link(sender, receiver); }
+
+        Factory finish() { return builder_.build(); }
+
+    private:
+        const TopologySpec& spec_;
+        std::shared_ptr<const WorkerConfig> config_;
+        FactoryBuilder builder_;
+    };
+}
+
+void write_topology(const TopologySpec& spec, std::ostream& os) {
+    validate(spec);
+    TextSink sink(spec, os);
+    Generator<TextSink>(spec, sink).run();
+    sink.finish();
+}
+
+Factory generate_topology(const TopologySpec& spec) {
+    validate(spec);
+    BuilderSink sink(spec);
+    Generator<BuilderSink>(spec, sink).run();
+    return sink.finish();
+}
@@ -0,0 +1,143 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define NETSIM_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr std::size_t ADVISE_STEP = std::size_t(1) << 20;
+    constexpr std::size_t PAGE = 4096;
+    constexpr std::size_t READ_CHUNK = std::size_t(1) << 16;
+}
+
+MappedFile::MappedFile(const std::string& path) : path_(path) {
+#ifdef NETSIM_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open trace file: " + path);
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot stat trace file: " + path);
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ != 0) {
+        // Gdy mapowanie się nie uda, plik czytany jest blokami.
+        void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            data_ = static_cast<const char*>(addr);
+            mapped_ = true;
+            ::madvise(addr, size_, MADV_SEQUENTIAL);
+        }
+    }
+    if (mapped_) ::close(fd);
+    else fd_ = fd;
+#else
+    stream_.open(path, std::ios::binary | std::ios::ate);
+    if (!stream_) throw std::runtime_error("Cannot open trace file: " + path);
+    size_ = static_cast<std::size_t>(stream_.tellg());
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef NETSIM_HAS_MMAP
+    if (mapped_) ::munmap(const_cast<char*>(data_), size_);
+    if (fd_ >= 0) ::close(fd_);
+#endif
+}
+
+void MappedFile::advise_consumed(std::size_t offset) const {
+#ifdef NETSIM_HAS_MMAP
+    if (!mapped_) return;
+    char* base = const_cast<char*>(data_);
+    const std::size_t done = (offset / PAGE) * PAGE;
+    if (done >= ADVISE_STEP) {
+        // Zwalniany jest tylko fragment przeczytany od poprzedniej rady.
+        const std::size_t end = done - ADVISE_STEP + PAGE;
+        std::size_t begin = released_.load(std::memory_order_relaxed);
+        while (begin < end && !released_.compare_exchange_weak(begin, end, std::memory_order_relaxed)) {}
+        if (begin < end) ::madvise(base + begin, end - begin, MADV_DONTNEED);
+    }
+    if (done < size_) ::madvise(base + done, std::min(ADVISE_STEP, size_ - done), MADV_WILLNEED);
+#else
+    (void) offset;
+#endif
+}
+
+std::size_t MappedFile::read(std::size_t offset, char* out, std::size_t count) const {
+    if (offset >= size_) return 0;
+    count = std::min(count, size_ - offset);
+    if (mapped_) {
+        std::memcpy(out, data_ + offset, count);
+        return count;
+    }
+#ifdef NETSIM_HAS_MMAP
+    for (std::size_t done = 0; done < count;) {
+        const ssize_t got = ::pread(fd_, out + done, count - done, static_cast<off_t>(offset + done));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) throw std::runtime_error("Cannot read trace file: " + path_);
+        done += static_cast<std::size_t>(got);
+    }
+#else
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    stream_.clear();
+    stream_.seekg(static_cast<std::streamoff>(offset));
+    stream_.read(out, static_cast<std::streamsize>(count));
+    if (static_cast<std::size_t>(stream_.gcount()) != count) throw std::runtime_error("Cannot read trace file: " + path_);
+#endif
+    return count;
+}
+
+
+ArrivalTrace::ArrivalTrace(const std::string& path) : file_(std::make_shared<const MappedFile>(path)) {
+    if (file_->is_mapped()) window_size_ = file_->size();
+}
+
+bool ArrivalTrace::refill() {
+    if (file_->is_mapped()) return false;
+    chunk_.resize(READ_CHUNK);
+    window_begin_ = offset_;
+    window_size_ = file_->read(offset_, chunk_.data(), chunk_.size());
+    return window_size_ != 0;
+}
+
+std::optional<Time> ArrivalTrace::next() {
+    if (offset_ >= advised_) {
+        file_->advise_consumed(offset_);
+        advised_ = offset_ + ADVISE_STEP / 2;
+    }
+
+    for (int c = peek(); c >= 0; c = peek()) {
+        if (c == '\n' || c == '\r' || c == ' ' || c == '\t') {
+            ++offset_;
+            continue;
+        }
+        if (c == ';') {
+            while ((c = peek()) >= 0 && c != '\n') ++offset_;
+            continue;
+        }
+        if (c < '0' || c > '9') throw std::runtime_error("Bad entry in trace file: " + file_->path());
+
+        // TIME_NEVER oznacza brak kolejnej dostawy, więc nie może być znacznikiem przybycia.
+        Time value = 0;
+        for (; c >= '0' && c <= '9'; c = peek()) {
+            const auto digit = static_cast<Time>(c - '0');
+            if (value > (TIME_NEVER - 1 - digit) / 10) {
+                throw std::runtime_error("Arrival time out of range in trace file: " + file_->path());
+            }
+            value = value * 10 + digit;
+            ++offset_;
+        }
+        return value;
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,85 @@
+// Generator syntetycznych sieci do testów skali - wypisuje plik struktury fabryki.
+//
+//   netsim_topology [--shape layered|random|recirculating|fan-in] [--ramps N] [--workers N]
+//                   [--storehouses N] [--layers N] [--fan-out N] [--back-edges P] [--exits P]
+//                   [--delivery-interval SPEC] [--processing-time SPEC] [--queue-type FIFO|LIFO]
+//                   [--seed N] [--output FILE]
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "topology.hpp"
+
+namespace {
+    std::size_t parse_count(const std::string& value) {
+        std::size_t used = 0;
+        const unsigned long long count = std::stoull(value, &used);
+        if (used != value.size() || value.front() == '-') throw std::invalid_argument("Invalid number: " + value);
+        return static_cast<std::size_t>(count);
+    }
+
+    double parse_probability(const std::string& value) {
+        std::size_t used = 0;
+        const double p = std::stod(value, &used);
+        if (used != value.size()) throw std::invalid_argument("Invalid probability: " + value);
+        return p;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    TopologySpec spec;
+    std::string output;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string option = argv[i];
+            if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + option);
+            const std::string value = argv[++i];
+            if (option == "--shape") {
+                auto shape = topology_shape_from_string(value);
+                if (!shape) throw std::invalid_argument("Unknown shape: " + value);
+                spec.shape = *shape;
+            } else if (option == "--ramps") {
+                spec.ramps = parse_count(value);
+            } else if (option == "--workers") {
+                spec.workers = parse_count(value);
+            } else if (option == "--storehouses") {
+                spec.storehouses = parse_count(value);
+            } else if (option == "--layers") {
+                spec.layers = parse_count(value);
+            } else if (option == "--fan-out") {
+                spec.fan_out = parse_count(value);
+            } else if (option == "--back-edges") {
+                spec.back_edge_probability = parse_probability(value);
+            } else if (option == "--exits") {
+                spec.exit_probability = parse_probability(value);
+            } else if (option == "--delivery-interval") {
+                spec.delivery_interval = TimeDistribution::parse(value);
+            } else if (option == "--processing-time") {
+                spec.processing_time = TimeDistribution::parse(value);
+            } else if (option == "--queue-type") {
+                if (value != "FIFO" && value != "LIFO") throw std::invalid_argument("Unknown queue type: " + value);
+                spec.queue_type = (value == "FIFO") ? PackageQueueType::FIFO : PackageQueueType::LIFO;
+            } else if (option == "--seed") {
+                spec.seed = parse_count(value);
+            } else if (option == "--output") {
+                output = value;
+            } else {
+                throw std::invalid_argument("Unknown option: " + option);
+            }
+        }
+
+        std::ofstream file;
+        if (!output.empty()) {
+            file.open(output, std::ios::binary);
+            if (!file) throw std::runtime_error("Cannot open " + output);
+        }
+        write_topology(spec, output.empty() ? std::cout : file);
+    } catch (const std::exception& e) {
+        std::cerr << "netsim_topology: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}